@@ -0,0 +1,86 @@
+#-------------------------------------------------
+#
+# The MrWriter application. The document core is in libmrdoc.
+#
+#-------------------------------------------------
+
+#QMAKE_POST_LINK=make_doc.sh
+
+QT       += core gui
+QT       += concurrent
+#QT       += svg
+#QT       += webenginewidgets
+
+system(touch $$PWD/../version.h)
+
+greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
+
+TARGET = MrWriter
+TEMPLATE = app
+
+include(../libmrdoc/libmrdoc.pri)
+
+SOURCES += ../main.cpp \
+    ../mainwindow.cpp \
+    ../widget.cpp \
+    ../commands.cpp \
+    ../tabletapplication.cpp \
+    ../headless.cpp \
+    ../htmlmarkdownrenderer.cpp \
+    ../pagesettingsdialog.cpp \
+    ../colorbutton.cpp \
+    ../textbox.cpp \
+    ../searchbar.cpp \
+    ../abstracttextbox.cpp \
+    ../markdownbox.cpp \
+    ../markdownselection.cpp \
+    ../tilecache.cpp \
+    ../renderservice.cpp
+
+HEADERS  += ../mainwindow.h \
+    ../widget.h \
+    ../commands.h \
+    ../tictoc.h \
+    ../tabletapplication.h \
+    ../headless.h \
+    ../htmlmarkdownrenderer.h \
+    ../pagesettingsdialog.h \
+    ../colorbutton.h \
+    ../textbox.h \
+    ../searchbar.h \
+    ../markdownbox.h \
+    ../abstracttextbox.h \
+    ../markdownselection.h \
+    ../tilecache.h \
+    ../renderservice.h
+
+FORMS    += \
+    ../searchbar.ui
+
+RESOURCES += \
+    ../myresource.qrc
+
+LIBS += -lmarkdown
+
+QMAKE_LFLAGS += -lmarkdown
+
+ICON = ../MyIcon.icns
+
+RC_ICONS = ../MyIcon.ico
+
+DISTFILES += \
+    ../images/openIcon.png \
+    ../images/newIcon.png \
+    ../Info.plist \
+    ../COPYING
+
+CONFIG += c++17
+
+#QMAKE_CXXFLAGS_RELEASE -= -O
+#QMAKE_CXXFLAGS_RELEASE -= -O1
+#QMAKE_CXXFLAGS_RELEASE -= -O2
+
+#QMAKE_CXXFLAGS_RELEASE *= -O3
+
+QMAKE_INFO_PLIST = ../Info.plist
+
@@ -0,0 +1,25 @@
+#-------------------------------------------------
+#
+# Headless benchmarks and checks of the document core (loading, saving, painting, hit testing, export)
+#
+# Built with MrWriter.pro, it links libmrdoc: qmake && make && ./benchmark/mrwriter-benchmark --help
+# ./benchmark/mrwriter-benchmark --check runs the checks instead of the benchmarks
+#
+#-------------------------------------------------
+
+QT       += core gui
+QT       -= widgets
+
+TARGET = mrwriter-benchmark
+TEMPLATE = app
+CONFIG += console c++17
+CONFIG -= app_bundle
+
+include(../libmrdoc/libmrdoc.pri)
+
+SOURCES += main.cpp \
+    checks.cpp
+
+HEADERS += checks.h
+
+DEFINES += MRWRITER_TEST_DOCUMENT_PARTS=\\\"$$PWD/../test_document/parts\\\"
@@ -0,0 +1,341 @@
+#include "checks.h"
+
+#include "document.h"
+#include "gzipdevice.h"
+#include "qcompressor.h"
+#include "stroke.h"
+
+#include <QBuffer>
+#include <QFileInfo>
+#include <QImage>
+#include <QLineF>
+#include <QPainter>
+#include <QPolygonF>
+#include <QTemporaryDir>
+
+#include <iostream>
+
+namespace
+{
+
+/**
+ * @brief distanceToPolyline
+ * @return the distance of @param point to the closest segment of @param polyline
+ */
+qreal distanceToPolyline(const QPointF &point, const QPolygonF &polyline)
+{
+  qreal distance = QLineF(point, polyline.first()).length();
+  for (int i = 0; i < polyline.size() - 1; ++i)
+  {
+    QPointF a = polyline.at(i);
+    QPointF delta = polyline.at(i + 1) - a;
+    qreal t = QPointF::dotProduct(point - a, delta) / QPointF::dotProduct(delta, delta);
+    t = qBound(0.0, t, 1.0);
+    distance = std::min(distance, QLineF(point, a + t * delta).length());
+  }
+  return distance;
+}
+
+/**
+ * @brief makeDocument
+ * @return a document with @param numPages pages, every page with a pen, a highlighter and a dashed stroke, a text and a markdown document
+ */
+MrDoc::Document makeDocument(int numPages)
+{
+  MrDoc::Document document;
+  document.pages.clear();
+  const MrDoc::Page::backgroundType types[] = {MrDoc::Page::backgroundType::PLAIN, MrDoc::Page::backgroundType::SQUARED,
+                                               MrDoc::Page::backgroundType::RULED};
+  for (int i = 0; i < numPages; ++i)
+  {
+    MrDoc::Page page;
+    page.setWidth(595.0);
+    page.setHeight(842.0);
+    page.setBackgroundColor(i % 2 == 0 ? QColor(255, 255, 255) : QColor(255, 250, 220));
+    page.setBackgroundType(types[i % 3]);
+
+    QPolygonF points;
+    QVector<qreal> pressures;
+    for (int j = 0; j < 20; ++j)
+    {
+      points.append(QPointF(50.0 + 10.0 * j + 0.25 * i, 100.0 + 0.5 * (j % 5)));
+      pressures.append(0.5 + 0.025 * j);
+    }
+    MrDoc::Stroke pen;
+    pen.setPenWidth(1.41);
+    pen.setPoints(points, pressures);
+    page.appendStroke(pen);
+
+    MrDoc::Stroke highlighter;
+    highlighter.setHighlighter(true);
+    highlighter.setPenWidth(12.0);
+    highlighter.setColor(QColor(255, 255, 0, 128));
+    highlighter.setPoints(points.translated(0.0, 40.0), QVector<qreal>(points.size(), 1.0));
+    page.appendStroke(highlighter);
+
+    MrDoc::Stroke dashed;
+    dashed.setPenWidth(2.5);
+    dashed.setColor(QColor(200, 0, 0));
+    dashed.setPattern(MrDoc::dashLinePattern);
+    dashed.setPoints(points.translated(0.0, 80.0), pressures);
+    page.appendStroke(dashed);
+
+    page.appendText(QRectF(60, 300, 0, 0), QFont("Sans", 12), QColor(0, 0, 255), QString("Page %1 & <text>").arg(i + 1));
+    page.appendMarkdown(QRectF(60, 500, 200, 40), QString("# Page %1\n\n*markdown*").arg(i + 1));
+    document.pages.append(page);
+  }
+  return document;
+}
+
+/**
+ * @brief samePages compares the pages of @param expected and @param actual
+ * @param difference gets a description of the first difference
+ * @return true if both have the same pages
+ */
+bool samePages(MrDoc::Document &expected, MrDoc::Document &actual, QString &difference)
+{
+  if (expected.pages.size() != actual.pages.size())
+  {
+    difference = QString("%1 pages instead of %2").arg(actual.pages.size()).arg(expected.pages.size());
+    return false;
+  }
+  for (int i = 0; i < expected.pages.size(); ++i)
+  {
+    MrDoc::Page &expectedPage = expected.pages[i];
+    MrDoc::Page &actualPage = actual.pages[i];
+    difference = QString("page %1: ").arg(i + 1);
+    if (expectedPage.width() != actualPage.width() || expectedPage.height() != actualPage.height() ||
+        expectedPage.backgroundColor() != actualPage.backgroundColor() || expectedPage.getBackgroundType() != actualPage.getBackgroundType())
+    {
+      difference += "background differs";
+      return false;
+    }
+
+    const QVector<MrDoc::Stroke> &expectedStrokes = expectedPage.strokes();
+    const QVector<MrDoc::Stroke> &actualStrokes = actualPage.strokes();
+    if (expectedStrokes.size() != actualStrokes.size())
+    {
+      difference += QString("%1 strokes instead of %2").arg(actualStrokes.size()).arg(expectedStrokes.size());
+      return false;
+    }
+    for (int j = 0; j < expectedStrokes.size(); ++j)
+    {
+      const MrDoc::Stroke &a = expectedStrokes.at(j);
+      const MrDoc::Stroke &b = actualStrokes.at(j);
+      if (a.points() != b.points() || a.pressures() != b.pressures() || a.penWidth() != b.penWidth() || a.rgba() != b.rgba() ||
+          a.pattern() != b.pattern() || a.isHighlighter() != b.isHighlighter())
+      {
+        difference += QString("stroke %1 differs").arg(j);
+        return false;
+      }
+    }
+
+    // the size of a text is measured when it is painted, only its position is stored
+    const auto &expectedTexts = expectedPage.texts();
+    const auto &actualTexts = actualPage.texts();
+    if (expectedTexts.size() != actualTexts.size())
+    {
+      difference += QString("%1 texts instead of %2").arg(actualTexts.size()).arg(expectedTexts.size());
+      return false;
+    }
+    for (int j = 0; j < expectedTexts.size(); ++j)
+    {
+      if (std::get<0>(expectedTexts.at(j)).topLeft() != std::get<0>(actualTexts.at(j)).topLeft() ||
+          std::get<1>(expectedTexts.at(j)).toString() != std::get<1>(actualTexts.at(j)).toString() ||
+          std::get<2>(expectedTexts.at(j)) != std::get<2>(actualTexts.at(j)) || std::get<3>(expectedTexts.at(j)) != std::get<3>(actualTexts.at(j)))
+      {
+        difference += QString("text %1 differs").arg(j);
+        return false;
+      }
+    }
+
+    if (expectedPage.markdowns() != actualPage.markdowns())
+    {
+      difference += "markdown differs";
+      return false;
+    }
+  }
+  difference.clear();
+  return true;
+}
+}
+
+bool Checks::run()
+{
+  bool ok = true;
+  ok = strokeOutlinesAreFilled() && ok;
+  ok = conversionsKeepPages() && ok;
+  ok = gzipEndsOnBlockBoundary() && ok;
+  return ok;
+}
+
+bool Checks::strokeOutlinesAreFilled()
+{
+  const qreal penWidth = 20.0;
+  // pixels this close to the border of the stroke are not checked, they are partly covered
+  const qreal margin = 1.5;
+  QVector<QPolygonF> polylines;
+  polylines.append(QPolygonF({QPointF(40, 50), QPointF(160, 50)}));                    // caps only
+  polylines.append(QPolygonF({QPointF(40, 30), QPointF(100, 50), QPointF(160, 45)}));  // slight bend, mitred
+  polylines.append(QPolygonF({QPointF(40, 20), QPointF(100, 80), QPointF(160, 20)}));  // sharp corner, round join
+
+  bool ok = true;
+  for (const QPolygonF &polyline : polylines)
+  {
+    MrDoc::Stroke stroke;
+    stroke.setPenWidth(penWidth);
+    stroke.setPoints(polyline, QVector<qreal>(polyline.size(), 1.0));
+
+    QImage image(200, 100, QImage::Format_RGB32);
+    image.fill(Qt::white);
+    QPainter painter(&image);
+    painter.setPen(Qt::NoPen);
+    painter.setBrush(Qt::black);
+    painter.drawPath(*stroke.outline());
+    painter.end();
+
+    int holes = 0;
+    int spills = 0;
+    for (int y = 0; y < image.height(); ++y)
+    {
+      for (int x = 0; x < image.width(); ++x)
+      {
+        qreal distance = distanceToPolyline(QPointF(x + 0.5, y + 0.5), polyline);
+        bool filled = qGray(image.pixel(x, y)) < 128;
+        if (distance < penWidth / 2.0 - margin && !filled)
+        {
+          ++holes;
+        }
+        else if (distance > penWidth / 2.0 + margin && filled)
+        {
+          ++spills;
+        }
+      }
+    }
+    if (holes > 0 || spills > 0)
+    {
+      std::cerr << "strokeOutlinesAreFilled: " << holes << " pixels missing and " << spills << " pixels too many in the outline of a stroke with "
+                << polyline.size() << " points" << std::endl;
+      ok = false;
+    }
+  }
+  return ok;
+}
+
+bool Checks::conversionsKeepPages()
+{
+  QTemporaryDir tmpDir;
+  if (!tmpDir.isValid())
+  {
+    std::cerr << "conversionsKeepPages: could not create a temporary directory" << std::endl;
+    return false;
+  }
+
+  bool ok = true;
+  for (int numPages : {3, MrDoc::Document::lazyPageThreshold + 5})
+  {
+    QString baseName = tmpDir.filePath(QString("conversion-%1").arg(numPages));
+    QStringList fileNames = {baseName + ".moj", baseName + ".mojb", baseName + ".mojt", baseName + "-back.moj"};
+
+    MrDoc::Document document = makeDocument(numPages);
+    if (!document.saveBySuffix(fileNames.first()))
+    {
+      std::cerr << "conversionsKeepPages: could not save " << qPrintable(fileNames.first()) << std::endl;
+      ok = false;
+      continue;
+    }
+    // every file is converted right after opening it, so the pages of large documents are still stubs when they are written
+    bool converted = true;
+    for (int i = 0; i + 1 < fileNames.size() && converted; ++i)
+    {
+      MrDoc::Document source;
+      converted = source.loadBySuffix(fileNames.at(i)) && source.saveBySuffix(fileNames.at(i + 1));
+      if (!converted)
+      {
+        std::cerr << "conversionsKeepPages: could not convert " << qPrintable(fileNames.at(i)) << " to " << qPrintable(fileNames.at(i + 1))
+                  << std::endl;
+      }
+    }
+    if (!converted)
+    {
+      ok = false;
+      continue;
+    }
+
+    // the first file is the reference, the document written by the check was never rounded like a loaded one
+    MrDoc::Document reference;
+    if (!reference.loadBySuffix(fileNames.first()))
+    {
+      std::cerr << "conversionsKeepPages: could not load " << qPrintable(fileNames.first()) << std::endl;
+      ok = false;
+      continue;
+    }
+    for (int i = 1; i < fileNames.size(); ++i)
+    {
+      MrDoc::Document convertedDocument;
+      QString difference;
+      if (!convertedDocument.loadBySuffix(fileNames.at(i)))
+      {
+        difference = "could not be loaded";
+      }
+      else
+      {
+        samePages(reference, convertedDocument, difference);
+      }
+      if (!difference.isEmpty())
+      {
+        std::cerr << "conversionsKeepPages: " << qPrintable(QFileInfo(fileNames.at(i)).fileName()) << ": " << qPrintable(difference) << std::endl;
+        ok = false;
+      }
+    }
+  }
+  return ok;
+}
+
+bool Checks::gzipEndsOnBlockBoundary()
+{
+  bool ok = true;
+  for (int size : {QCompressor::parallelBlockSize - 1, QCompressor::parallelBlockSize, QCompressor::parallelBlockSize + 1,
+                   2 * QCompressor::parallelBlockSize})
+  {
+    QByteArray data;
+    data.reserve(size);
+    for (int i = 0; data.size() < size; ++i)
+    {
+      data.append(QByteArray::number(i * 7919 % 10007)).append(' ');
+    }
+    data.truncate(size);
+
+    // written in small pieces like QXmlStreamWriter does, so the last piece completes the block
+    QBuffer compressed;
+    compressed.open(QIODevice::WriteOnly);
+    GzipDevice writer(&compressed);
+    writer.open(QIODevice::WriteOnly);
+    const int pieceSize = 4096;
+    for (int pos = 0; pos < data.size(); pos += pieceSize)
+    {
+      writer.write(data.constData() + pos, std::min(pieceSize, data.size() - pos));
+    }
+    writer.close();
+    compressed.close();
+
+    QByteArray inflated;
+    bool inflatedByZlib = !writer.hasError() && QCompressor::gzipDecompress(compressed.data(), inflated) && inflated == data;
+
+    compressed.open(QIODevice::ReadOnly);
+    GzipDevice reader(&compressed);
+    reader.open(QIODevice::ReadOnly);
+    QByteArray read = reader.readAll();
+    bool inflatedByDevice = !reader.hasError() && read == data;
+    reader.close();
+
+    if (!inflatedByZlib || !inflatedByDevice)
+    {
+      std::cerr << "gzipEndsOnBlockBoundary: " << size << " bytes " << (inflatedByZlib ? "" : "are not valid gzip data")
+                << (!inflatedByZlib && !inflatedByDevice ? " and " : "") << (inflatedByDevice ? "" : "are not read back by GzipDevice")
+                << std::endl;
+      ok = false;
+    }
+  }
+  return ok;
+}
@@ -0,0 +1,34 @@
+#ifndef CHECKS_H
+#define CHECKS_H
+
+/**
+ * @brief The Checks class verifies results of the document core which the benchmarks only time, e.g. that outlines cover what they should.
+ * @details It is run by @c mrwriter-benchmark @c --check. Every failed check is printed to stderr.
+ */
+class Checks
+{
+public:
+  /**
+   * @brief run runs all checks
+   * @return true if all checks passed
+   */
+  static bool run();
+
+private:
+  /**
+   * @brief strokeOutlinesAreFilled rasterizes the outline of strokes with round caps and joins. Every pixel closer to the polyline than the
+   * radius has to be filled, every pixel farther away has to be empty.
+   */
+  static bool strokeOutlinesAreFilled();
+  /**
+   * @brief conversionsKeepPages saves a document as .moj, converts it to .mojb, .mojt and back to .moj and compares every file with the
+   * first one. Documents with more than Document::lazyPageThreshold pages are converted without loading their pages first.
+   */
+  static bool conversionsKeepPages();
+  /**
+   * @brief gzipEndsOnBlockBoundary compresses data which ends exactly on a block of GzipDevice (and next to it) and decompresses it again
+   */
+  static bool gzipEndsOnBlockBoundary();
+};
+
+#endif // CHECKS_H
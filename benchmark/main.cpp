@@ -0,0 +1,444 @@
+#include "checks.h"
+#include "document.h"
+
+#include <QGuiApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QPainter>
+#include <QTemporaryDir>
+#include <algorithm>
+#include <functional>
+#include <iostream>
+
+namespace
+{
+
+bool verbose = false;
+
+void messageHandler(QtMsgType type, const QMessageLogContext &context, const QString &message)
+{
+  // the document code prints a lot of debug output, which would distort the timings
+  if (type == QtDebugMsg && !verbose)
+  {
+    return;
+  }
+  std::cerr << qPrintable(qFormatLogMessage(type, context, message)) << std::endl;
+}
+
+/**
+ * @brief The Benchmark class runs and times the single benchmarks and collects the results as JSON
+ */
+class Benchmark
+{
+public:
+  explicit Benchmark(int repetitions) : m_repetitions{repetitions}
+  {
+  }
+
+  /**
+   * @brief measure runs @param body @ref m_repetitions times and records the wall clock time of each run
+   * @param name
+   * @param setup is run before every run of @param body and is not timed
+   * @param body
+   */
+  void measure(const QString &name, const std::function<void()> &setup, const std::function<void()> &body)
+  {
+    QVector<double> runs;
+    for (int i = 0; i < m_repetitions; ++i)
+    {
+      setup();
+      QElapsedTimer timer;
+      timer.start();
+      body();
+      runs.append(timer.nsecsElapsed() / 1.0e6);
+    }
+
+    QVector<double> sortedRuns = runs;
+    std::sort(sortedRuns.begin(), sortedRuns.end());
+    QJsonArray runsArray;
+    for (double run : runs)
+    {
+      runsArray.append(run);
+    }
+    QJsonObject result;
+    result.insert("median_ms", sortedRuns.at(sortedRuns.size() / 2));
+    result.insert("min_ms", sortedRuns.first());
+    result.insert("runs_ms", runsArray);
+    m_results.insert(name, result);
+
+    std::cerr << qPrintable(name.leftJustified(32)) << qPrintable(QString::number(sortedRuns.at(sortedRuns.size() / 2), 'f', 2)) << " ms" << std::endl;
+  }
+
+  void measure(const QString &name, const std::function<void()> &body)
+  {
+    measure(name, []() {}, body);
+  }
+
+  const QJsonObject &results() const
+  {
+    return m_results;
+  }
+
+private:
+  int m_repetitions;
+  QJsonObject m_results;
+};
+
+/**
+ * @brief generateDocument writes an uncompressed .moj with @param numPages pages, like test_document/generate_test_document.sh does
+ * @return true if successful
+ */
+bool generateDocument(const QString &partsDir, int numPages, const QString &fileName)
+{
+  QFile header(partsDir + "/header.part.moj");
+  QFile page(partsDir + "/page.part.moj");
+  QFile footer(partsDir + "/footer.part.moj");
+  QFile file(fileName);
+  if (!header.open(QIODevice::ReadOnly) || !page.open(QIODevice::ReadOnly) || !footer.open(QIODevice::ReadOnly) || !file.open(QIODevice::WriteOnly))
+  {
+    return false;
+  }
+  file.write(header.readAll());
+  QByteArray pageData = page.readAll();
+  for (int i = 0; i < numPages; ++i)
+  {
+    file.write(pageData);
+  }
+  file.write(footer.readAll());
+  return true;
+}
+
+QImage paintPage(MrDoc::Page &page, qreal zoom)
+{
+  QImage image(static_cast<int>(page.width() * zoom), static_cast<int>(page.height() * zoom), QImage::Format_ARGB32_Premultiplied);
+  image.fill(page.backgroundColor());
+  QPainter painter;
+  painter.begin(&image);
+  painter.setRenderHint(QPainter::Antialiasing, true);
+  page.paint(painter, zoom);
+  painter.end();
+  return image;
+}
+
+/**
+ * @brief paintTiles paints the ink of the page tile by tile with clipping, like the widget does for its tile cache
+ */
+void paintTiles(MrDoc::Page &page, qreal zoom)
+{
+  const int tileSize = 256;
+  QImage tile(tileSize, tileSize, QImage::Format_ARGB32_Premultiplied);
+  for (int y = 0; y * tileSize < page.height() * zoom; ++y)
+  {
+    for (int x = 0; x * tileSize < page.width() * zoom; ++x)
+    {
+      QRectF clipRect(x * tileSize, y * tileSize, tileSize, tileSize);
+      tile.fill(page.backgroundColor());
+      QPainter painter;
+      painter.begin(&tile);
+      painter.setRenderHint(QPainter::Antialiasing, true);
+      painter.translate(-clipRect.topLeft());
+      painter.setClipRect(clipRect);
+      painter.setClipping(true);
+      page.paintInk(painter, zoom, QRectF(clipRect.topLeft() / zoom, clipRect.bottomRight() / zoom));
+      painter.end();
+    }
+  }
+}
+
+/**
+ * @brief eraseHits does the hit test of Widget::erase (without modifying the page)
+ * @return number of strokes the eraser at @param pagePos would delete
+ */
+int eraseHits(MrDoc::Page &page, const QPointF &pagePos)
+{
+  qreal eraserWidth = 10 * 0.99;
+  QLineF lineA = QLineF(pagePos + QPointF(-eraserWidth, -eraserWidth) / 2.0, pagePos + QPointF(-eraserWidth, eraserWidth) / 2.0);
+  QLineF lineB = QLineF(pagePos + QPointF(-eraserWidth, eraserWidth) / 2.0, pagePos + QPointF(eraserWidth, eraserWidth) / 2.0);
+  QLineF lineC = QLineF(pagePos + QPointF(eraserWidth, eraserWidth) / 2.0, pagePos + QPointF(eraserWidth, -eraserWidth) / 2.0);
+  QLineF lineD = QLineF(pagePos + QPointF(eraserWidth, -eraserWidth) / 2.0, pagePos + QPointF(-eraserWidth, -eraserWidth) / 2.0);
+  QRectF rectE = QRectF(pagePos + QPointF(-eraserWidth, eraserWidth) / 2.0, pagePos + QPointF(eraserWidth, -eraserWidth) / 2.0);
+
+  const QVector<MrDoc::Stroke> &strokes = page.strokes();
+  int hits = 0;
+  QPointF iPoint;
+  for (int i : page.strokesInRect(rectE))
+  {
+    const MrDoc::Stroke &stroke = strokes.at(i);
+    bool hit = false;
+    for (int j = 0; j < stroke.size() && !hit; ++j)
+    {
+      hit = rectE.contains(stroke.point(j));
+    }
+    for (int j = 0; j < stroke.size() - 1 && !hit; ++j)
+    {
+      QLineF line = QLineF(stroke.point(j), stroke.point(j + 1));
+      hit = line.intersect(lineA, &iPoint) == QLineF::BoundedIntersection || line.intersect(lineB, &iPoint) == QLineF::BoundedIntersection ||
+            line.intersect(lineC, &iPoint) == QLineF::BoundedIntersection || line.intersect(lineD, &iPoint) == QLineF::BoundedIntersection;
+    }
+    if (hit)
+    {
+      ++hits;
+    }
+  }
+  return hits;
+}
+
+/**
+ * @brief compare compares @param results with the results in @param baseline
+ * @return comparison of every benchmark contained in both
+ */
+QJsonObject compare(const QJsonObject &results, const QJsonObject &baseline, double tolerance, bool &regression)
+{
+  QJsonObject comparison;
+  regression = false;
+  std::cerr << std::endl << "Comparison with baseline (tolerance " << tolerance * 100.0 << " %):" << std::endl;
+  for (const QString &name : results.keys())
+  {
+    if (!baseline.contains(name))
+    {
+      continue;
+    }
+    double median = results.value(name).toObject().value("median_ms").toDouble();
+    double baselineMedian = baseline.value(name).toObject().value("median_ms").toDouble();
+    if (baselineMedian <= 0.0)
+    {
+      continue;
+    }
+    double ratio = median / baselineMedian;
+    bool slower = ratio > 1.0 + tolerance;
+    regression = regression || slower;
+
+    QJsonObject entry;
+    entry.insert("baseline_median_ms", baselineMedian);
+    entry.insert("ratio", ratio);
+    entry.insert("regression", slower);
+    comparison.insert(name, entry);
+
+    std::cerr << qPrintable(name.leftJustified(32)) << qPrintable(QString::number(ratio, 'f', 3)) << (slower ? "  REGRESSION" : "") << std::endl;
+  }
+  return comparison;
+}
+}
+
+int main(int argc, char *argv[])
+{
+  // no display is needed, everything is painted into images and files
+  if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+  {
+    qputenv("QT_QPA_PLATFORM", "offscreen");
+  }
+  qInstallMessageHandler(messageHandler);
+
+  QGuiApplication app(argc, argv);
+  QGuiApplication::setApplicationName("mrwriter-benchmark");
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription("Benchmarks of the MrWriter document core. Results are written as JSON.");
+  parser.addHelpOption();
+  QCommandLineOption pagesOption("pages", "Number of pages of the synthetic document.", "N", "3");
+  QCommandLineOption repetitionsOption("repetitions", "Number of runs of every benchmark.", "R", "3");
+  QCommandLineOption zoomsOption("zooms", "Comma separated zoom levels for the paint benchmarks.", "list", "0.5,1,2,4");
+  QCommandLineOption partsOption("parts", "Directory containing header.part.moj, page.part.moj and footer.part.moj.", "dir", MRWRITER_TEST_DOCUMENT_PARTS);
+  QCommandLineOption outputOption("output", "Write the results to this file instead of stdout.", "file");
+  QCommandLineOption baselineOption("baseline", "Compare the results with a previous result file. Exits with 2 if a benchmark got slower.", "file");
+  QCommandLineOption toleranceOption("tolerance", "Allowed slow down in percent, when comparing with a baseline.", "percent", "10");
+  QCommandLineOption verboseOption("verbose", "Show the debug output of the document code.");
+  QCommandLineOption checkOption("check", "Run the checks instead of the benchmarks. Exits with 1 if a check fails.");
+  parser.addOption(pagesOption);
+  parser.addOption(repetitionsOption);
+  parser.addOption(zoomsOption);
+  parser.addOption(partsOption);
+  parser.addOption(outputOption);
+  parser.addOption(baselineOption);
+  parser.addOption(toleranceOption);
+  parser.addOption(verboseOption);
+  parser.addOption(checkOption);
+  parser.process(app);
+
+  verbose = parser.isSet(verboseOption);
+  if (parser.isSet(checkOption))
+  {
+    bool passed = Checks::run();
+    std::cerr << (passed ? "All checks passed." : "Some checks failed.") << std::endl;
+    return passed ? 0 : 1;
+  }
+  int numPages = std::max(1, parser.value(pagesOption).toInt());
+  int repetitions = std::max(1, parser.value(repetitionsOption).toInt());
+  QVector<qreal> zooms;
+  for (const QString &zoom : parser.value(zoomsOption).split(',', Qt::SkipEmptyParts))
+  {
+    zooms.append(zoom.toDouble());
+  }
+
+  QTemporaryDir tmpDir;
+  if (!tmpDir.isValid())
+  {
+    std::cerr << "Could not create a temporary directory." << std::endl;
+    return 1;
+  }
+  QString generatedFileName = tmpDir.filePath("generated.moj");
+  QString mojFileName = tmpDir.filePath("benchmark.moj");
+  QString xojFileName = tmpDir.filePath("benchmark.xoj");
+  QString mojbFileName = tmpDir.filePath("benchmark.mojb");
+  QString mojtFileName = tmpDir.filePath("benchmark.mojt");
+  QString pdfFileName = tmpDir.filePath("benchmark.pdf");
+
+  if (!generateDocument(parser.value(partsOption), numPages, generatedFileName))
+  {
+    std::cerr << "Could not generate the test document from " << qPrintable(parser.value(partsOption)) << std::endl;
+    return 1;
+  }
+
+  MrDoc::Document document;
+  if (!document.loadMOJ(generatedFileName))
+  {
+    std::cerr << "Could not load the generated test document." << std::endl;
+    return 1;
+  }
+  int numStrokes = 0;
+  for (MrDoc::Page &page : document.pages)
+  {
+    numStrokes += page.strokes().size();
+  }
+  std::cerr << numPages << " pages, " << numStrokes << " strokes, " << repetitions << " repetitions" << std::endl << std::endl;
+
+  Benchmark benchmark(repetitions);
+  bool ok = true;
+
+  benchmark.measure("saveMOJ", [&]() { ok = document.saveMOJ(mojFileName) && ok; });
+  benchmark.measure("loadMOJ", [&]() {
+    MrDoc::Document loadedDocument;
+    ok = loadedDocument.loadMOJ(mojFileName) && ok;
+  });
+  benchmark.measure("saveMOJB", [&]() { ok = document.saveMOJB(mojbFileName) && ok; });
+  benchmark.measure("loadMOJB_firstPage", [&]() {
+    MrDoc::Document loadedDocument;
+    ok = loadedDocument.loadMOJB(mojbFileName) && ok;
+    // time to first page: open the file and decode the first page only
+    if (!loadedDocument.pages.isEmpty())
+    {
+      loadedDocument.pages.first().strokes();
+    }
+  });
+  benchmark.measure("loadMOJB_allPages", [&]() {
+    MrDoc::Document loadedDocument;
+    ok = loadedDocument.loadMOJB(mojbFileName) && ok;
+    for (MrDoc::Page &page : loadedDocument.pages)
+    {
+      page.strokes();
+    }
+  });
+  benchmark.measure("saveMOJT", [&]() { ok = document.saveMOJT(mojtFileName) && ok; });
+  benchmark.measure("loadMOJT", [&]() {
+    MrDoc::Document loadedDocument;
+    ok = loadedDocument.loadMOJT(mojtFileName) && ok;
+  });
+  benchmark.measure("saveXOJ", [&]() { ok = document.saveXOJ(xojFileName) && ok; });
+  benchmark.measure("loadXOJ", [&]() {
+    MrDoc::Document loadedDocument;
+    ok = loadedDocument.loadXOJ(xojFileName) && ok;
+  });
+
+  // the first paint of a page also compiles its display list
+  QVector<MrDoc::Page> pages;
+  benchmark.measure("paint_first_zoom_1", [&]() { pages = document.pages; },
+                    [&]() {
+                      for (MrDoc::Page &page : pages)
+                      {
+                        paintPage(page, 1.0);
+                      }
+                    });
+  for (qreal zoom : zooms)
+  {
+    benchmark.measure(QString("paint_zoom_%1").arg(zoom), [&]() {
+      for (MrDoc::Page &page : pages)
+      {
+        paintPage(page, zoom);
+      }
+    });
+  }
+  for (qreal zoom : zooms)
+  {
+    benchmark.measure(QString("paintTiles_zoom_%1").arg(zoom), [&]() {
+      for (MrDoc::Page &page : pages)
+      {
+        paintTiles(page, zoom);
+      }
+    });
+  }
+
+  benchmark.measure("getStrokes", [&]() {
+    for (MrDoc::Page &page : pages)
+    {
+      QRectF pageRect(0, 0, page.width(), page.height());
+      QPolygonF quarter(QRectF(pageRect.topLeft(), pageRect.center()));
+      page.getStrokes(quarter);
+      page.getStrokes(QPolygonF(pageRect));
+    }
+  });
+
+  benchmark.measure("eraseHitTest", [&]() {
+    for (MrDoc::Page &page : pages)
+    {
+      // 1000 eraser positions on a regular grid
+      for (int y = 0; y < 40; ++y)
+      {
+        for (int x = 0; x < 25; ++x)
+        {
+          eraseHits(page, QPointF((x + 0.5) * page.width() / 25, (y + 0.5) * page.height() / 40));
+        }
+      }
+    }
+  });
+
+  benchmark.measure("exportPDFAsImage", [&]() { document.exportPDFAsImage(pdfFileName); });
+
+  if (!ok)
+  {
+    std::cerr << "Loading or saving failed." << std::endl;
+    return 1;
+  }
+
+  QJsonObject output;
+  output.insert("pages", numPages);
+  output.insert("strokes", numStrokes);
+  output.insert("repetitions", repetitions);
+  output.insert("qtVersion", QString(qVersion()));
+  output.insert("results", benchmark.results());
+
+  bool regression = false;
+  if (parser.isSet(baselineOption))
+  {
+    QFile baselineFile(parser.value(baselineOption));
+    if (!baselineFile.open(QIODevice::ReadOnly))
+    {
+      std::cerr << "Could not open the baseline " << qPrintable(parser.value(baselineOption)) << std::endl;
+      return 1;
+    }
+    QJsonObject baseline = QJsonDocument::fromJson(baselineFile.readAll()).object().value("results").toObject();
+    double tolerance = parser.value(toleranceOption).toDouble() / 100.0;
+    output.insert("comparison", compare(benchmark.results(), baseline, tolerance, regression));
+  }
+
+  QByteArray json = QJsonDocument(output).toJson();
+  if (parser.isSet(outputOption))
+  {
+    QFile outputFile(parser.value(outputOption));
+    if (!outputFile.open(QIODevice::WriteOnly))
+    {
+      std::cerr << "Could not write " << qPrintable(parser.value(outputOption)) << std::endl;
+      return 1;
+    }
+    outputFile.write(json);
+  }
+  else
+  {
+    std::cout << json.constData();
+  }
+
+  return regression ? 2 : 0;
+}
@@ -0,0 +1,439 @@
+#include "binarydocument.h"
+#include "bytestream.h"
+
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QtConcurrent>
+
+#include <zlib.h>
+#include <cstring>
+#include <limits>
+
+namespace MrDoc
+{
+
+namespace
+{
+quint8 patternToCode(const QVector<qreal> &pattern)
+{
+  if (pattern == dashLinePattern)
+  {
+    return 1;
+  }
+  else if (pattern == dashDotLinePattern)
+  {
+    return 2;
+  }
+  else if (pattern == dotLinePattern)
+  {
+    return 3;
+  }
+  return 0;
+}
+
+const QVector<qreal> &codeToPattern(quint8 code)
+{
+  switch (code)
+  {
+  case 1:
+    return dashLinePattern;
+  case 2:
+    return dashDotLinePattern;
+  case 3:
+    return dotLinePattern;
+  default:
+    return solidLinePattern;
+  }
+}
+
+/**
+ * @brief The EncodedPage struct is the chunk of a page, either encoded or referencing the chunk of an unloaded page in another file
+ */
+struct EncodedPage
+{
+  Page *page;
+  const uchar *rawChunk = nullptr; /**< compressed chunk in a mapped file, nullptr if the page is encoded */
+  QByteArray chunk;
+  quint32 compressedSize = 0;
+  quint32 uncompressedSize = 0;
+  bool wasLoaded = true; /**< false if the page was a stub, which is unloaded again after encoding */
+  bool ok = true;
+};
+}
+
+const char BinaryDocument::magic[4] = {'M', 'O', 'J', 'B'};
+
+quint8 BinaryDocument::backgroundTypeToCode(Page::backgroundType type)
+{
+  switch (type)
+  {
+  case Page::backgroundType::SQUARED:
+    return 1;
+  case Page::backgroundType::RULED:
+    return 2;
+  default:
+    return 0;
+  }
+}
+
+Page::backgroundType BinaryDocument::codeToBackgroundType(quint8 code)
+{
+  switch (code)
+  {
+  case 1:
+    return Page::backgroundType::SQUARED;
+  case 2:
+    return Page::backgroundType::RULED;
+  default:
+    return Page::backgroundType::PLAIN;
+  }
+}
+
+BinaryDocument::BinaryDocument()
+{
+}
+
+BinaryDocument::~BinaryDocument()
+{
+  if (m_data != nullptr)
+  {
+    m_file.unmap(const_cast<uchar *>(m_data));
+  }
+}
+
+bool BinaryDocument::open(const QString &fileName)
+{
+  m_file.setFileName(fileName);
+  if (!m_file.open(QIODevice::ReadOnly))
+  {
+    return false;
+  }
+  m_size = m_file.size();
+  if (m_size < headerSize)
+  {
+    return false;
+  }
+  m_data = m_file.map(0, m_size);
+  if (m_data == nullptr)
+  {
+    return false;
+  }
+  // the file stays open, closing it would remove the mapping
+
+  if (std::memcmp(m_data, magic, sizeof(magic)) != 0)
+  {
+    return false;
+  }
+  ByteReader header(m_data + sizeof(magic), headerSize - sizeof(magic));
+  quint32 version = header.read<quint32>();
+  quint32 pageCount = header.read<quint32>();
+  header.read<quint32>(); // flags
+  quint64 directoryOffset = header.read<quint64>();
+  quint64 pdfPathOffset = header.read<quint64>();
+  if (version > formatVersion || directoryOffset > static_cast<quint64>(m_size) || pdfPathOffset > static_cast<quint64>(m_size))
+  {
+    return false;
+  }
+
+  ByteReader pdfPath(m_data + pdfPathOffset, m_size - static_cast<qint64>(pdfPathOffset));
+  m_pdfPath = pdfPath.readString();
+  if (!pdfPath.ok())
+  {
+    return false;
+  }
+
+  qint64 directorySize = m_size - static_cast<qint64>(directoryOffset);
+  if (static_cast<quint64>(pageCount) * directoryEntrySize > static_cast<quint64>(directorySize))
+  {
+    return false;
+  }
+  ByteReader directory(m_data + directoryOffset, directorySize);
+  m_pageInfos.resize(static_cast<int>(pageCount));
+  m_chunks.resize(static_cast<int>(pageCount));
+  for (int i = 0; i < m_chunks.size(); ++i)
+  {
+    Chunk &chunk = m_chunks[i];
+    chunk.offset = directory.read<quint64>();
+    chunk.compressedSize = directory.read<quint32>();
+    chunk.uncompressedSize = directory.read<quint32>();
+    if (chunk.offset > static_cast<quint64>(m_size) || chunk.compressedSize > static_cast<quint64>(m_size) - chunk.offset)
+    {
+      return false;
+    }
+    PageInfo &info = m_pageInfos[i];
+    info.width = directory.readDouble();
+    info.height = directory.readDouble();
+    info.backgroundColor = directory.read<quint32>();
+    info.backgroundType = codeToBackgroundType(directory.read<quint8>());
+    directory.skip(3);
+    info.pdfPageNum = directory.read<qint32>();
+  }
+  return directory.ok();
+}
+
+int BinaryDocument::pageCount() const
+{
+  return m_pageInfos.size();
+}
+
+const BinaryDocument::PageInfo &BinaryDocument::pageInfo(int index) const
+{
+  return m_pageInfos.at(index);
+}
+
+const QString &BinaryDocument::pdfPath() const
+{
+  return m_pdfPath;
+}
+
+QString BinaryDocument::fileName() const
+{
+  return m_file.fileName();
+}
+
+bool BinaryDocument::loadPage(int index, Page &page) const
+{
+  if (index < 0 || index >= m_chunks.size())
+  {
+    return false;
+  }
+  const Chunk &chunk = m_chunks.at(index);
+  QByteArray data(static_cast<int>(chunk.uncompressedSize), Qt::Uninitialized);
+  uLongf size = chunk.uncompressedSize;
+  if (uncompress(reinterpret_cast<Bytef *>(data.data()), &size, m_data + chunk.offset, chunk.compressedSize) != Z_OK ||
+      size != chunk.uncompressedSize)
+  {
+    return false;
+  }
+
+  ByteReader reader(reinterpret_cast<const uchar *>(data.constData()), data.size());
+  return decodeContent(reader, page);
+}
+
+void BinaryDocument::encodeStroke(ByteWriter &writer, const Stroke &stroke)
+{
+  writer.write(static_cast<quint32>(stroke.size()));
+  writer.write(static_cast<quint32>(stroke.rgba()));
+  writer.writeDouble(stroke.penWidth());
+  writer.write(patternToCode(stroke.pattern()));
+  writer.write(static_cast<quint8>(stroke.isHighlighter() ? 1 : 0));
+  writer.writePadding(2);
+  writer.writeFloats(stroke.packedCoordinates());
+  writer.writeUInt16s(stroke.packedPressures());
+}
+
+bool BinaryDocument::decodeStroke(ByteReader &reader, Stroke &stroke)
+{
+  quint32 pointCount = reader.read<quint32>();
+  stroke.setColor(QColor::fromRgba(reader.read<quint32>()));
+  stroke.setPenWidth(reader.readDouble());
+  stroke.setPattern(codeToPattern(reader.read<quint8>()));
+  stroke.setHighlighter(reader.read<quint8>() != 0);
+  reader.skip(2);
+  QVector<float> coordinates;
+  QVector<quint16> pressures;
+  if (pointCount > static_cast<quint32>(std::numeric_limits<int>::max() / 2) || !reader.readFloats(coordinates, 2 * static_cast<int>(pointCount)) ||
+      !reader.readUInt16s(pressures, static_cast<int>(pointCount)))
+  {
+    return false;
+  }
+  return stroke.setPackedPoints(coordinates, pressures);
+}
+
+void BinaryDocument::encodeContent(ByteWriter &writer, Page &page)
+{
+  const QVector<Stroke> &strokes = page.strokes();
+  writer.write(static_cast<quint32>(strokes.size()));
+  for (const Stroke &stroke : strokes)
+  {
+    encodeStroke(writer, stroke);
+  }
+
+  const auto &texts = page.texts();
+  writer.write(static_cast<quint32>(texts.size()));
+  for (const auto &text : texts)
+  {
+    writer.writeRect(std::get<0>(text));
+    writer.writeString(std::get<1>(text).toString());
+    writer.write(static_cast<quint32>(std::get<2>(text).rgba()));
+    writer.writeString(std::get<3>(text));
+  }
+
+  const auto &markdowns = page.markdowns();
+  writer.write(static_cast<quint32>(markdowns.size()));
+  for (const auto &markdown : markdowns)
+  {
+    writer.writeRect(std::get<0>(markdown));
+    writer.writeString(std::get<1>(markdown));
+  }
+}
+
+bool BinaryDocument::decodeContent(ByteReader &reader, Page &page)
+{
+  quint32 strokeCount = reader.read<quint32>();
+  QVector<Stroke> strokes;
+  for (quint32 i = 0; i < strokeCount && reader.ok(); ++i)
+  {
+    Stroke stroke;
+    if (!decodeStroke(reader, stroke))
+    {
+      return false;
+    }
+    strokes.append(stroke);
+  }
+
+  quint32 textCount = reader.read<quint32>();
+  for (quint32 i = 0; i < textCount && reader.ok(); ++i)
+  {
+    QRectF rect = reader.readRect();
+    QFont font;
+    font.fromString(reader.readString());
+    QColor color = QColor::fromRgba(reader.read<quint32>());
+    QString text = reader.readString();
+    page.appendText(rect, font, color, text);
+  }
+
+  quint32 markdownCount = reader.read<quint32>();
+  for (quint32 i = 0; i < markdownCount && reader.ok(); ++i)
+  {
+    QRectF rect = reader.readRect();
+    QString text = reader.readString();
+    page.appendMarkdown(rect, text);
+  }
+
+  page.appendStrokes(strokes);
+  return reader.ok();
+}
+
+bool BinaryDocument::encodePage(Page &page, QByteArray &chunk, quint32 &uncompressedSize)
+{
+  QByteArray data;
+  ByteWriter writer(data);
+
+  const QVector<Stroke> &strokes = page.strokes();
+  int pointCount = 0;
+  for (const Stroke &stroke : strokes)
+  {
+    pointCount += stroke.size();
+  }
+  data.reserve(4 + strokes.size() * 24 + pointCount * 10);
+  encodeContent(writer, page);
+
+  uncompressedSize = static_cast<quint32>(data.size());
+  uLongf compressedSize = compressBound(static_cast<uLong>(data.size()));
+  chunk.resize(static_cast<int>(compressedSize));
+  if (compress2(reinterpret_cast<Bytef *>(chunk.data()), &compressedSize, reinterpret_cast<const Bytef *>(data.constData()),
+                static_cast<uLong>(data.size()), Z_DEFAULT_COMPRESSION) != Z_OK)
+  {
+    return false;
+  }
+  chunk.resize(static_cast<int>(compressedSize));
+  return true;
+}
+
+bool BinaryDocument::write(const QString &fileName, QVector<Page> &pages, const QString &pdfPath)
+{
+  QVector<EncodedPage> encodedPages(pages.size());
+  for (int i = 0; i < pages.size(); ++i)
+  {
+    EncodedPage &encodedPage = encodedPages[i];
+    encodedPage.page = &pages[i];
+    auto source = std::dynamic_pointer_cast<const BinaryDocument>(pages[i].source());
+#ifdef Q_OS_WIN
+    // a mapped file cannot be replaced on Windows, so its pages are decoded
+    if (source != nullptr && QFileInfo(source->fileName()).canonicalFilePath() == QFileInfo(fileName).canonicalFilePath())
+    {
+      source = nullptr;
+    }
+#endif
+    if (source != nullptr)
+    {
+      const Chunk &chunk = source->m_chunks.at(pages[i].sourceIndex());
+      encodedPage.rawChunk = source->m_data + chunk.offset;
+      encodedPage.compressedSize = chunk.compressedSize;
+      encodedPage.uncompressedSize = chunk.uncompressedSize;
+    }
+    else
+    {
+      // stubs of other sources are loaded here, because loading is not thread safe
+      encodedPage.wasLoaded = pages[i].isLoaded();
+      pages[i].strokes();
+      // the original content of a page which failed to load can't be copied, writing it empty would destroy it
+      encodedPage.ok = !pages[i].loadFailed();
+    }
+  }
+
+  QtConcurrent::blockingMap(encodedPages, [](EncodedPage &encodedPage) {
+    if (encodedPage.rawChunk == nullptr && encodedPage.ok)
+    {
+      encodedPage.ok = encodePage(*encodedPage.page, encodedPage.chunk, encodedPage.uncompressedSize);
+      encodedPage.compressedSize = static_cast<quint32>(encodedPage.chunk.size());
+    }
+  });
+  for (const EncodedPage &encodedPage : encodedPages)
+  {
+    if (!encodedPage.wasLoaded)
+    {
+      encodedPage.page->unload();
+    }
+  }
+
+  QByteArray pdfPathData;
+  ByteWriter(pdfPathData).writeString(pdfPath);
+
+  quint64 offset = headerSize;
+  QByteArray directory;
+  directory.reserve(pages.size() * directoryEntrySize);
+  ByteWriter directoryWriter(directory);
+  for (int i = 0; i < pages.size(); ++i)
+  {
+    const EncodedPage &encodedPage = encodedPages.at(i);
+    if (!encodedPage.ok)
+    {
+      return false;
+    }
+    Page &page = pages[i];
+    directoryWriter.write(offset);
+    directoryWriter.write(encodedPage.compressedSize);
+    directoryWriter.write(encodedPage.uncompressedSize);
+    directoryWriter.writeDouble(page.width());
+    directoryWriter.writeDouble(page.height());
+    directoryWriter.write(static_cast<quint32>(page.backgroundColor().rgba()));
+    directoryWriter.write(backgroundTypeToCode(page.getBackgroundType()));
+    directoryWriter.writePadding(3);
+    directoryWriter.write(static_cast<qint32>(page.isPdf() ? page.pageNum() + 1 : 0));
+    offset += encodedPage.compressedSize;
+  }
+  quint64 pdfPathOffset = offset;
+  quint64 directoryOffset = pdfPathOffset + static_cast<quint64>(pdfPathData.size());
+
+  QByteArray header(magic, sizeof(magic));
+  ByteWriter headerWriter(header);
+  headerWriter.write(formatVersion);
+  headerWriter.write(static_cast<quint32>(pages.size()));
+  headerWriter.write(static_cast<quint32>(0));
+  headerWriter.write(directoryOffset);
+  headerWriter.write(pdfPathOffset);
+
+  QSaveFile file(fileName);
+  if (!file.open(QIODevice::WriteOnly))
+  {
+    return false;
+  }
+  file.write(header);
+  for (const EncodedPage &encodedPage : encodedPages)
+  {
+    if (encodedPage.rawChunk != nullptr)
+    {
+      file.write(reinterpret_cast<const char *>(encodedPage.rawChunk), encodedPage.compressedSize);
+    }
+    else
+    {
+      file.write(encodedPage.chunk);
+    }
+  }
+  file.write(pdfPathData);
+  file.write(directory);
+  return file.commit();
+}
+}
@@ -0,0 +1,129 @@
+#ifndef BINARYDOCUMENT_H
+#define BINARYDOCUMENT_H
+
+#include "page.h"
+
+#include <QFile>
+#include <QString>
+#include <QVector>
+
+namespace MrDoc
+{
+
+class ByteWriter;
+class ByteReader;
+
+/**
+ * @brief The BinaryDocument class reads and writes .mojb files, the binary counterpart of .moj files.
+ * @details The file is memory mapped and only the header and the page directory are read when it is opened. Every page is compressed on its
+ * own, so a page is decoded when its content is needed for the first time (see Page::setSource), independent of the number of pages in front of
+ * it. All numbers are little endian, strings are stored as byte count (u32) followed by UTF-8.
+ *
+ *     header (32 bytes)  "MOJB", format version (u32), page count (u32), flags (u32, 0), page directory offset (u64), pdf path offset (u64)
+ *     page chunks        zlib compressed page content, see below
+ *     pdf path           string, empty if the document has no pdf
+ *     page directory     per page: chunk offset (u64), compressed size (u32), uncompressed size (u32), width (f64), height (f64),
+ *                        background color (u32 ARGB), background type (u8), 3 bytes padding, pdf page (i32, first page is 1, 0 if none)
+ *
+ * The content of a page chunk is
+ *
+ *     strokes            count (u32), per stroke: point count n (u32), color (u32 ARGB), pen width (f64), pattern (u8: solid, dash, dashdot,
+ *                        dot), highlighter (u8), 2 bytes padding, n * 2 coordinates (f32), n pressures (u16, see Stroke::pressureScale)
+ *     texts              count (u32), per text: x, y, width, height (f64), font (string), color (u32 ARGB), text (string)
+ *     markdown           count (u32), per document: x, y, width, height (f64), text (string)
+ *
+ * Strokes are stored in the packed form of Stroke, so they are copied instead of converted.
+ */
+class BinaryDocument : public PageSource
+{
+public:
+  /**
+   * @brief The PageInfo struct is everything about a page which is known without decoding its chunk
+   */
+  struct PageInfo
+  {
+    qreal width;
+    qreal height;
+    QRgb backgroundColor;
+    Page::backgroundType backgroundType;
+    int pdfPageNum; /**< first page is 1, 0 if the page has no pdf background */
+  };
+
+  BinaryDocument();
+  ~BinaryDocument() override;
+  BinaryDocument(const BinaryDocument &) = delete;
+  BinaryDocument &operator=(const BinaryDocument &) = delete;
+
+  /**
+   * @brief open maps the file and reads the header and the page directory
+   * @param fileName is the full path
+   * @return true if the file is a valid .mojb file of a supported version, otherwise false
+   */
+  bool open(const QString &fileName);
+
+  int pageCount() const;
+  const PageInfo &pageInfo(int index) const;
+  /**
+   * @brief pdfPath
+   * @return the path of the pdf the pages are drawn on, empty if there is none
+   */
+  const QString &pdfPath() const;
+  QString fileName() const;
+
+  bool loadPage(int index, Page &page) const override;
+
+  /**
+   * @brief write writes @param pages as .mojb file. The file is replaced atomically. Unchanged pages which come from a BinaryDocument are copied
+   * without decoding them, including pages which failed to load (see Page::loadFailed). All other pages are encoded in parallel.
+   * @param fileName is the full path
+   * @param pages
+   * @param pdfPath is the path of the pdf the pages are drawn on
+   * @return true if successful, false if writing failed or a page which failed to load can't be copied
+   */
+  static bool write(const QString &fileName, QVector<Page> &pages, const QString &pdfPath);
+
+  /**
+   * @brief encodeStroke appends @param stroke in the layout of a stroke in a page chunk
+   */
+  static void encodeStroke(ByteWriter &writer, const Stroke &stroke);
+  static bool decodeStroke(ByteReader &reader, Stroke &stroke);
+  /**
+   * @brief encodeContent appends the strokes, texts and markdown of @param page in the (uncompressed) layout of a page chunk
+   */
+  static void encodeContent(ByteWriter &writer, Page &page);
+  /**
+   * @brief decodeContent appends the strokes, texts and markdown read by @param reader to @param page
+   * @return false if the data is truncated or invalid
+   */
+  static bool decodeContent(ByteReader &reader, Page &page);
+  static quint8 backgroundTypeToCode(Page::backgroundType type);
+  static Page::backgroundType codeToBackgroundType(quint8 code);
+
+  static const char magic[4];
+  static constexpr quint32 formatVersion = 1;
+  static constexpr int headerSize = 32;
+  static constexpr int directoryEntrySize = 44;
+
+private:
+  struct Chunk
+  {
+    quint64 offset;
+    quint32 compressedSize;
+    quint32 uncompressedSize;
+  };
+
+  /**
+   * @brief encodePage serializes and compresses the content of a loaded page
+   */
+  static bool encodePage(Page &page, QByteArray &chunk, quint32 &uncompressedSize);
+
+  QFile m_file;
+  const uchar *m_data = nullptr; /**< the mapped file */
+  qint64 m_size = 0;
+  QString m_pdfPath;
+  QVector<PageInfo> m_pageInfos;
+  QVector<Chunk> m_chunks;
+};
+}
+
+#endif // BINARYDOCUMENT_H
@@ -0,0 +1,203 @@
+#ifndef BYTESTREAM_H
+#define BYTESTREAM_H
+
+#include <QByteArray>
+#include <QRectF>
+#include <QString>
+#include <QVector>
+#include <QtEndian>
+
+#include <cstring>
+
+namespace MrDoc
+{
+
+/**
+ * @brief The ByteWriter class appends little endian numbers to a buffer
+ */
+class ByteWriter
+{
+public:
+  explicit ByteWriter(QByteArray &buffer) : m_buffer(buffer)
+  {
+  }
+
+  template <typename T> void write(T value)
+  {
+    T littleEndian = qToLittleEndian(value);
+    m_buffer.append(reinterpret_cast<const char *>(&littleEndian), sizeof(T));
+  }
+  void writeDouble(double value)
+  {
+    quint64 bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    write(bits);
+  }
+  void writeString(const QString &string)
+  {
+    QByteArray utf8 = string.toUtf8();
+    write(static_cast<quint32>(utf8.size()));
+    m_buffer.append(utf8);
+  }
+  void writeRect(const QRectF &rect)
+  {
+    writeDouble(rect.x());
+    writeDouble(rect.y());
+    writeDouble(rect.width());
+    writeDouble(rect.height());
+  }
+  void writePadding(int count)
+  {
+    m_buffer.append(count, '\0');
+  }
+  void writeFloats(const QVector<float> &values)
+  {
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+    m_buffer.append(reinterpret_cast<const char *>(values.constData()), values.size() * static_cast<int>(sizeof(float)));
+#else
+    for (float value : values)
+    {
+      quint32 bits;
+      std::memcpy(&bits, &value, sizeof(bits));
+      write(bits);
+    }
+#endif
+  }
+  void writeUInt16s(const QVector<quint16> &values)
+  {
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+    m_buffer.append(reinterpret_cast<const char *>(values.constData()), values.size() * static_cast<int>(sizeof(quint16)));
+#else
+    for (quint16 value : values)
+    {
+      write(value);
+    }
+#endif
+  }
+
+private:
+  QByteArray &m_buffer;
+};
+
+/**
+ * @brief The ByteReader class reads little endian numbers from memory. Reading past the end sets ok() to false and returns zeros.
+ */
+class ByteReader
+{
+public:
+  ByteReader(const uchar *data, qint64 size) : m_data(data), m_size(size)
+  {
+  }
+
+  template <typename T> T read()
+  {
+    if (!require(sizeof(T)))
+    {
+      return T(0);
+    }
+    T value = qFromLittleEndian<T>(m_data + m_pos);
+    m_pos += sizeof(T);
+    return value;
+  }
+  double readDouble()
+  {
+    quint64 bits = read<quint64>();
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+  }
+  QString readString()
+  {
+    quint32 size = read<quint32>();
+    if (!require(size))
+    {
+      return QString();
+    }
+    QString string = QString::fromUtf8(reinterpret_cast<const char *>(m_data + m_pos), static_cast<int>(size));
+    m_pos += size;
+    return string;
+  }
+  QRectF readRect()
+  {
+    qreal x = readDouble();
+    qreal y = readDouble();
+    qreal width = readDouble();
+    qreal height = readDouble();
+    return QRectF(x, y, width, height);
+  }
+  void skip(qint64 count)
+  {
+    if (require(count))
+    {
+      m_pos += count;
+    }
+  }
+  bool readFloats(QVector<float> &values, int count)
+  {
+    if (!require(static_cast<qint64>(count) * static_cast<qint64>(sizeof(float))))
+    {
+      return false;
+    }
+    values.resize(count);
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+    std::memcpy(values.data(), m_data + m_pos, count * sizeof(float));
+    m_pos += count * sizeof(float);
+#else
+    for (int i = 0; i < count; ++i)
+    {
+      quint32 bits = read<quint32>();
+      std::memcpy(&values[i], &bits, sizeof(float));
+    }
+#endif
+    return true;
+  }
+  bool readUInt16s(QVector<quint16> &values, int count)
+  {
+    if (!require(static_cast<qint64>(count) * static_cast<qint64>(sizeof(quint16))))
+    {
+      return false;
+    }
+    values.resize(count);
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+    std::memcpy(values.data(), m_data + m_pos, count * sizeof(quint16));
+    m_pos += count * sizeof(quint16);
+#else
+    for (int i = 0; i < count; ++i)
+    {
+      values[i] = read<quint16>();
+    }
+#endif
+    return true;
+  }
+  bool ok() const
+  {
+    return m_ok;
+  }
+  bool atEnd() const
+  {
+    return m_pos >= m_size;
+  }
+  qint64 pos() const
+  {
+    return m_pos;
+  }
+
+private:
+  bool require(qint64 count)
+  {
+    if (!m_ok || count < 0 || count > m_size - m_pos)
+    {
+      m_ok = false;
+      return false;
+    }
+    return true;
+  }
+
+  const uchar *m_data;
+  qint64 m_size;
+  qint64 m_pos = 0;
+  bool m_ok = true;
+};
+}
+
+#endif // BYTESTREAM_H
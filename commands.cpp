@@ -30,19 +30,12 @@ AddStrokeCommand::AddStrokeCommand(Widget *newWidget, int newPageNum, const MrDo
   updateSuccessive = newUpdateSuccessive;
 
   // delete duplicate points
-  for (int i = stroke.points.length() - 1; i > 0; --i)
-  {
-    if (stroke.points.at(i) == stroke.points.at(i - 1))
-    {
-      stroke.points.removeAt(i);
-      stroke.pressures.removeAt(i);
-    }
-  }
+  stroke.removeDuplicatePoints();
 }
 
 void AddStrokeCommand::undo()
 {
-  if (stroke.points.length() > 0)
+  if (!stroke.isEmpty())
   {
     if (strokeNum == -1)
     {
@@ -52,12 +45,13 @@ void AddStrokeCommand::undo()
     {
       widget->currentDocument.pages[pageNum].removeStrokeAt(strokeNum);
     }
+    widget->journal.removeStroke(pageNum, strokeNum);
   }
 }
 
 void AddStrokeCommand::redo()
 {
-  if (stroke.points.length() > 0)
+  if (!stroke.isEmpty())
   {
     if (strokeNum == -1)
     {
@@ -67,6 +61,7 @@ void AddStrokeCommand::redo()
     {
       widget->currentDocument.pages[pageNum].insertStroke(strokeNum, stroke);
     }
+    widget->journal.insertStroke(pageNum, strokeNum, stroke);
   }
 }
 
@@ -96,9 +91,10 @@ RemoveStrokeCommand::RemoveStrokeCommand(Widget *newWidget, int newPageNum, int
 void RemoveStrokeCommand::undo()
 {
   widget->currentDocument.pages[pageNum].insertStroke(strokeNum, stroke);
+  widget->journal.insertStroke(pageNum, strokeNum, stroke);
 
   qreal zoom = widget->zoom;
-  QRect updateRect = stroke.points.boundingRect().toRect();
+  QRect updateRect = stroke.boundingRectSansPenWidth().toRect();
   updateRect = QRect(zoom * updateRect.topLeft(), zoom * updateRect.bottomRight());
   int delta = zoom * 10;
   updateRect.adjust(-delta, -delta, delta, delta);
@@ -107,9 +103,10 @@ void RemoveStrokeCommand::undo()
 void RemoveStrokeCommand::redo()
 {
   widget->currentDocument.pages[pageNum].removeStrokeAt(strokeNum);
+  widget->journal.removeStroke(pageNum, strokeNum);
 
   qreal zoom = widget->zoom;
-  QRect updateRect = stroke.points.boundingRect().toRect();
+  QRect updateRect = stroke.boundingRectSansPenWidth().toRect();
   updateRect = QRect(zoom * updateRect.topLeft(), zoom * updateRect.bottomRight());
   int delta = zoom * 10;
   updateRect.adjust(-delta, -delta, delta, delta);
@@ -140,6 +137,10 @@ CreateSelectionCommand::CreateSelectionCommand(Widget *widget, int pageNum, MrDo
 void CreateSelectionCommand::undo()
 {
   m_widget->currentDocument.pages[m_pageNum].insertStrokes(m_strokesAndPositions);
+  for (int i = m_strokesAndPositions.size() - 1; i >= 0; --i)
+  {
+    m_widget->journal.insertStroke(m_pageNum, m_strokesAndPositions[i].second, m_strokesAndPositions[i].first);
+  }
 
   m_widget->setCurrentState(Widget::state::IDLE);
 }
@@ -149,6 +150,7 @@ void CreateSelectionCommand::redo()
   for (auto &sAndP : m_strokesAndPositions)
   {
     m_widget->currentDocument.pages[m_pageNum].removeStrokeAt(sAndP.second);
+    m_widget->journal.removeStroke(m_pageNum, sAndP.second);
   }
   m_widget->currentSelection = m_selection;
   m_widget->setCurrentState(Widget::state::SELECTED);
@@ -183,12 +185,15 @@ void ReleaseSelectionCommand::undo()
       {
           if(stroke.boundingRect().center().y() < 0 && pageNum > 0){
               widget->currentDocument.pages[pageNum-1].removeLastStroke();
+              widget->journal.removeStroke(pageNum-1, -1);
           }
           else if(stroke.boundingRect().center().y() > widget->currentDocument.pages[pageNum].height() && pageNum < (widget->currentDocument.pages.size() - 1)){
               widget->currentDocument.pages[pageNum+1].removeLastStroke();
+              widget->journal.removeStroke(pageNum+1, -1);
           }
           else{
               widget->currentDocument.pages[pageNum].removeLastStroke();
+              widget->journal.removeStroke(pageNum, -1);
           }
       }
   }
@@ -197,12 +202,15 @@ void ReleaseSelectionCommand::undo()
       {
           if(stroke.boundingRect().center().x() < 0 && pageNum > 0){
               widget->currentDocument.pages[pageNum-1].removeLastStroke();
+              widget->journal.removeStroke(pageNum-1, -1);
           }
           else if(stroke.boundingRect().center().x() > widget->currentDocument.pages[pageNum].width() && pageNum < (widget->currentDocument.pages.size() - 1)){
               widget->currentDocument.pages[pageNum+1].removeLastStroke();
+              widget->journal.removeStroke(pageNum+1, -1);
           }
           else{
               widget->currentDocument.pages[pageNum].removeLastStroke();
+              widget->journal.removeStroke(pageNum, -1);
           }
       }
   }
@@ -220,20 +228,19 @@ void ReleaseSelectionCommand::redo()
       for(MrDoc::Stroke stroke : widget->currentSelection.strokes()){
           if(stroke.boundingRect().center().y() < 0 && pageNum > 0){
               MrDoc::Stroke newStroke = stroke;
-              for(int i = 0; i < newStroke.points.size(); ++i){
-                  newStroke.points[i] += QPointF(0, widget->currentDocument.pages[pageNum].height());
-              }
+              newStroke.translate(QPointF(0, widget->currentDocument.pages[pageNum].height()));
               widget->currentDocument.pages[pageNum-1].appendStroke(newStroke);
+              widget->journal.insertStroke(pageNum-1, -1, newStroke);
           }
           else if(stroke.boundingRect().center().y() > widget->currentDocument.pages[pageNum].height() && pageNum < (widget->currentDocument.pages.size() - 1)){
               MrDoc::Stroke newStroke = stroke;
-              for(int i = 0; i < newStroke.points.size(); ++i){
-                  newStroke.points[i] -= QPointF(0, widget->currentDocument.pages[pageNum].height());
-              }
+              newStroke.translate(-QPointF(0, widget->currentDocument.pages[pageNum].height()));
               widget->currentDocument.pages[pageNum+1].appendStroke(newStroke);
+              widget->journal.insertStroke(pageNum+1, -1, newStroke);
           }
           else{
               widget->currentDocument.pages[pageNum].appendStroke(stroke);
+              widget->journal.insertStroke(pageNum, -1, stroke);
           }
       }
   }
@@ -242,20 +249,19 @@ void ReleaseSelectionCommand::redo()
       for(MrDoc::Stroke stroke : widget->currentSelection.strokes()){
           if(stroke.boundingRect().center().x() < 0 && pageNum > 0){
               MrDoc::Stroke newStroke = stroke;
-              for(int i = 0; i < newStroke.points.size(); ++i){
-                  newStroke.points[i] += QPointF(widget->currentDocument.pages[pageNum].width(), 0);
-              }
+              newStroke.translate(QPointF(widget->currentDocument.pages[pageNum].width(), 0));
               widget->currentDocument.pages[pageNum-1].appendStroke(newStroke);
+              widget->journal.insertStroke(pageNum-1, -1, newStroke);
           }
           else if(stroke.boundingRect().center().x() > widget->currentDocument.pages[pageNum].width() && pageNum < (widget->currentDocument.pages.size() - 1)){
               MrDoc::Stroke newStroke = stroke;
-              for(int i = 0; i < newStroke.points.size(); ++i){
-                  newStroke.points[i] -= QPointF(widget->currentDocument.pages[pageNum].width(), 0);
-              }
+              newStroke.translate(-QPointF(widget->currentDocument.pages[pageNum].width(), 0));
               widget->currentDocument.pages[pageNum+1].appendStroke(newStroke);
+              widget->journal.insertStroke(pageNum+1, -1, newStroke);
           }
           else{
               widget->currentDocument.pages[pageNum].appendStroke(stroke);
+              widget->journal.insertStroke(pageNum, -1, stroke);
           }
       }
   }
@@ -387,6 +393,7 @@ CreateMarkdownSelection::CreateMarkdownSelection(Widget *widget, int pageNum, in
 
 void CreateMarkdownSelection::redo() {
     m_widget->currentDocument.pages[m_pageNum].resetMarkdown(m_markdownIndex, QString(""), QRectF(0,0,0,0));
+    m_widget->journal.resetMarkdown(m_pageNum, m_markdownIndex, QString(""), QRectF(0,0,0,0));
     m_widget->currentMarkdownSelection = m_selection;
     m_widget->setCurrentState(Widget::state::MARKDOWN_SELECTED);
     m_widget->update();
@@ -394,6 +401,7 @@ void CreateMarkdownSelection::redo() {
 
 void CreateMarkdownSelection::undo() {
     m_widget->currentDocument.pages[m_pageNum].insertMarkdown(m_markdownIndex, m_selection.text(), m_selection.boundingRect());
+    m_widget->journal.insertMarkdown(m_pageNum, m_markdownIndex, m_selection.text(), m_selection.boundingRect());
     m_widget->setCurrentState(Widget::state::IDLE);
     m_widget->updateBuffer(m_pageNum);
     m_widget->update();
@@ -411,11 +419,13 @@ ReleaseMarkdownSelectionCommand::ReleaseMarkdownSelectionCommand(Widget *widget,
 void ReleaseMarkdownSelectionCommand::undo() {
     m_widget->currentMarkdownSelection = m_selection;
     m_widget->currentDocument.pages[m_pageNum].resetMarkdown(m_markdownIndex, QString(""), QRectF(0,0,0,0));
+    m_widget->journal.resetMarkdown(m_pageNum, m_markdownIndex, QString(""), QRectF(0,0,0,0));
     m_widget->setCurrentState(Widget::state::MARKDOWN_SELECTED);
 }
 
 void ReleaseMarkdownSelectionCommand::redo() {
     m_markdownIndex = m_widget->currentDocument.pages[m_pageNum].appendMarkdown(m_selection.boundingRect(), m_selection.text());
+    m_widget->journal.appendMarkdown(m_pageNum, m_selection.boundingRect(), m_selection.text());
     m_widget->setCurrentState(Widget::state::IDLE);
 }
 
@@ -473,8 +483,8 @@ AddPageCommand::AddPageCommand(Widget *newWidget, int newPageNum, QUndoCommand *
 void AddPageCommand::undo()
 {
   widget->currentDocument.pages.removeAt(pageNum);
-  widget->pageBufferPtr.removeAt(pageNum);
-  widget->prevZoom = -1; //workaround (otherwise nothing will happen because updateNecesseryPages gets called
+  widget->journal.removePage(pageNum);
+  widget->prevZoom = -1; //workaround, so that the tile cache is cleared (page indices changed)
   widget->updateAllPageBuffers();
   widget->update();
 }
@@ -494,8 +504,8 @@ void AddPageCommand::redo()
   page.setBackgroundColor(widget->currentDocument.pages[pageNumForSettings].backgroundColor());
 
   widget->currentDocument.pages.insert(pageNum, page);
-  widget->pageBufferPtr.insert(pageNum, std::make_shared<std::shared_ptr<QPixmap>>(std::make_shared<QPixmap>()));
-  widget->prevZoom = -1; //workaround (otherwise nothing will happen because updateNecesseryPages gets called
+  widget->journal.insertPage(pageNum, page);
+  widget->prevZoom = -1; //workaround, so that the tile cache is cleared (page indices changed)
   widget->updateAllPageBuffers();
   //widget->updateBuffer(pageNum);
   widget->update();
@@ -516,8 +526,8 @@ RemovePageCommand::RemovePageCommand(Widget *newWidget, int newPageNum, QUndoCom
 void RemovePageCommand::undo()
 {
   widget->currentDocument.pages.insert(pageNum, page);
-  widget->pageBufferPtr.insert(pageNum, std::make_shared<std::shared_ptr<QPixmap>>(std::make_shared<QPixmap>()));
-  widget->prevZoom = -1; //workaround (otherwise nothing will happen because updateNecesseryPages gets called
+  widget->journal.insertPage(pageNum, page);
+  widget->prevZoom = -1; //workaround, so that the tile cache is cleared (page indices changed)
   widget->updateAllPageBuffers();
   //widget->updateBuffer(pageNum);
   widget->update();
@@ -526,8 +536,8 @@ void RemovePageCommand::undo()
 void RemovePageCommand::redo()
 {
   widget->currentDocument.pages.removeAt(pageNum);
-  widget->pageBufferPtr.removeAt(pageNum);
-  widget->prevZoom = -1; //workaround (otherwise nothing will happen because updateNecesseryPages gets called
+  widget->journal.removePage(pageNum);
+  widget->prevZoom = -1; //workaround, so that the tile cache is cleared (page indices changed)
   widget->updateAllPageBuffers();
   widget->update();
 }
@@ -609,6 +619,7 @@ void ChangePageSettingsCommand::undo()
   widget->currentDocument.pages[pageNum].setHeight(height);
   widget->currentDocument.pages[pageNum].setBackgroundColor(prevBackgroundColor);
   widget->currentDocument.pages[pageNum].setBackgroundType(prevBackgroundType);
+  widget->journal.changePageSettings(pageNum, widget->currentDocument.pages[pageNum]);
   widget->updateBuffer(pageNum);
   widget->setGeometry(widget->getWidgetGeometry());
 }
@@ -621,6 +632,7 @@ void ChangePageSettingsCommand::redo()
   widget->currentDocument.pages[pageNum].setHeight(height);
   widget->currentDocument.pages[pageNum].setBackgroundColor(backgroundColor);
   widget->currentDocument.pages[pageNum].setBackgroundType(backgroundType);
+  widget->journal.changePageSettings(pageNum, widget->currentDocument.pages[pageNum]);
   widget->updateBuffer(pageNum);
   widget->setGeometry(widget->getWidgetGeometry());
 }
@@ -647,12 +659,14 @@ ChangeTextCommand::ChangeTextCommand(Widget* widget, int pageNum, MrDoc::Page* p
 
 void ChangeTextCommand::undo(){
     m_page->setText(m_textIndex, m_prevFont, m_prevColor, m_prevText);
+    m_widget->journal.setText(m_pageNum, m_textIndex, m_prevFont, m_prevColor, m_prevText);
     m_widget->updateBuffer(m_pageNum);
     m_widget->update();
 }
 
 void ChangeTextCommand::redo(){
     m_page->setText(m_textIndex, m_font, m_color, m_text);
+    m_widget->journal.setText(m_pageNum, m_textIndex, m_font, m_color, m_text);
     m_widget->updateBuffer(m_pageNum);
     m_widget->update();
 }
@@ -674,12 +688,14 @@ TextCommand::TextCommand(Widget* widget, int pageNum, MrDoc::Page *page, const Q
 
 void TextCommand::undo(){
     m_page->setText(m_textIndex, m_font, m_color, QString("")); //has the effect of removing it
+    m_widget->journal.setText(m_pageNum, m_textIndex, m_font, m_color, QString(""));
     m_widget->updateBuffer(m_pageNum);
     m_widget->update();
 }
 
 void TextCommand::redo(){
     m_textIndex = m_page->appendText(m_rect, m_font, m_color, m_text);
+    m_widget->journal.appendText(m_pageNum, m_rect, m_font, m_color, m_text);
     m_widget->updateBuffer(m_pageNum);
     m_widget->update();
 }
@@ -700,12 +716,14 @@ ChangeMarkdownCommand::ChangeMarkdownCommand(Widget *widget, int pageNum, MrDoc:
 
 void ChangeMarkdownCommand::undo(){
     m_page->resetMarkdown(m_markdownIndex, m_prevText, m_rect);
+    m_widget->journal.resetMarkdown(m_pageNum, m_markdownIndex, m_prevText, m_rect);
     m_widget->updateBuffer(m_pageNum);
     m_widget->update();
 }
 
 void ChangeMarkdownCommand::redo(){
     m_page->resetMarkdown(m_markdownIndex, m_text, m_rect);
+    m_widget->journal.resetMarkdown(m_pageNum, m_markdownIndex, m_text, m_rect);
     m_widget->updateBuffer(m_pageNum);
     m_widget->update();
 }
@@ -725,12 +743,14 @@ MarkdownCommand::MarkdownCommand(Widget *widget, int pageNum, MrDoc::Page *page,
 
 void MarkdownCommand::undo(){
     m_page->resetMarkdown(m_markdowIndex, QString(""), QRectF(0,0,0,0)); //has the effect of removing it
+    m_widget->journal.resetMarkdown(m_pageNum, m_markdowIndex, QString(""), QRectF(0,0,0,0));
     m_widget->updateBuffer(m_pageNum);
     m_widget->update();
 }
 
 void MarkdownCommand::redo(){
     m_markdowIndex = m_page->appendMarkdown(QRectF(m_upperLeft, m_upperLeft), m_text);
+    m_widget->journal.appendMarkdown(m_pageNum, QRectF(m_upperLeft, m_upperLeft), m_text);
     m_widget->updateBuffer(m_pageNum);
     m_widget->update();
 }
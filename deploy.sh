@@ -1,3 +1,3 @@
 #!/bin/bash
 # Quickly deploy on a Mac. This only works on my Mac.
-macdeployqt ../builds/MrWriter-Desktop_Qt_5_5_1_clang_64bit2-Release/MrWriter.app -verbose=2
+macdeployqt ../builds/MrWriter-Desktop_Qt_5_5_1_clang_64bit2-Release/app/MrWriter.app -verbose=2
@@ -0,0 +1,195 @@
+#include "displaylist.h"
+
+namespace MrDoc
+{
+
+DisplayList::DisplayList()
+{
+}
+
+void DisplayList::build(const QVector<Stroke> &strokes)
+{
+  m_items.clear();
+  m_itemOfStroke.clear();
+  m_itemOfStroke.reserve(strokes.size());
+  for (int i = 0; i < strokes.size(); ++i)
+  {
+    record(m_items, strokes.at(i), i);
+    m_itemOfStroke.append(m_items.size() - 1);
+  }
+  m_valid = true;
+}
+
+void DisplayList::append(const QVector<Stroke> &strokes)
+{
+  if (!m_valid || m_itemOfStroke.size() != strokes.size() - 1)
+  {
+    invalidate();
+    return;
+  }
+  record(m_items, strokes.last(), strokes.size() - 1);
+  m_itemOfStroke.append(m_items.size() - 1);
+}
+
+void DisplayList::insert(const QVector<Stroke> &strokes, int position)
+{
+  if (!m_valid || m_itemOfStroke.size() != strokes.size() - 1)
+  {
+    invalidate();
+    return;
+  }
+  if (position == strokes.size() - 1)
+  {
+    append(strokes);
+    return;
+  }
+  // the stroke joins the item of the stroke before it, or the first item if it is inserted at the front
+  int itemIndex = position > 0 ? m_itemOfStroke.at(position - 1) : 0;
+  const Item &item = m_items.at(itemIndex);
+  rerecord(strokes, itemIndex, item.firstStroke, item.firstStroke + item.strokeCount + 1, 1);
+}
+
+void DisplayList::remove(const QVector<Stroke> &strokes, int position)
+{
+  if (!m_valid || m_itemOfStroke.size() != strokes.size() + 1)
+  {
+    invalidate();
+    return;
+  }
+  int itemIndex = m_itemOfStroke.at(position);
+  const Item &item = m_items.at(itemIndex);
+  rerecord(strokes, itemIndex, item.firstStroke, item.firstStroke + item.strokeCount - 1, -1);
+}
+
+void DisplayList::update(const QVector<Stroke> &strokes, int position)
+{
+  if (!m_valid || m_itemOfStroke.size() != strokes.size())
+  {
+    invalidate();
+    return;
+  }
+  int itemIndex = m_itemOfStroke.at(position);
+  const Item &item = m_items.at(itemIndex);
+  rerecord(strokes, itemIndex, item.firstStroke, item.firstStroke + item.strokeCount, 0);
+}
+
+void DisplayList::invalidate()
+{
+  m_items.clear();
+  m_itemOfStroke.clear();
+  m_valid = false;
+}
+
+bool DisplayList::isValid() const
+{
+  return m_valid;
+}
+
+void DisplayList::paint(QPainter &painter, qreal zoom, const QVector<Stroke> &strokes) const
+{
+  for (const Item &item : m_items)
+  {
+    paintItem(painter, zoom, strokes, item);
+  }
+}
+
+void DisplayList::paint(QPainter &painter, qreal zoom, const QVector<Stroke> &strokes, const QVector<int> &strokeIndices) const
+{
+  int previousItem = -1;
+  for (int strokeIndex : strokeIndices)
+  {
+    int itemIndex = m_itemOfStroke.at(strokeIndex);
+    if (itemIndex != previousItem)
+    {
+      paintItem(painter, zoom, strokes, m_items.at(itemIndex));
+      previousItem = itemIndex;
+    }
+  }
+}
+
+bool DisplayList::isBatchable(const Stroke &stroke)
+{
+  // overlapping translucent strokes (e.g. highlighters) have to be blended twice, so they are not merged
+  return !stroke.isHighlighter() && stroke.color().alpha() == 255 && stroke.size() > 1 && stroke.pattern() == solidLinePattern;
+}
+
+void DisplayList::record(QVector<Item> &items, const Stroke &stroke, int strokeIndex)
+{
+  if (isBatchable(stroke))
+  {
+    if (!items.isEmpty())
+    {
+      Item &lastItem = items.last();
+      if (!lastItem.path.isEmpty() && lastItem.color == stroke.color() && lastItem.strokeCount < maxStrokesPerBatch)
+      {
+        lastItem.path.addPath(*stroke.outline());
+        ++lastItem.strokeCount;
+        return;
+      }
+    }
+    Item item;
+    item.path = *stroke.outline();
+    item.color = stroke.color();
+    item.firstStroke = strokeIndex;
+    item.strokeCount = 1;
+    items.append(item);
+  }
+  else
+  {
+    Item item;
+    item.firstStroke = strokeIndex;
+    item.strokeCount = 1;
+    items.append(item);
+  }
+}
+
+void DisplayList::rerecord(const QVector<Stroke> &strokes, int itemIndex, int strokeBegin, int strokeEnd, int delta)
+{
+  // the new items are not merged with their neighbours, so the items before and behind them keep their paths
+  QVector<Item> items;
+  for (int i = strokeBegin; i < strokeEnd; ++i)
+  {
+    record(items, strokes.at(i), i);
+  }
+  m_items.remove(itemIndex);
+  for (int i = 0; i < items.size(); ++i)
+  {
+    m_items.insert(itemIndex + i, items.at(i));
+  }
+  int itemDelta = items.size() - 1;
+  for (int i = itemIndex + items.size(); i < m_items.size(); ++i)
+  {
+    m_items[i].firstStroke += delta;
+  }
+
+  m_itemOfStroke.remove(strokeBegin, strokeEnd - delta - strokeBegin);
+  int strokeIndex = strokeBegin;
+  for (int i = 0; i < items.size(); ++i)
+  {
+    for (int j = 0; j < items.at(i).strokeCount; ++j)
+    {
+      m_itemOfStroke.insert(strokeIndex++, itemIndex + i);
+    }
+  }
+  if (itemDelta != 0)
+  {
+    for (int i = strokeEnd; i < m_itemOfStroke.size(); ++i)
+    {
+      m_itemOfStroke[i] += itemDelta;
+    }
+  }
+}
+
+void DisplayList::paintItem(QPainter &painter, qreal zoom, const QVector<Stroke> &strokes, const Item &item) const
+{
+  if (item.path.isEmpty())
+  {
+    strokes.at(item.firstStroke).paint(painter, zoom);
+    return;
+  }
+  QTransform oldTransform = painter.transform();
+  painter.scale(zoom, zoom);
+  painter.fillPath(item.path, item.color);
+  painter.setTransform(oldTransform);
+}
+}
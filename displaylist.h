@@ -0,0 +1,105 @@
+#ifndef DISPLAYLIST_H
+#define DISPLAYLIST_H
+
+#include <QColor>
+#include <QPainter>
+#include <QPainterPath>
+#include <QRectF>
+#include <QVector>
+
+#include "stroke.h"
+
+namespace MrDoc
+{
+
+/**
+ * @brief The DisplayList class is the compiled form of the strokes of a page.
+ * @details Consecutive solid pen strokes of the same colour are merged into a single path, which is filled with one call. All other strokes
+ * (dashed strokes, highlighters, dots) keep their own item and are painted by Stroke::paint. Items are in stroke order, so the z-order of the
+ * strokes is preserved. The list is recorded at zoom factor 1 and replayed at any zoom by scaling the painter.
+ */
+class DisplayList
+{
+public:
+  DisplayList();
+
+  /**
+   * @brief build records all strokes
+   * @param strokes
+   */
+  void build(const QVector<Stroke> &strokes);
+  /**
+   * @brief append records the last stroke of @param strokes, which has to be appended after the list was built
+   */
+  void append(const QVector<Stroke> &strokes);
+  /**
+   * @brief insert records the stroke which was inserted into @param strokes at @param position. Only the item the stroke is added to is
+   * recorded again.
+   */
+  void insert(const QVector<Stroke> &strokes, int position);
+  /**
+   * @brief remove removes the stroke at @param position. @param strokes are the strokes without the removed one. Only the item the stroke
+   * was recorded in is recorded again.
+   */
+  void remove(const QVector<Stroke> &strokes, int position);
+  /**
+   * @brief update records the stroke at @param position again after its points, pen width, colour or pattern changed
+   */
+  void update(const QVector<Stroke> &strokes, int position);
+  /**
+   * @brief invalidate drops the list. It has to be rebuilt before it can be painted again.
+   */
+  void invalidate();
+  bool isValid() const;
+
+  /**
+   * @brief paint replays the whole list
+   * @param painter
+   * @param zoom
+   * @param strokes the strokes the list was built from
+   */
+  void paint(QPainter &painter, qreal zoom, const QVector<Stroke> &strokes) const;
+  /**
+   * @brief paint replays only the items containing one of the given strokes. Batches are painted completely, so the painter has to be clipped
+   * to the region the strokes were queried for.
+   * @param painter
+   * @param zoom
+   * @param strokes the strokes the list was built from
+   * @param strokeIndices indices of the strokes to paint in ascending order
+   */
+  void paint(QPainter &painter, qreal zoom, const QVector<Stroke> &strokes, const QVector<int> &strokeIndices) const;
+
+  static constexpr int maxStrokesPerBatch = 64; /**< keeps the paths small, so that painting a small region does not fill huge paths */
+
+private:
+  struct Item
+  {
+    QPainterPath path; /**< merged outlines, empty if the item is a single stroke painted by Stroke::paint */
+    QColor color;
+    int firstStroke;
+    int strokeCount;
+  };
+
+  static bool isBatchable(const Stroke &stroke);
+  /**
+   * @brief record appends @param stroke to the last of @param items or adds a new item
+   */
+  static void record(QVector<Item> &items, const Stroke &stroke, int strokeIndex);
+  /**
+   * @brief rerecord replaces the item @param itemIndex by the items of the strokes from @param strokeBegin to @param strokeEnd
+   * @param strokes
+   * @param itemIndex
+   * @param strokeBegin
+   * @param strokeEnd
+   * @param delta is the number of strokes added (1), removed (-1) or changed (0) within the item
+   */
+  void rerecord(const QVector<Stroke> &strokes, int itemIndex, int strokeBegin, int strokeEnd, int delta);
+  void paintItem(QPainter &painter, qreal zoom, const QVector<Stroke> &strokes, const Item &item) const;
+
+  QVector<Item> m_items;
+  QVector<int> m_itemOfStroke; /**< index of the item every stroke is recorded in */
+  bool m_valid = false;
+};
+}
+
+#endif // DISPLAYLIST_H
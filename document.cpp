@@ -1,26 +1,63 @@
 #include "document.h"
 
+#include "binarydocument.h"
+#include "linedocument.h"
 #include "qcompressor.h"
+#include "gzipdevice.h"
+#include "numberparser.h"
+#include "numberwriter.h"
 #include "version.h"
 
+#include <poppler-version.h>
+
 #include <QPdfWriter>
-#include <QPrinter>
 #include <QPageSize>
 #include <iostream>
 #include <QXmlStreamReader>
 #include <QFile>
+#include <QSaveFile>
 #include <QFileInfo>
-#include <QErrorMessage>
 //#include <QSvgGenerator>
 #include <QDebug>
+#include <QHash>
+#include <QFontMetricsF>
+#include <QLinkedList>
+#include <QtConcurrent>
+#include <QQueue>
+#include <QtMath>
 
 #include <zlib.h>
+#include <limits>
+#include <algorithm>
 
 // static members
 
 namespace MrDoc
 {
 
+namespace
+{
+/**
+ * @brief The ColorNames class caches the #RRGGBBAA strings of the colors written to a file. Documents only use a handful of colors.
+ */
+class ColorNames
+{
+public:
+  const QString &name(QRgb rgba)
+  {
+    auto it = m_names.find(rgba);
+    if (it == m_names.end())
+    {
+      it = m_names.insert(rgba, QString::asprintf("#%02x%02x%02x%02x", qRed(rgba), qGreen(rgba), qBlue(rgba), qAlpha(rgba)));
+    }
+    return *it;
+  }
+
+private:
+  QHash<QRgb, QString> m_names;
+};
+}
+
 Document::Document()
 {
   for (int i = 0; i < 1; ++i)
@@ -85,20 +122,154 @@ pages[pageNum+1].height()));
 }
 */
 
-void Document::exportPDF(QString fileName)
+bool Document::canExportWithAnnotations()
+{
+  if (m_pdfDoc == nullptr || pages.size() != m_pdfDoc->document->numPages())
+  {
+    return false;
+  }
+  for (int i = 0; i < pages.size(); ++i)
+  {
+    if (!pages[i].isPdf() || pages[i].pageNum() != i)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool Document::exportPDFWithAnnotations(const QString &fileName)
+{
+  // the annotations are added to a second instance, the pdf shown by the widget is not changed
+  std::unique_ptr<Poppler::Document> exportDoc(Poppler::Document::load(m_pdfPath));
+  if (exportDoc == nullptr || exportDoc->isLocked() || exportDoc->numPages() != pages.size())
+  {
+    return false;
+  }
+
+  for (int pageNum = 0; pageNum < pages.size(); ++pageNum)
+  {
+    std::unique_ptr<Poppler::Page> exportPage(exportDoc->page(pageNum));
+    if (exportPage == nullptr)
+    {
+      return false;
+    }
+    // stubs are loaded for exporting and given back afterwards
+    bool wasLoaded = pages[pageNum].isLoaded();
+    // annotation coordinates are relative to the page size
+    qreal width = pages[pageNum].width();
+    qreal height = pages[pageNum].height();
+    auto normalized = [width, height](const QRectF &rect) {
+      return QRectF(rect.x() / width, rect.y() / height, rect.width() / width, rect.height() / height);
+    };
+
+    for (const Stroke &stroke : pages[pageNum].strokes())
+    {
+      Poppler::InkAnnotation ink;
+      Poppler::Annotation::Style style;
+      QColor color = stroke.color();
+      style.setOpacity(color.alphaF());
+      color.setAlpha(255);
+      style.setColor(color);
+      style.setWidth(stroke.penWidth());
+      if (stroke.pattern() != MrDoc::solidLinePattern)
+      {
+        // dash patterns are in units of the pen width
+        QVector<double> dashArray;
+        for (qreal dash : stroke.pattern())
+        {
+          dashArray.append(dash * stroke.penWidth());
+        }
+        style.setLineStyle(Poppler::Annotation::Dashed);
+        style.setDashArray(dashArray);
+      }
+      ink.setStyle(style);
+
+      QLinkedList<QPointF> path;
+      for (int k = 0; k < stroke.size(); ++k)
+      {
+        QPointF point = stroke.point(k);
+        path.append(QPointF(point.x() / width, point.y() / height));
+      }
+      ink.setInkPaths(QList<QLinkedList<QPointF>>() << path);
+      ink.setBoundary(normalized(stroke.boundingRect()));
+      // the page copies the annotation
+      exportPage->addAnnotation(&ink);
+    }
+
+    Poppler::Annotation::Style noBorder;
+    noBorder.setWidth(0.0);
+    for (const auto &text : pages[pageNum].texts())
+    {
+      QRectF rect = std::get<0>(text);
+      const QFont &font = std::get<1>(text);
+      if (rect.width() <= 0.0 || rect.height() <= 0.0)
+      {
+        // texts of loaded files are only positioned until they are painted, see Page::paintInk
+        rect = QFontMetricsF(font).boundingRect(QRectF(rect.x(), rect.y(), width - rect.x(), height - rect.y()), Qt::TextWordWrap,
+                                                std::get<3>(text));
+      }
+      Poppler::TextAnnotation textAnnotation(Poppler::TextAnnotation::InPlace);
+      textAnnotation.setContents(std::get<3>(text));
+      textAnnotation.setTextFont(font);
+#if POPPLER_VERSION_MAJOR > 0 || POPPLER_VERSION_MINOR >= 69
+      textAnnotation.setTextColor(std::get<2>(text));
+#endif
+      textAnnotation.setStyle(noBorder);
+      textAnnotation.setBoundary(normalized(rect));
+      exportPage->addAnnotation(&textAnnotation);
+    }
+    for (const auto &markdown : pages[pageNum].markdowns())
+    {
+      // free text annotations have no markup, the rendered text is kept
+      Poppler::TextAnnotation textAnnotation(Poppler::TextAnnotation::InPlace);
+      textAnnotation.setContents(MarkdownRenderer::instance()->plainText(std::get<1>(markdown)));
+      textAnnotation.setTextFont(QFont());
+      textAnnotation.setStyle(noBorder);
+      textAnnotation.setBoundary(normalized(std::get<0>(markdown)));
+      exportPage->addAnnotation(&textAnnotation);
+    }
+
+    if (!wasLoaded)
+    {
+      pages[pageNum].unload();
+    }
+  }
+
+  // the pdf is read while it is converted, so it can only be replaced when the conversion is complete
+  QSaveFile file(fileName);
+  if (!file.open(QIODevice::WriteOnly))
+  {
+    return false;
+  }
+  std::unique_ptr<Poppler::PDFConverter> converter(exportDoc->pdfConverter());
+  converter->setOutputDevice(&file);
+  converter->setPDFOptions(converter->pdfOptions() | Poppler::PDFConverter::WithChanges);
+  if (!converter->convert())
+  {
+    file.cancelWriting();
+    return false;
+  }
+  return file.commit();
+}
+
+bool Document::exportPDF(QString fileName)
 {
     if(m_pdfPath.isEmpty()){
-        exportPDFAsImage(fileName);
-        return;
+        return exportPDFAsImage(fileName);
+    }
+
+    if (canExportWithAnnotations())
+    {
+      return exportPDFWithAnnotations(fileName);
     }
 
-    QString overlay = "overlay.pdf";
+    // named after the exported file, so that several documents can be exported into the same directory at once
+    QString overlay = QFileInfo(fileName).completeBaseName() + "-overlay.pdf";
     QString overlayFileName = QUrl(fileName).adjusted(QUrl::RemoveFilename).toString();
     overlayFileName += overlay;
 
-    QPrinter pdfWriter(QPrinter::HighResolution);
-    pdfWriter.setOutputFormat(QPrinter::PdfFormat);
-    pdfWriter.setOutputFileName(overlayFileName);
+    QPdfWriter pdfWriter(overlayFileName);
 
     pdfWriter.setPageSize(QPageSize(QSizeF(pages[0].width(), pages[0].height()), QPageSize::Point));
     pdfWriter.setPageMargins(QMarginsF(0, 0, 0, 0));
@@ -110,7 +281,6 @@ void Document::exportPDF(QString fileName)
 //        zoom = zoomH;
 
     pdfWriter.setResolution(72);
-    pdfWriter.pageLayout().setUnits(QPageLayout::Point);
     QPainter painter;
     painter.begin(&pdfWriter);
     painter.setRenderHint(QPainter::Antialiasing, true);
@@ -154,11 +324,11 @@ void Document::exportPDF(QString fileName)
         else{
             if (pages[pageNum].backgroundColor() != QColor("white"))
             {
-                QRectF pageRect = pdfWriter.pageRect(QPrinter::Point);
-                pageRect.translate(-pageRect.topLeft());
+                QRectF pageRect(0, 0, pages[pageNum].width(), pages[pageNum].height());
                 painter.fillRect(pageRect, pages[pageNum].backgroundColor());
             }
-            pages[pageNum].paint(painter, 1);
+            pages[pageNum].paintBackground(painter, 1);
+            pages[pageNum].paintForPdfExport(painter, 1);
         }
 
         if (pageNum + 1 < pages.size())
@@ -194,7 +364,7 @@ void Document::exportPDF(QString fileName)
 //        qDebug() << pdfExtendIntervals[i];
 //    }
 
-    QString extended = "extended.pdf";
+    QString extended = QFileInfo(fileName).completeBaseName() + "-extended.pdf";
     QString extendedPdfFileName = QUrl(fileName).adjusted(QUrl::RemoveFilename).toString();
     extendedPdfFileName += extended;
 
@@ -202,141 +372,449 @@ void Document::exportPDF(QString fileName)
     extendProcess.start("pdftk", QStringList() << "A="+m_pdfPath << "B="+overlayFileName <<
                         "cat" << pdfExtendIntervals << "output" << extendedPdfFileName);
 
-    if(extendProcess.error() == QProcess::FailedToStart){
-        QMessageBox::StandardButton answer = QMessageBox::warning(nullptr, QObject::tr("Failed to start pdftk"), QObject::tr("Failed to start pdftk. \nCheck if you have "
-                                                                   "pdftk installed and the permission to start it.\n"
-                                                                   "Do you want to resume (PDF will be exported as image)?"),
-                             QMessageBox::Ignore | QMessageBox::Abort);
-        if(answer == QMessageBox::Ignore){
-            exportPDFAsImage(fileName);
-            return;
-        }
-        else{
-            return;
-        }
-        QDir dir(overlayFileName);
-        dir.remove(overlay);
+    // the caller offers to export as image instead
+    if(!extendProcess.waitForStarted()){
+        return false;
     }
     extendProcess.waitForFinished();
 
     QProcess process;
     process.start("pdftk", QStringList() << extendedPdfFileName << "multistamp" <<
                   overlayFileName << "output" << fileName);
+    if(!process.waitForStarted()){
+        return false;
+    }
     process.waitForFinished();
     QDir dir(QUrl(fileName).adjusted(QUrl::RemoveFilename).toString());
     //dir.remove(overlay);
     //dir.remove(extended);
+    return extendProcess.exitCode() == 0 && process.exitStatus() == QProcess::NormalExit && process.exitCode() == 0;
 }
 
-void Document::exportPDFAsImage(QString fileName){
-    QPrinter pdfWriter(QPrinter::HighResolution);
-    pdfWriter.setOutputFormat(QPrinter::PdfFormat);
-    pdfWriter.setOutputFileName(fileName);
-    pdfWriter.setPageSize(QPageSize(QSizeF(pages[0].width(), pages[0].height()), QPageSize::Point));
-    pdfWriter.setPageMargins(QMarginsF(0, 0, 0, 0));
-    //*2 is a little bit arbitrarily
-    pdfWriter.setResolution(72*2);
-    pdfWriter.pageLayout().setUnits(QPageLayout::Point);
-    QPainter painter;
-    painter.begin(&pdfWriter);
-    painter.setRenderHint(QPainter::Antialiasing, true);
-    for (int pageNum = 0; pageNum < pages.size(); ++pageNum)
+QImage Document::rasterizePage(Page page, qreal zoom)
+{
+  QImage image(QSize(qCeil(page.width() * zoom), qCeil(page.height() * zoom)), QImage::Format_RGB32);
+  image.fill(page.backgroundColor());
+  QPainter painter;
+  painter.begin(&image);
+  painter.setRenderHint(QPainter::Antialiasing, true);
+  page.paint(painter, zoom);
+  painter.end();
+  return image;
+}
+
+bool Document::exportPDFAsImage(const QString &fileName, const std::function<bool(int)> &progress)
+{
+  if (pages.isEmpty())
+  {
+    return false;
+  }
+
+  QSaveFile file(fileName);
+  if (!file.open(QIODevice::WriteOnly))
+  {
+    return false;
+  }
+
+  QPdfWriter pdfWriter(&file);
+  pdfWriter.setCreator(PRODUCT_NAME);
+  pdfWriter.setPageSize(QPageSize(QSizeF(pages[0].width(), pages[0].height()), QPageSize::Point));
+  pdfWriter.setPageMargins(QMarginsF(0, 0, 0, 0));
+  pdfWriter.setResolution(qRound(72 * imageExportZoom));
+
+  // The pages are rasterized in parallel and written one after another, in order. Only a few pages are rasterized ahead of the writer, so
+  // the memory needed does not depend on the length of the document. Every task gets its own copy of the page, because painting changes it
+  // (see Page::load and Page::paintInk).
+  QQueue<QFuture<QImage>> rasterized;
+  int maxRasterized = 2 * qMax(1, QThread::idealThreadCount());
+  int nextPage = 0;
+  bool cancelled = false;
+
+  QPainter painter;
+  if (!painter.begin(&pdfWriter))
+  {
+    file.cancelWriting();
+    return false;
+  }
+  for (int pageNum = 0; pageNum < pages.size(); ++pageNum)
+  {
+    while (nextPage < pages.size() && rasterized.size() < maxRasterized)
     {
-        if (pages[pageNum].backgroundColor() != QColor("white"))
-        {
-            QRectF pageRect = pdfWriter.pageRect(QPrinter::Point);
-            pageRect.translate(-pageRect.topLeft());
-            painter.fillRect(pageRect, pages[pageNum].backgroundColor());
-        }
-        //2 (as zoom) is a little bit arbitrarily (has to be the same number as above)
-        pages[pageNum].paint(painter, 2, QRect(0, 0, 0, 0));
+      Page page = pages.at(nextPage);
+      rasterized.enqueue(QtConcurrent::run([page]() { return rasterizePage(page, imageExportZoom); }));
+      ++nextPage;
+    }
+    if (pageNum > 0)
+    {
+      pdfWriter.setPageSize(QPageSize(QSizeF(pages[pageNum].width(), pages[pageNum].height()), QPageSize::Point));
+      pdfWriter.newPage();
+    }
+    painter.drawImage(QPoint(0, 0), rasterized.dequeue().result());
 
-        if (pageNum + 1 < pages.size())
-        {
-            pdfWriter.setPageSize(QPageSize(QSize(pages[pageNum + 1].width(), pages[pageNum + 1].height())));
-            pdfWriter.newPage();
-        }
+    if (progress && !progress(pageNum + 1))
+    {
+      cancelled = true;
+      break;
     }
-    painter.end();
+  }
+  painter.end();
+
+  // pages which were rasterized ahead are not needed any more
+  while (!rasterized.isEmpty())
+  {
+    rasterized.dequeue().waitForFinished();
+  }
+
+  if (cancelled)
+  {
+    file.cancelWriting();
+  }
+  return file.commit();
 }
 
-bool Document::loadXOJ(QString fileName)
+bool Document::readDocumentData(const QString &fileName, QByteArray &xml)
 {
-    QFile file(fileName);
-    if (!file.open(QIODevice::ReadOnly))
+  QFile file(fileName);
+  if (!file.open(QIODevice::ReadOnly))
+  {
+    return false;
+  }
+
+  // check if it is a gzipped file
+  QByteArray s = file.peek(2);
+  if (s.size() != 2)
+  {
+    return false;
+  }
+  if (s.at(0) != static_cast<char>(0x1f) || s.at(1) != static_cast<char>(0x8b))
+  {
+    xml = file.readAll();
+    return true;
+  }
+
+  // the compressed data is inflated chunk by chunk, so it is never completely in memory
+  GzipDevice gzipDevice(&file);
+  if (!gzipDevice.open(QIODevice::ReadOnly))
+  {
+    return false;
+  }
+  xml.clear();
+  xml.reserve(static_cast<int>(qMin<qint64>(GzipDevice::uncompressedSizeHint(&file), std::numeric_limits<int>::max() / 2)));
+  char buffer[GZIP_CHUNK_SIZE];
+  qint64 read;
+  while ((read = gzipDevice.read(buffer, sizeof(buffer))) > 0)
+  {
+    xml.append(buffer, static_cast<int>(read));
+  }
+  bool ok = read == 0 && !gzipDevice.hasError();
+  gzipDevice.close();
+  return ok;
+}
+
+bool Document::splitPages(const QByteArray &xml, QVector<ParsedPage> &parsedPages)
+{
+  // Text content and attribute values escape '<', so every "<page" outside of the tags is the start of a page element. Pages are not nested.
+  const QByteArray startTag("<page");
+  const QByteArray endTag("</page>");
+  int pos = 0;
+  while ((pos = xml.indexOf(startTag, pos)) != -1)
+  {
+    int afterName = pos + startTag.size();
+    if (afterName >= xml.size())
     {
+      return false;
+    }
+    char c = xml.at(afterName);
+    if (c != ' ' && c != '\t' && c != '\r' && c != '\n' && c != '>' && c != '/')
+    {
+      // another element starting with "page"
+      pos = afterName;
+      continue;
+    }
+
+    int tagEnd = xml.indexOf('>', afterName);
+    if (tagEnd == -1)
+    {
+      return false;
+    }
+    int end;
+    if (xml.at(tagEnd - 1) == '/')
+    {
+      end = tagEnd + 1;
+    }
+    else
+    {
+      end = xml.indexOf(endTag, tagEnd);
+      if (end == -1)
+      {
         return false;
+      }
+      end += endTag.size();
     }
 
-    QXmlStreamReader reader;
+    ParsedPage parsedPage;
+    parsedPage.offset = pos;
+    // shares the data of xml, which outlives the parsed pages
+    parsedPage.xml = QByteArray::fromRawData(xml.constData() + pos, end - pos);
+    parsedPages.append(parsedPage);
+    pos = end;
+  }
+  return !parsedPages.isEmpty();
+}
 
-    // check if it is a gzipped xoj
-    QByteArray s = file.read(2);
-    if (s.size() == 2)
+bool Document::assemblePages(QVector<ParsedPage> &parsedPages)
+{
+  for (const auto &parsedPage : parsedPages)
+  {
+    if (!parsedPage.ok)
     {
-        if (s.at(0) == static_cast<char>(0x1f) && s.at(1) == static_cast<char>(0x8b))
-        {
-            // this is a gzipped file
-            file.reset();
-            QByteArray compressedData = file.readAll();
-            QByteArray uncompressedData;
-            if (!QCompressor::gzipDecompress(compressedData, uncompressedData))
-            {
-                return false;
-            }
-            reader.addData(uncompressedData);
-        }
-        else
-        {
-            file.reset();
-            reader.setDevice(&file);
-        }
+      return false;
+    }
+  }
+
+  pages.clear();
+  pages.reserve(parsedPages.size());
+  for (auto &parsedPage : parsedPages)
+  {
+    // poppler documents must not be shared between threads, so pdf pages are bound here on the main thread
+    if (!parsedPage.pdfPath.isEmpty())
+    {
+      m_pdfPath = parsedPage.pdfPath;
+      m_pdfDoc = PdfDocument::load(m_pdfPath);
+      if (m_pdfDoc == nullptr)
+      {
+        return false;
+      }
+    }
+    if (parsedPage.pdfPageNum > 0)
+    {
+      if (m_pdfDoc == nullptr)
+      {
+        return false;
+      }
+      if (!parsedPage.page.setPdf(m_pdfDoc, parsedPage.pdfPageNum - 1, false))
+      {
+        return false;
+      }
+    }
+    for (const auto &markdown : parsedPage.markdown)
+    {
+      parsedPage.page.appendMarkdown(markdown.first, markdown.second);
+    }
+    parsedPage.page.clearDirtyRect();
+    pages.append(std::move(parsedPage.page));
+  }
+  return true;
+}
+
+class Document::XmlPageSource : public PageSource
+{
+public:
+  XmlPageSource(xmlFormat fileFormat, const QVector<QByteArray> &compressedPages) : m_format(fileFormat), m_compressedPages(compressedPages)
+  {
+  }
+
+  bool loadPage(int index, Page &page) const override
+  {
+    ParsedPage parsedPage;
+    parsedPage.xml = qUncompress(m_compressedPages.at(index));
+    if (m_format == xmlFormat::MOJ)
+    {
+      parseMOJPage(parsedPage);
     }
     else
+    {
+      parseXOJPage(parsedPage);
+    }
+    if (!parsedPage.ok)
+    {
+      return false;
+    }
+    for (const auto &text : parsedPage.page.texts())
+    {
+      page.appendText(std::get<0>(text), std::get<1>(text), std::get<2>(text), std::get<3>(text));
+    }
+    for (const auto &markdown : parsedPage.markdown)
+    {
+      page.appendMarkdown(markdown.first, markdown.second);
+    }
+    page.appendStrokes(parsedPage.page.strokes());
+    return true;
+  }
+
+private:
+  xmlFormat m_format;
+  QVector<QByteArray> m_compressedPages; /**< the <page> elements, compressed with qCompress */
+};
+
+void Document::setXmlSource(const QVector<ParsedPage> &parsedPages, xmlFormat fileFormat)
+{
+  QVector<QByteArray> compressedPages;
+  compressedPages.reserve(parsedPages.size());
+  for (const auto &parsedPage : parsedPages)
+  {
+    compressedPages.append(parsedPage.compressedXml);
+  }
+  auto source = std::make_shared<XmlPageSource>(fileFormat, compressedPages);
+  for (int i = 0; i < pages.size(); ++i)
+  {
+    pages[i].setSource(source, i);
+  }
+}
+
+void Document::unloadPages(const QSet<int> &visiblePages)
+{
+  int loadedPages = 0;
+  QVector<QPair<int, int>> candidates; // distance to the closest visible page and page number
+  for (int i = 0; i < pages.size(); ++i)
+  {
+    if (!pages[i].isLoaded())
+    {
+      continue;
+    }
+    ++loadedPages;
+    if (pages[i].source() == nullptr || visiblePages.contains(i))
+    {
+      continue;
+    }
+    int distance = std::numeric_limits<int>::max();
+    for (int visiblePage : visiblePages)
+    {
+      distance = qMin(distance, qAbs(visiblePage - i));
+    }
+    candidates.append(qMakePair(distance, i));
+  }
+  if (loadedPages <= maxLoadedPages)
+  {
+    return;
+  }
+
+  std::sort(candidates.begin(), candidates.end(), [](const QPair<int, int> &a, const QPair<int, int> &b) { return a.first > b.first; });
+  for (const auto &candidate : candidates)
+  {
+    if (loadedPages <= maxLoadedPages)
+    {
+      break;
+    }
+    if (pages[candidate.second].unload())
+    {
+      --loadedPages;
+    }
+  }
+}
+
+QVector<int> Document::damagedPages() const
+{
+  struct Check
+  {
+    int pageNum;
+    std::shared_ptr<const PageSource> source;
+    int sourceIndex;
+    bool damaged;
+  };
+  QVector<Check> checks;
+  for (int i = 0; i < pages.size(); ++i)
+  {
+    const Page &page = pages.at(i);
+    if (page.loadFailed())
+    {
+      checks.append({i, nullptr, -1, true});
+    }
+    else if (!page.isLoaded())
+    {
+      checks.append({i, page.source(), page.sourceIndex(), false});
+    }
+  }
+  // sources can be read from several threads, only the pages of the document must not be loaded here
+  QtConcurrent::blockingMap(checks, [](Check &check) {
+    if (check.source != nullptr)
+    {
+      Page page;
+      check.damaged = !check.source->loadPage(check.sourceIndex, page);
+    }
+  });
+
+  QVector<int> pageNums;
+  for (const Check &check : checks)
+  {
+    if (check.damaged)
+    {
+      pageNums.append(check.pageNum);
+    }
+  }
+  return pageNums;
+}
+
+bool Document::loadXOJ(QString fileName)
+{
+    QByteArray xml;
+    if (!readDocumentData(fileName, xml))
     {
         return false;
     }
 
-    pages.clear();
+    QVector<ParsedPage> parsedPages;
+    if (!splitPages(xml, parsedPages))
+    {
+        return false;
+    }
 
-    int strokeCount = 0;
+    // large files are opened as stubs, only size and background of their pages are parsed now
+    bool lazy = parsedPages.size() > lazyPageThreshold;
+    QtConcurrent::blockingMap(parsedPages, [lazy](ParsedPage &parsedPage) {
+        parseXOJPage(parsedPage, lazy);
+        if (lazy)
+        {
+            parsedPage.compressedXml = qCompress(parsedPage.xml, 1);
+        }
+    });
+
+    if (!assemblePages(parsedPages))
+    {
+        return false;
+    }
+    if (lazy)
+    {
+        setXmlSource(parsedPages, xmlFormat::XOJ);
+    }
+
+    setDocumentChanged(true);
+    return true;
+}
+
+void Document::parseXOJPage(ParsedPage &parsedPage, bool headerOnly)
+{
+    QXmlStreamReader reader(parsedPage.xml);
+    Page &newPage = parsedPage.page;
 
     while (!reader.atEnd())
     {
         reader.readNext();
+        if (headerOnly && reader.name() == "layer" && reader.tokenType() == QXmlStreamReader::StartElement)
+        {
+            break;
+        }
         if (reader.name() == "page" && reader.tokenType() == QXmlStreamReader::StartElement)
         {
             QXmlStreamAttributes attributes = reader.attributes();
             QStringRef width = attributes.value("", "width");
             QStringRef height = attributes.value("", "height");
-            Page newPage;
             newPage.setWidth(width.toDouble());
             newPage.setHeight(height.toDouble());
-
-            pages.append(newPage);
         }
         if (reader.name() == "background" && reader.tokenType() == QXmlStreamReader::StartElement)
         {
             QXmlStreamAttributes attributes = reader.attributes();
             QStringRef type = attributes.value("", "type");
             if(type == "pdf"){
-                QStringRef pdfPath = attributes.value("", "filename");
-                if(!pdfPath.isEmpty()){
-                    m_pdfPath = pdfPath.toString();
-                    m_pdfDoc.reset(Poppler::Document::load(m_pdfPath));
-                    m_pdfDoc->setRenderHint(Poppler::Document::Antialiasing);
-                    m_pdfDoc->setRenderHint(Poppler::Document::TextAntialiasing);
-                }
-                QStringRef pdfPageNumStr = attributes.value("", "pageno");
-                int pdfPageNum = pdfPageNumStr.toInt();
-                Poppler::Page* page = m_pdfDoc->page(pdfPageNum-1);
-                pages.last().setPdf(page, pdfPageNum-1, false);
+                parsedPage.pdfPath = attributes.value("", "filename").toString();
+                parsedPage.pdfPageNum = attributes.value("", "pageno").toInt();
 
                 continue;
             }
             QStringRef color = attributes.value("", "color");
             QColor newColor = stringToColor(color.toString());
-            pages.last().setBackgroundColor(newColor);
+            newPage.setBackgroundColor(newColor);
         }
         if (reader.name() == "text" && reader.tokenType() == QXmlStreamReader::StartElement){
             QXmlStreamAttributes attributes = reader.attributes();
@@ -351,7 +829,7 @@ bool Document::loadXOJ(QString fileName)
             QString text = reader.readElementText();
             //QPointF point(xString.toFloat(), yString.toFloat());
             QRectF rect(xString.toDouble(), yString.toDouble(), 0, 0);
-            pages.last().appendText(rect, font, color, text);
+            newPage.appendText(rect, font, color, text);
         }
         if (reader.name() == "stroke" && reader.tokenType() == QXmlStreamReader::StartElement)
         {
@@ -360,73 +838,69 @@ bool Document::loadXOJ(QString fileName)
             if (tool == "pen" || tool == "highlighter")
             {
                 Stroke newStroke;
-                newStroke.pattern = MrDoc::solidLinePattern;
+                newStroke.setPattern(MrDoc::solidLinePattern);
                 QStringRef color = attributes.value("", "color");
                 if(tool == "highlighter"){
-                    newStroke.isHighlighter = true;
+                    newStroke.setHighlighter(true);
                     QColor highlighterColor = stringToColor(color.toString());
                     highlighterColor.setAlpha(127);
-                    newStroke.color = highlighterColor;
+                    newStroke.setColor(highlighterColor);
                 }
                 else{
-                    newStroke.color = stringToColor(color.toString());
+                    newStroke.setColor(stringToColor(color.toString()));
                 }
                 QStringRef strokeWidth = attributes.value("", "width");
-                QStringList strokeWidthList = strokeWidth.toString().split(" ");
-                newStroke.penWidth = strokeWidthList.at(0).toDouble();
-                newStroke.pressures.append(newStroke.penWidth / strokeWidthList.at(0).toDouble());
-                for (int i = 1; i < strokeWidthList.size(); ++i)
+                QVector<qreal> strokeWidthList;
+                strokeWidthList.reserve(NumberParser::countNumbers(strokeWidth));
+                NumberParser::parseNumbers(strokeWidth, strokeWidthList);
+                if (strokeWidthList.isEmpty())
                 {
-                    newStroke.pressures.append(2 * strokeWidthList.at(i).toDouble() / newStroke.penWidth - newStroke.pressures.at(i - 1));
+                    strokeWidthList.append(0.0);
                 }
-                QString elementText = reader.readElementText();
-                QStringList elementTextList = elementText.split(" ");
-                for (int i = 0; i + 1 < elementTextList.size(); i = i + 2)
-                {
-                    newStroke.points.append(QPointF(elementTextList.at(i).toDouble(), elementTextList.at(i + 1).toDouble()));
-                }
-                while (newStroke.points.size() > newStroke.pressures.size())
+                newStroke.setPenWidth(strokeWidthList.at(0));
+                QVector<qreal> pressures;
+                pressures.reserve(strokeWidthList.size());
+                pressures.append(newStroke.penWidth() / strokeWidthList.at(0));
+                for (int i = 1; i < strokeWidthList.size(); ++i)
                 {
-                    newStroke.pressures.append(1.0);
+                    pressures.append(2 * strokeWidthList.at(i) / newStroke.penWidth() - pressures.at(i - 1));
                 }
-                pages.last().appendStroke(newStroke);
-                strokeCount++;
-                qDebug() << strokeCount;
+                QString elementText = reader.readElementText();
+                QPolygonF points;
+                points.reserve(NumberParser::countNumbers(elementText) / 2);
+                NumberParser::parsePoints(elementText, points);
+                // missing pressures are set to 1.0 by setPoints
+                newStroke.setPoints(points, pressures);
+                newPage.appendStroke(newStroke);
             }
         }
     }
 
-    //    QFileInfo fileInfo(file);
-    file.close();
-
-    for (auto &page : pages)
-    {
-        page.clearDirtyRect();
-    }
-
-    if (reader.hasError())
-    {
-        return false;
-    }
-    else
-    {
-        setDocumentChanged(true);
-        return true;
-    }
+    newPage.clearDirtyRect();
+    parsedPage.ok = !reader.hasError();
 }
 
 bool Document::saveXOJ(QString fileName)
 {
-  QFile file(fileName);
+  // the file is replaced when it is complete, a failed save leaves the previous version intact
+  QSaveFile file(fileName);
   if (!file.open(QIODevice::WriteOnly))
   {
     return false;
   }
 
-  QByteArray uncompressedData;
+  // the xml is compressed while it is written, so the uncompressed document is never completely in memory
+  GzipDevice gzipDevice(&file);
+  if (!gzipDevice.open(QIODevice::WriteOnly))
+  {
+    file.cancelWriting();
+    return false;
+  }
 
-  QXmlStreamWriter writer(&uncompressedData);
+  QXmlStreamWriter writer(&gzipDevice);
   //  QXmlStreamWriter writer;
+  NumberWriter numbers;
+  ColorNames colorNames;
 
   writer.setAutoFormatting(true);
 
@@ -444,6 +918,15 @@ bool Document::saveXOJ(QString fileName)
 
   for (int i = 0; i < pages.size(); ++i)
   {
+    // stubs are loaded for writing and given back afterwards, so saving a large document does not load all of it
+    bool wasLoaded = pages[i].isLoaded();
+    // the content of a page which failed to load is unknown, writing the page empty would lose it
+    pages[i].strokes();
+    if (pages[i].loadFailed())
+    {
+      file.cancelWriting();
+      return false;
+    }
     writer.writeStartElement("page");
     writer.writeAttribute(QXmlStreamAttribute("width", QString::number(pages[i].width())));
     writer.writeAttribute(QXmlStreamAttribute("height", QString::number(pages[i].height())));
@@ -468,7 +951,7 @@ bool Document::saveXOJ(QString fileName)
 
     for (auto t : pages[i].texts()){
         writer.writeStartElement("text");
-        writer.writeAttribute(QXmlStreamAttribute("font", std::get<1>(t).key()));
+        writer.writeAttribute(QXmlStreamAttribute("font", std::get<1>(t).family()));
         writer.writeAttribute(QXmlStreamAttribute("size", QString::number(std::get<1>(t).pointSize())));
         writer.writeAttribute(QXmlStreamAttribute("x", QString::number(std::get<0>(t).x())));
         writer.writeAttribute(QXmlStreamAttribute("y", QString::number(std::get<0>(t).y())));
@@ -477,150 +960,151 @@ bool Document::saveXOJ(QString fileName)
         writer.writeEndElement();
     }
     //    for (int j = 0; j < pages[i].m_strokes.size(); ++j)
-    for (auto strokes : pages[i].strokes())
+    for (const auto &strokes : pages[i].strokes())
     {
       writer.writeStartElement("stroke");
-      if(strokes.isHighlighter){
+      if(strokes.isHighlighter()){
           writer.writeAttribute(QXmlStreamAttribute("tool", "highlighter"));
-          QColor highlighterColor = strokes.color;
-          highlighterColor.setAlpha(127);
-          writer.writeAttribute(QXmlStreamAttribute("color", toRGBA(highlighterColor.name(QColor::HexArgb))));
+          QRgb highlighterColor = strokes.rgba();
+          writer.writeAttribute(QXmlStreamAttribute("color", colorNames.name(qRgba(qRed(highlighterColor), qGreen(highlighterColor), qBlue(highlighterColor), 127))));
       }
       else{
           writer.writeAttribute(QXmlStreamAttribute("tool", "pen"));
-          writer.writeAttribute(QXmlStreamAttribute("color", toRGBA(strokes.color.name(QColor::HexArgb))));
+          writer.writeAttribute(QXmlStreamAttribute("color", colorNames.name(strokes.rgba())));
       }
-      qreal width = strokes.penWidth;
-      QString widthString;
-      widthString.append(QString::number(width));
-      for (int k = 0; k < strokes.pressures.size() - 1; ++k)
+      qreal width = strokes.penWidth();
+      numbers.clear();
+      numbers.append(width);
+      for (int k = 0; k < strokes.size() - 1; ++k)
       {
-        qreal p0 = strokes.pressures[k];
-        qreal p1 = strokes.pressures[k + 1];
-        widthString.append(' ');
-        widthString.append(QString::number(0.5 * (p0 + p1) * width));
+        qreal p0 = strokes.pressure(k);
+        qreal p1 = strokes.pressure(k + 1);
+        // float precision is plenty for a width and keeps the numbers short
+        numbers.append(static_cast<float>(0.5 * (p0 + p1) * width));
       }
-      writer.writeAttribute(QXmlStreamAttribute("width", widthString));
-      for (int k = 0; k < strokes.points.size(); ++k)
+      writer.writeAttribute(QXmlStreamAttribute("width", numbers.toString()));
+      numbers.clear();
+      for (int k = 0; k < strokes.size(); ++k)
       {
-        writer.writeCharacters(QString::number(strokes.points[k].x()));
-        writer.writeCharacters(" ");
-        writer.writeCharacters(QString::number(strokes.points[k].y()));
-        writer.writeCharacters(" ");
+        QPointF point = strokes.point(k);
+        numbers.append(static_cast<float>(point.x()));
+        numbers.append(static_cast<float>(point.y()));
       }
+      writer.writeCharacters(numbers.toString());
       writer.writeEndElement(); // closing "stroke"
     }
 
     writer.writeEndElement(); // closing "layer"
     writer.writeEndElement(); // closing "page"
+    if (!wasLoaded)
+    {
+      pages[i].unload();
+    }
   }
 
   writer.writeEndDocument();
 
-  QByteArray compressedData;
-
-  QCompressor::gzipCompress(uncompressedData, compressedData);
+  gzipDevice.close();
+  bool compressionError = gzipDevice.hasError();
 
-  file.write(compressedData);
-
-  //  QFileInfo fileInfo(file);
-
-  file.close();
-
-  if (writer.hasError())
+  if (writer.hasError() || compressionError)
   {
+    file.cancelWriting();
     return false;
   }
-  else
-  {
-    return true;
-  }
+  return file.commit();
 }
 
 bool Document::loadMOJ(QString fileName)
 {
-  QFile file(fileName);
-  if (!file.open(QIODevice::ReadOnly))
+  QByteArray xml;
+  if (!readDocumentData(fileName, xml))
   {
     return false;
   }
 
-  QXmlStreamReader reader;
+  QVector<ParsedPage> parsedPages;
+  if (!splitPages(xml, parsedPages))
+  {
+    return false;
+  }
 
-  // check if it is a gzipped moj
-  QByteArray s = file.read(2);
-  if (s.size() == 2)
+  // the header in front of the first page only contains the document version
+  QXmlStreamReader headerReader(xml.left(parsedPages.first().offset));
+  while (!headerReader.atEnd())
   {
-    if (s.at(0) == static_cast<char>(0x1f) && s.at(1) == static_cast<char>(0x8b))
+    headerReader.readNext();
+    if (headerReader.name() == "MrWriter" && headerReader.tokenType() == QXmlStreamReader::StartElement)
     {
-      // this is a gzipped file
-      file.reset();
-      QByteArray compressedData = file.readAll();
-      QByteArray uncompressedData;
-      if (!QCompressor::gzipDecompress(compressedData, uncompressedData))
+      QXmlStreamAttributes attributes = headerReader.attributes();
+      QStringRef docversion = attributes.value("document-version");
+      if (docversion.toInt() > DOC_VERSION)
       {
-        return false;
+        // TODO warn about newer document version
       }
-      reader.addData(uncompressedData);
+      break;
     }
-    else
+  }
+
+  // large files are opened as stubs, only size and background of their pages are parsed now
+  bool lazy = parsedPages.size() > lazyPageThreshold;
+  QtConcurrent::blockingMap(parsedPages, [lazy](ParsedPage &parsedPage) {
+    parseMOJPage(parsedPage, lazy);
+    if (lazy)
     {
-      file.reset();
-      reader.setDevice(&file);
+      parsedPage.compressedXml = qCompress(parsedPage.xml, 1);
     }
-  }
-  else
+  });
+
+  if (!assemblePages(parsedPages))
   {
     return false;
   }
+  if (lazy)
+  {
+    setXmlSource(parsedPages, xmlFormat::MOJ);
+  }
 
-  pages.clear();
+  QFileInfo fileInfo(fileName);
+  m_path = fileInfo.absolutePath();
+  m_docName = fileInfo.completeBaseName();
+  m_fileSuffix = "moj";
+  return true;
+}
+
+void Document::parseMOJPage(ParsedPage &parsedPage, bool headerOnly)
+{
+  QXmlStreamReader reader(parsedPage.xml);
+  Page &newPage = parsedPage.page;
 
   while (!reader.atEnd())
   {
     reader.readNext();
-    if (reader.name() == "MrWriter" && reader.tokenType() == QXmlStreamReader::StartElement)
+    if (headerOnly && reader.name() == "layer" && reader.tokenType() == QXmlStreamReader::StartElement)
     {
-      QXmlStreamAttributes attributes = reader.attributes();
-      QStringRef docversion = attributes.value("document-version");
-      if (docversion.toInt() > DOC_VERSION)
-      {
-        // TODO warn about newer document version
-      }
+      break;
     }
     if (reader.name() == "page" && reader.tokenType() == QXmlStreamReader::StartElement)
     {
       QXmlStreamAttributes attributes = reader.attributes();
       QStringRef width = attributes.value("", "width");
       QStringRef height = attributes.value("", "height");
-      Page newPage;
       newPage.setWidth(width.toDouble());
       newPage.setHeight(height.toDouble());
-
-      pages.append(newPage);
     }
     if (reader.name() == "background" && reader.tokenType() == QXmlStreamReader::StartElement)
     {
       QXmlStreamAttributes attributes = reader.attributes();
       QStringRef type = attributes.value("", "type");
       if(type == "pdf"){
-          QStringRef pdfPath = attributes.value("", "filename");
-          if(!pdfPath.isEmpty()){
-              m_pdfPath = pdfPath.toString();
-              m_pdfDoc.reset(Poppler::Document::load(m_pdfPath));
-              m_pdfDoc->setRenderHint(Poppler::Document::Antialiasing);
-              m_pdfDoc->setRenderHint(Poppler::Document::TextAntialiasing);
-          }
-          QStringRef pdfPageNumStr = attributes.value("", "pageno");
-          int pdfPageNum = pdfPageNumStr.toInt();
-          Poppler::Page* page = m_pdfDoc->page(pdfPageNum-1);
-          pages.last().setPdf(page, pdfPageNum-1, false);
+          parsedPage.pdfPath = attributes.value("", "filename").toString();
+          parsedPage.pdfPageNum = attributes.value("", "pageno").toInt();
 
           continue;
       }
       QStringRef color = attributes.value("", "color");
       QColor newColor = stringToColor(color.toString());
-      pages.last().setBackgroundColor(newColor);
+      newPage.setBackgroundColor(newColor);
 
       QStringRef backgroundTypeString = attributes.value("", "backgroundType");
       MrDoc::Page::backgroundType backgroundType = MrDoc::Page::backgroundType::PLAIN;
@@ -633,7 +1117,7 @@ bool Document::loadMOJ(QString fileName)
       else if(backgroundTypeString.toString() == QString("ruled")){
           backgroundType = MrDoc::Page::backgroundType::RULED;
       }
-      pages.last().setBackgroundType(backgroundType);
+      newPage.setBackgroundType(backgroundType);
     }
     if (reader.name() == "text" && reader.tokenType() == QXmlStreamReader::StartElement){
         QXmlStreamAttributes attributes = reader.attributes();
@@ -648,7 +1132,7 @@ bool Document::loadMOJ(QString fileName)
         QString text = reader.readElementText();
         //QPointF point(xString.toFloat(), yString.toFloat());
         QRectF rect(xString.toDouble(), yString.toDouble(), 0, 0);
-        pages.last().appendText(rect, font, color, text);
+        newPage.appendText(rect, font, color, text);
     }
     if (reader.name() == "markdown" && reader.tokenType() == QXmlStreamReader::StartElement){
         QXmlStreamAttributes attributes = reader.attributes();
@@ -661,7 +1145,8 @@ bool Document::loadMOJ(QString fileName)
         qreal width = static_cast<qreal>(widthString.toDouble());
         qreal height = static_cast<qreal>(heightString.toDouble());
         QString text = reader.readElementText();
-        pages.last().appendMarkdown(QRectF(x, y, width, height), text);
+        // markdown is compiled by libmarkdown, which is not thread safe, so it is appended by assemblePages
+        parsedPage.markdown.append(qMakePair(QRectF(x, y, width, height), text));
     }
     if (reader.name() == "stroke" && reader.tokenType() == QXmlStreamReader::StartElement)
     {
@@ -671,93 +1156,76 @@ bool Document::loadMOJ(QString fileName)
       {
         Stroke newStroke;
         if(tool == "highlighter"){
-            newStroke.isHighlighter = true;
+            newStroke.setHighlighter(true);
         }
-        newStroke.pattern = MrDoc::solidLinePattern;
+        newStroke.setPattern(MrDoc::solidLinePattern);
         QStringRef color = attributes.value("", "color");
-        newStroke.color = stringToColor(color.toString());
+        newStroke.setColor(stringToColor(color.toString()));
         QStringRef style = attributes.value("", "style");
         if (style.toString().compare("solid") == 0)
         {
-          newStroke.pattern = MrDoc::solidLinePattern;
+          newStroke.setPattern(MrDoc::solidLinePattern);
         }
         else if (style.toString().compare("dash") == 0)
         {
-          newStroke.pattern = MrDoc::dashLinePattern;
+          newStroke.setPattern(MrDoc::dashLinePattern);
         }
         else if (style.toString().compare("dashdot") == 0)
         {
-          newStroke.pattern = MrDoc::dashDotLinePattern;
+          newStroke.setPattern(MrDoc::dashDotLinePattern);
         }
         else if (style.toString().compare("dot") == 0)
         {
-          newStroke.pattern = MrDoc::dotLinePattern;
+          newStroke.setPattern(MrDoc::dotLinePattern);
         }
         else
         {
-          newStroke.pattern = MrDoc::solidLinePattern;
+          newStroke.setPattern(MrDoc::solidLinePattern);
         }
         QStringRef strokeWidth = attributes.value("", "width");
-        newStroke.penWidth = strokeWidth.toDouble();
-        QString elementText = reader.readElementText();
-        QStringList elementTextList = elementText.trimmed().split(" ");
-        for (int i = 0; i + 1 < elementTextList.size(); i = i + 2)
-        {
-          newStroke.points.append(QPointF(elementTextList.at(i).toDouble(), elementTextList.at(i + 1).toDouble()));
-        }
-        QStringRef pressures = attributes.value("pressures");
-        QStringList pressuresList = pressures.toString().trimmed().split(" ");
-        for (int i = 0; i < pressuresList.length(); ++i)
+        newStroke.setPenWidth(strokeWidth.toDouble());
+        // there is one pressure per point, so the pressures tell how many points to expect
+        QStringRef pressuresString = attributes.value("pressures");
+        QVector<qreal> pressures;
+        pressures.reserve(NumberParser::countNumbers(pressuresString));
+        NumberParser::parseNumbers(pressuresString, pressures);
+        QPolygonF points;
+        points.reserve(pressures.size());
+        NumberParser::parsePoints(reader.readElementText(), points);
+        if (pressures.size() != points.size())
         {
-          if (pressuresList.length() == 0)
-          {
-            newStroke.pressures.append(1.0);
-          }
-          else
-          {
-            newStroke.pressures.append(pressuresList.at(i).toDouble());
-          }
+          parsedPage.ok = false;
+          return;
         }
-        if (newStroke.pressures.size() != newStroke.points.size())
-        {
-          return false;
-        }
-        pages.last().appendStroke(newStroke);
+        newStroke.setPoints(points, pressures);
+        newPage.appendStroke(newStroke);
       }
     }
   }
 
-  QFileInfo fileInfo(file);
-  file.close();
-
-  for (auto &page : pages)
-  {
-    page.clearDirtyRect();
-  }
-
-  if (reader.hasError())
-  {
-    return false;
-  }
-  else
-  {
-    m_path = fileInfo.absolutePath();
-    m_docName = fileInfo.completeBaseName();
-    return true;
-  }
+  newPage.clearDirtyRect();
+  parsedPage.ok = !reader.hasError();
 }
 
 bool Document::saveMOJ(QString fileName)
 {
-  QFile file(fileName);
+  // the file is replaced when it is complete, a failed save leaves the previous version intact
+  QSaveFile file(fileName);
   if (!file.open(QIODevice::WriteOnly))
   {
     return false;
   }
 
-  QByteArray uncompressedData;
+  // the xml is compressed while it is written, so the uncompressed document is never completely in memory
+  GzipDevice gzipDevice(&file);
+  if (!gzipDevice.open(QIODevice::WriteOnly))
+  {
+    return false;
+  }
 
-  QXmlStreamWriter writer(&uncompressedData);
+  QXmlStreamWriter writer(&gzipDevice);
+  NumberWriter numbers;
+  ColorNames colorNames;
 
   writer.setAutoFormatting(true);
 
@@ -779,6 +1247,15 @@ bool Document::saveMOJ(QString fileName)
 
   for (int i = 0; i < pages.size(); ++i)
   {
+    // stubs are loaded for writing and given back afterwards, so saving a large document does not load all of it
+    bool wasLoaded = pages[i].isLoaded();
+    // the content of a page which failed to load is unknown, writing the page empty would lose it
+    pages[i].strokes();
+    if (pages[i].loadFailed())
+    {
+      file.cancelWriting();
+      return false;
+    }
     writer.writeStartElement("page");
     writer.writeAttribute(QXmlStreamAttribute("width", QString::number(pages[i].width())));
     writer.writeAttribute(QXmlStreamAttribute("height", QString::number(pages[i].height())));
@@ -815,7 +1292,7 @@ bool Document::saveMOJ(QString fileName)
 
     for (auto t : pages[i].texts()){
         writer.writeStartElement("text");
-        writer.writeAttribute(QXmlStreamAttribute("font", std::get<1>(t).key()));
+        writer.writeAttribute(QXmlStreamAttribute("font", std::get<1>(t).family()));
         writer.writeAttribute(QXmlStreamAttribute("size", QString::number(std::get<1>(t).pointSize())));
         writer.writeAttribute(QXmlStreamAttribute("x", QString::number(std::get<0>(t).x())));
         writer.writeAttribute(QXmlStreamAttribute("y", QString::number(std::get<0>(t).y())));
@@ -834,28 +1311,28 @@ bool Document::saveMOJ(QString fileName)
     }
 
     //    for (int j = 0; j < pages[i].m_strokes.size(); ++j)
-    for (auto strokes : pages[i].strokes())
+    for (const auto &strokes : pages[i].strokes())
     {
       writer.writeStartElement("stroke");
-      if(strokes.isHighlighter)
+      if(strokes.isHighlighter())
           writer.writeAttribute(QXmlStreamAttribute("tool", "highlighter"));
       else
         writer.writeAttribute(QXmlStreamAttribute("tool", "pen"));
-      writer.writeAttribute(QXmlStreamAttribute("color", toRGBA(strokes.color.name(QColor::HexArgb))));
+      writer.writeAttribute(QXmlStreamAttribute("color", colorNames.name(strokes.rgba())));
       QString patternString;
-      if (strokes.pattern == MrDoc::solidLinePattern)
+      if (strokes.pattern() == MrDoc::solidLinePattern)
       {
         patternString = "solid";
       }
-      else if (strokes.pattern == MrDoc::dashLinePattern)
+      else if (strokes.pattern() == MrDoc::dashLinePattern)
       {
         patternString = "dash";
       }
-      else if (strokes.pattern == MrDoc::dashDotLinePattern)
+      else if (strokes.pattern() == MrDoc::dashDotLinePattern)
       {
         patternString = "dashdot";
       }
-      else if (strokes.pattern == MrDoc::dotLinePattern)
+      else if (strokes.pattern() == MrDoc::dotLinePattern)
       {
         patternString = "dot";
       }
@@ -864,41 +1341,47 @@ bool Document::saveMOJ(QString fileName)
         patternString = "solid";
       }
       writer.writeAttribute(QXmlStreamAttribute("style", patternString));
-      qreal width = strokes.penWidth;
+      qreal width = strokes.penWidth();
       writer.writeAttribute(QXmlStreamAttribute("width", QString::number(width)));
-      QString pressures;
-      for (int k = 0; k < strokes.pressures.length(); ++k)
+      numbers.clear();
+      for (int k = 0; k < strokes.size(); ++k)
       {
-        pressures.append(QString::number(strokes.pressures[k])).append(" ");
+        numbers.append(strokes.pressure(k));
       }
-      writer.writeAttribute((QXmlStreamAttribute("pressures", pressures.trimmed())));
-      QString points;
-      for (int k = 0; k < strokes.points.size(); ++k)
+      writer.writeAttribute(QXmlStreamAttribute("pressures", numbers.toString()));
+      numbers.clear();
+      for (int k = 0; k < strokes.size(); ++k)
       {
-        points.append(QString::number(strokes.points[k].x()));
-        points.append(" ");
-        points.append(QString::number(strokes.points[k].y()));
-        points.append(" ");
+        // points are stored as floats, so they are written as floats
+        QPointF point = strokes.point(k);
+        numbers.append(static_cast<float>(point.x()));
+        numbers.append(static_cast<float>(point.y()));
       }
-      writer.writeCharacters(points.trimmed());
+      writer.writeCharacters(numbers.toString());
       writer.writeEndElement(); // closing "stroke"
     }
 
     writer.writeEndElement(); // closing "layer"
     writer.writeEndElement(); // closing "page"
+    if (!wasLoaded)
+    {
+      pages[i].unload();
+    }
   }
 
   writer.writeEndDocument();
 
-  QByteArray compressedData;
-  QCompressor::gzipCompress(uncompressedData, compressedData);
-  file.write(compressedData);
+  gzipDevice.close();
+  bool compressionError = gzipDevice.hasError();
 
-  QFileInfo fileInfo(file);
+  QFileInfo fileInfo(fileName);
 
-  file.close();
-
-  if (writer.hasError())
+  if (writer.hasError() || compressionError)
+  {
+    file.cancelWriting();
+    return false;
+  }
+  if (!file.commit())
   {
     return false;
   }
@@ -908,31 +1391,193 @@ bool Document::saveMOJ(QString fileName)
 
     m_path = fileInfo.absolutePath();
     m_docName = fileInfo.completeBaseName();
+    m_fileSuffix = "moj";
     return true;
   }
 }
 
+bool Document::loadMOJB(QString fileName)
+{
+  auto binaryDocument = std::make_shared<BinaryDocument>();
+  if (!binaryDocument->open(fileName) || binaryDocument->pageCount() == 0)
+  {
+    return false;
+  }
+
+  std::shared_ptr<PdfDocument> pdfDoc;
+  if (!binaryDocument->pdfPath().isEmpty())
+  {
+    pdfDoc = PdfDocument::load(binaryDocument->pdfPath());
+    if (pdfDoc == nullptr)
+    {
+      return false;
+    }
+  }
+
+  QVector<Page> newPages(binaryDocument->pageCount());
+  for (int i = 0; i < newPages.size(); ++i)
+  {
+    const BinaryDocument::PageInfo &info = binaryDocument->pageInfo(i);
+    Page &newPage = newPages[i];
+    newPage.setWidth(info.width);
+    newPage.setHeight(info.height);
+    newPage.setBackgroundColor(QColor::fromRgba(info.backgroundColor));
+    newPage.setBackgroundType(info.backgroundType);
+    if (info.pdfPageNum > 0)
+    {
+      if (pdfDoc == nullptr)
+      {
+        return false;
+      }
+      if (!newPage.setPdf(pdfDoc, info.pdfPageNum - 1, false))
+      {
+        return false;
+      }
+    }
+    newPage.setSource(binaryDocument, i);
+  }
+
+  pages = newPages;
+  m_pdfPath = binaryDocument->pdfPath();
+  m_pdfDoc = pdfDoc;
+
+  QFileInfo fileInfo(fileName);
+  m_path = fileInfo.absolutePath();
+  m_docName = fileInfo.completeBaseName();
+  m_fileSuffix = "mojb";
+  return true;
+}
+
+bool Document::saveMOJB(QString fileName)
+{
+  if (!BinaryDocument::write(fileName, pages, m_pdfPath))
+  {
+    return false;
+  }
+
+  setDocumentChanged(false);
+
+  QFileInfo fileInfo(fileName);
+  m_path = fileInfo.absolutePath();
+  m_docName = fileInfo.completeBaseName();
+  m_fileSuffix = "mojb";
+  return true;
+}
+
+bool Document::loadMOJT(QString fileName)
+{
+  QVector<LineDocument::ParsedPage> linePages;
+  QString pdfPath;
+  if (!LineDocument::read(fileName, linePages, pdfPath))
+  {
+    return false;
+  }
+
+  // the pdf is loaded by assemblePages when the first page which is drawn on it is bound
+  QVector<ParsedPage> parsedPages(linePages.size());
+  bool pdfPathSet = false;
+  for (int i = 0; i < linePages.size(); ++i)
+  {
+    ParsedPage &parsedPage = parsedPages[i];
+    parsedPage.page = std::move(linePages[i].page);
+    parsedPage.pdfPageNum = linePages[i].pdfPageNum;
+    parsedPage.markdown = std::move(linePages[i].markdown);
+    if (parsedPage.pdfPageNum > 0 && !pdfPathSet)
+    {
+      parsedPage.pdfPath = pdfPath;
+      pdfPathSet = true;
+    }
+    parsedPage.ok = true;
+  }
+
+  if (!assemblePages(parsedPages))
+  {
+    return false;
+  }
+
+  QFileInfo fileInfo(fileName);
+  m_path = fileInfo.absolutePath();
+  m_docName = fileInfo.completeBaseName();
+  m_fileSuffix = "mojt";
+  return true;
+}
+
+bool Document::saveMOJT(QString fileName)
+{
+  if (!LineDocument::write(fileName, pages, m_pdfPath))
+  {
+    return false;
+  }
+
+  setDocumentChanged(false);
+
+  QFileInfo fileInfo(fileName);
+  m_path = fileInfo.absolutePath();
+  m_docName = fileInfo.completeBaseName();
+  m_fileSuffix = "mojt";
+  return true;
+}
+
 bool Document::loadPDF(QString fileName){
     pages.clear();
     if(!fileName.isEmpty()){
         m_pdfPath = fileName;
-        m_pdfDoc.reset(Poppler::Document::load(m_pdfPath));
-        if(m_pdfDoc->isLocked()){
+        m_pdfDoc = PdfDocument::load(m_pdfPath);
+        if(m_pdfDoc == nullptr){
             return false;
         }
-        m_pdfDoc->setRenderHint(Poppler::Document::Antialiasing);
-        m_pdfDoc->setRenderHint(Poppler::Document::TextAntialiasing);
-        int numPages = m_pdfDoc->numPages();
+        int numPages = m_pdfDoc->document->numPages();
         for(int i = 0; i < numPages; ++i){
-            Poppler::Page* page = m_pdfDoc->page(i);
             pages.append(Page());
-            pages.last().setPdf(page, i, true);
+            pages.last().setPdf(m_pdfDoc, i, true);
         }
         return true;
     }
     return false;
 }
 
+bool Document::loadBySuffix(const QString &fileName)
+{
+  QString suffix = QFileInfo(fileName).suffix();
+  if (suffix.compare(QString("xoj"), Qt::CaseInsensitive) == 0)
+  {
+    return loadXOJ(fileName);
+  }
+  else if (suffix.compare(QString("mojb"), Qt::CaseInsensitive) == 0)
+  {
+    return loadMOJB(fileName);
+  }
+  else if (suffix.compare(QString("mojt"), Qt::CaseInsensitive) == 0)
+  {
+    return loadMOJT(fileName);
+  }
+  else if (suffix.compare(QString("pdf"), Qt::CaseInsensitive) == 0)
+  {
+    return loadPDF(fileName);
+  }
+  else
+  {
+    return loadMOJ(fileName);
+  }
+}
+
+bool Document::saveBySuffix(const QString &fileName)
+{
+  QString suffix = QFileInfo(fileName).suffix();
+  if (suffix.compare(QString("mojb"), Qt::CaseInsensitive) == 0)
+  {
+    return saveMOJB(fileName);
+  }
+  else if (suffix.compare(QString("mojt"), Qt::CaseInsensitive) == 0)
+  {
+    return saveMOJT(fileName);
+  }
+  else
+  {
+    return saveMOJ(fileName);
+  }
+}
+
 bool Document::setDocName(QString docName)
 {
   // check for special characters not to be used in filenames ... (probably
@@ -957,6 +1602,49 @@ QString Document::path()
   return m_path;
 }
 
+QString Document::fileSuffix()
+{
+  return m_fileSuffix;
+}
+
+QString Document::fileName()
+{
+  if (m_docName.isEmpty())
+  {
+    return QString();
+  }
+  return m_path + '/' + m_docName + '.' + m_fileSuffix;
+}
+
+void Document::setFileName(const QString &fileName)
+{
+  if (fileName.isEmpty())
+  {
+    m_path.clear();
+    m_docName.clear();
+    m_fileSuffix = "moj";
+    return;
+  }
+  QFileInfo fileInfo(fileName);
+  m_path = fileInfo.absolutePath();
+  m_docName = fileInfo.completeBaseName();
+  m_fileSuffix = fileInfo.suffix();
+}
+
+QString Document::pdfPath()
+{
+  return m_pdfPath;
+}
+
+bool Document::setPdfBackground(int pageIndex, int pdfPageNum)
+{
+  if (m_pdfDoc == nullptr || pdfPageNum < 0 || pdfPageNum >= m_pdfDoc->document->numPages() || pageIndex < 0 || pageIndex >= pages.size())
+  {
+    return false;
+  }
+  return pages[pageIndex].setPdf(m_pdfDoc, pdfPageNum, false);
+}
+
 bool Document::documentChanged()
 {
   return m_documentChanged;
@@ -1,16 +1,19 @@
 #ifndef DOCUMENT_H
 #define DOCUMENT_H
 
-#include <QMessageBox>
-#include <QPushButton>
 #include <QObject>
 #include <QDir>
 #include <QProcess>
 #include "page.h"
 #include <poppler-qt5.h>
 #include <memory>
+#include <functional>
 
+#include <QImage>
 #include <QVector>
+#include <QPair>
+#include <QByteArray>
+#include <QSet>
 
 namespace MrDoc
 {
@@ -24,16 +27,29 @@ public:
   Document& operator= (const Document& doc);*/
 
   /**
-   * @brief exportPDF exports the document as pdf using pdftk
+   * @brief exportPDF exports the document as pdf. If every page is drawn on the page of the pdf with the same number, the strokes and
+   * texts are added to a copy of the pdf as annotations (see exportPDFWithAnnotations). Otherwise the pages are combined with pdftk.
+   * Documents without pdf are exported with exportPDFAsImage.
    * @param fileName is the full path
+   * @return false if the export failed, e.g. because pdftk is not installed
    */
-  void exportPDF(QString fileName);
+  bool exportPDF(QString fileName);
   /**
    * @brief exportPDFAsImage exports the document as pdf but only as images
-   * @details It is not possible to search in the document.
+   * @details It is not possible to search in the document. The pages are rasterized by a thread pool while the calling thread writes them,
+   * so it can be called from a worker thread on a copy of the document. The file is replaced atomically.
    * @param fileName is the full path
+   * @param progress is called by the writing thread with the number of pages written so far. If it returns false, the export is cancelled.
+   * @return false if the export failed or was cancelled
    */
-  void exportPDFAsImage(QString fileName);
+  bool exportPDFAsImage(const QString &fileName, const std::function<bool(int)> &progress = std::function<bool(int)>());
+
+  /**
+   * @brief rasterizePage paints @param page into an image, filled with the background color of the page. The page is a copy, so several pages
+   * can be rasterized in parallel.
+   * @param zoom is the number of pixels per point
+   */
+  static QImage rasterizePage(Page page, qreal zoom);
 
   /**
    * @brief loadXOJ loads a .xoj (xournal file)
@@ -61,6 +77,33 @@ public:
    */
   bool saveMOJ(QString fileName);
 
+  /**
+   * @brief loadMOJB opens a .mojb (binary MrWriter file). Only the page directory is read, the content of a page is decoded when it is
+   * needed for the first time.
+   * @param fileName is the full path
+   * @return true if opening was successful, otherwise false
+   */
+  bool loadMOJB(QString fileName);
+  /**
+   * @brief saveMOJB saves the document as .mojb. Pages which were not loaded since the document was opened are copied without decoding them.
+   * @param fileName is the full path
+   * @return true if saving was successful, otherwise false
+   */
+  bool saveMOJB(QString fileName);
+
+  /**
+   * @brief loadMOJT loads a .mojt (line based MrWriter text file), see LineDocument
+   * @param fileName is the full path
+   * @return true if opening was successful, otherwise false
+   */
+  bool loadMOJT(QString fileName);
+  /**
+   * @brief saveMOJT saves the document as .mojt, which keeps the diffs small if the document is under version control
+   * @param fileName is the full path
+   * @return true if saving was successful, otherwise false
+   */
+  bool saveMOJT(QString fileName);
+
   /**
    * @brief loadPDF loads a .pdf file to annotate it
    * @param fileName is the full path
@@ -68,6 +111,19 @@ public:
    */
   bool loadPDF(QString fileName);
 
+  /**
+   * @brief loadBySuffix loads a .xoj, .mojb, .mojt or .pdf file depending on the suffix of @param fileName, any other file as .moj
+   * @param fileName is the full path
+   * @return true if opening was successful, otherwise false
+   */
+  bool loadBySuffix(const QString &fileName);
+  /**
+   * @brief saveBySuffix saves the document as .mojb or .mojt depending on the suffix of @param fileName, otherwise as .moj
+   * @param fileName is the full path
+   * @return true if saving was successful, otherwise false
+   */
+  bool saveBySuffix(const QString &fileName);
+
   void paintPage(int pageNum, QPainter &painter, qreal zoom);
 
   bool setDocName(QString docName);
@@ -76,15 +132,57 @@ public:
   bool setPath(QString path);
   QString path();
 
+  /**
+   * @brief fileSuffix
+   * @return the suffix of the MrWriter format the document was opened from or saved to last ("moj", "mojb" or "mojt")
+   */
+  QString fileSuffix();
+  /**
+   * @brief fileName
+   * @return the full path of the MrWriter file the document was opened from or saved to last, empty if there is none
+   */
+  QString fileName();
+  /**
+   * @brief setFileName sets path, name and suffix of the document as if it was opened from @param fileName. An empty name makes the
+   * document untitled.
+   */
+  void setFileName(const QString &fileName);
+  /**
+   * @brief pdfPath
+   * @return the path of the pdf the pages are drawn on, empty if there is none
+   */
+  QString pdfPath();
+  /**
+   * @brief setPdfBackground draws page @param pageIndex on page @param pdfPageNum (first page is 0) of the pdf of the document
+   * @return false if the document has no pdf or it has no such page
+   */
+  bool setPdfBackground(int pageIndex, int pdfPageNum);
+
   bool documentChanged();
   void setDocumentChanged(bool changed);
 
   QVector<MrDoc::Page> pages;
 
-  QString toRGBA(QString argb);
-  QString toARGB(QString rgba);
+  static QString toRGBA(QString argb);
+  static QString toARGB(QString rgba);
+
+  static QColor stringToColor(QString colorString);
+
+  /**
+   * @brief unloadPages discards the content of unchanged pages far away from @param visiblePages, so that at most @ref maxLoadedPages pages
+   * of a document opened from a file keep their content in memory. It is loaded from the file again when it is needed.
+   * @param visiblePages are never unloaded
+   */
+  void unloadPages(const QSet<int> &visiblePages);
+  /**
+   * @brief damagedPages loads the content of all stubs into temporary pages, in parallel, to find the pages which can't be loaded. The pages
+   * themselves are not changed, so this can run on a snapshot of the document on a worker thread.
+   * @return the indices of the pages which failed or would fail to load, see Page::loadFailed
+   */
+  QVector<int> damagedPages() const;
 
-  QColor stringToColor(QString colorString);
+  static constexpr int maxLoadedPages = 64;
+  static constexpr int lazyPageThreshold = 100; /**< .moj and .xoj files with more pages are opened as stubs, see Page::setSource */
 
 private:
   /**
@@ -94,13 +192,87 @@ private:
       PDF,
       NOPDF
   };
+
+  /**
+   * @brief The ParsedPage struct is one <page> element of a .moj or .xoj file, which is parsed by a worker thread independently of the
+   * other pages
+   */
+  struct ParsedPage
+  {
+    int offset = 0; /**< position of the element in the file */
+    QByteArray xml; /**< the element, shares the data of the whole file */
+    Page page;
+    QString pdfPath; /**< filename of the pdf background, empty if the pdf of the previous page is continued */
+    int pdfPageNum = 0; /**< page in the pdf (first page is 1), 0 if there is no pdf background */
+    QVector<QPair<QRectF, QString>> markdown; /**< markdown is appended on the main thread */
+    QByteArray compressedXml; /**< the element compressed with qCompress, kept for pages which are opened as stubs */
+    bool ok = false;
+  };
+
+  /**
+   * @brief readDocumentData reads a (possibly gzipped) .moj or .xoj file
+   * @param fileName is the full path
+   * @param xml is the uncompressed content
+   * @return true if successful, otherwise false
+   */
+  static bool readDocumentData(const QString &fileName, QByteArray &xml);
+  /**
+   * @brief splitPages finds the byte ranges of the <page> elements without parsing the xml
+   * @param xml
+   * @param parsedPages gets one entry per page, in document order
+   * @return false if a page element is not closed or there are no pages
+   */
+  static bool splitPages(const QByteArray &xml, QVector<ParsedPage> &parsedPages);
+  /**
+   * @brief parseMOJPage parses a <page> element of a .moj file
+   * @param parsedPage
+   * @param headerOnly if true, only size and background are parsed
+   */
+  static void parseMOJPage(ParsedPage &parsedPage, bool headerOnly = false);
+  static void parseXOJPage(ParsedPage &parsedPage, bool headerOnly = false);
+  /**
+   * @brief The XmlPageSource class keeps the compressed <page> elements of a large .moj or .xoj file, which are parsed when the pages are
+   * accessed
+   */
+  class XmlPageSource;
+  enum class xmlFormat
+  {
+    MOJ,
+    XOJ
+  };
+  /**
+   * @brief setXmlSource turns the pages into stubs of an XmlPageSource holding the compressed elements of @param parsedPages
+   */
+  void setXmlSource(const QVector<ParsedPage> &parsedPages, xmlFormat fileFormat);
+  /**
+   * @brief assemblePages binds the pdf backgrounds and replaces the pages of the document with the parsed pages
+   * @return false if one of the pages could not be parsed (the pages of the document are unchanged in this case) or a pdf could not be loaded
+   */
+  bool assemblePages(QVector<ParsedPage> &parsedPages);
+
+  /**
+   * @brief canExportWithAnnotations
+   * @return true if the pages are exactly the pages of the pdf, in the same order, so that they can be exported as annotations
+   */
+  bool canExportWithAnnotations();
+  /**
+   * @brief exportPDFWithAnnotations loads a second instance of the pdf, adds every stroke as ink annotation and every text and markdown
+   * document as free text annotation to its pages and writes it with Poppler::PDFConverter. Strokes have the width of the pen, the pressure
+   * is not kept.
+   * @param fileName is the full path, it may be the pdf itself
+   * @return true if successful, otherwise false
+   */
+  bool exportPDFWithAnnotations(const QString &fileName);
+  static constexpr qreal imageExportZoom = 2.0; /**< pixels per point of exportPDFAsImage */
+
   bool m_documentChanged;
 
   QString m_docName;
   QString m_path;
+  QString m_fileSuffix = QString("moj");
   QString m_pdfPath; /**< path to the underlying pdf file */
 
-  std::shared_ptr<Poppler::Document> m_pdfDoc; /**< pointer to the underlying pdf file (opened with poppler) */
+  std::shared_ptr<PdfDocument> m_pdfDoc; /**< the underlying pdf file (opened with poppler) */
 };
 }
 
@@ -0,0 +1,298 @@
+#include "gzipdevice.h"
+
+#include <QThread>
+#include <QtConcurrent>
+#include <algorithm>
+#include <limits>
+
+GzipDevice::GzipDevice(QIODevice *device, int level) : m_device(device), m_level(qMax(-1, qMin(9, level)))
+{
+  m_stream.zalloc = Z_NULL;
+  m_stream.zfree = Z_NULL;
+  m_stream.opaque = Z_NULL;
+  m_stream.avail_in = 0;
+  m_stream.next_in = Z_NULL;
+}
+
+GzipDevice::~GzipDevice()
+{
+  close();
+}
+
+bool GzipDevice::open(OpenMode mode)
+{
+  if ((mode & ReadWrite) == ReadWrite || (mode & ReadWrite) == NotOpen || mode & Append)
+  {
+    setErrorString(QStringLiteral("GzipDevice can only be opened for reading or for writing"));
+    return false;
+  }
+  if (m_device == nullptr || !m_device->isOpen())
+  {
+    setErrorString(QStringLiteral("The underlying device is not open"));
+    return false;
+  }
+
+  m_streamEnd = false;
+  m_error = false;
+  if (mode & ReadOnly)
+  {
+    m_stream.avail_in = 0;
+    m_stream.next_in = Z_NULL;
+    if (inflateInit2(&m_stream, GZIP_WINDOWS_BIT) != Z_OK)
+    {
+      setErrorString(QStringLiteral("Could not initialize zlib"));
+      return false;
+    }
+    m_streamInitialized = true;
+    m_input.resize(GZIP_CHUNK_SIZE);
+  }
+  else
+  {
+    // the blocks are deflated by QCompressor::deflateBlock, no stream is needed here
+    m_input.clear();
+    m_input.reserve(QCompressor::parallelBlockSize);
+    m_dictionary.clear();
+    m_crc = static_cast<quint32>(crc32(0L, Z_NULL, 0));
+    m_size = 0;
+    QByteArray header = QCompressor::gzipHeader();
+    if (m_device->write(header) != header.size())
+    {
+      setErrorString(m_device->errorString());
+      return false;
+    }
+  }
+
+  // text mode conversion would corrupt the binary stream, so it is never passed on
+  return QIODevice::open(mode & ~Text);
+}
+
+void GzipDevice::close()
+{
+  if (!isOpen())
+  {
+    return;
+  }
+  if (openMode() & WriteOnly)
+  {
+    if (!m_error && deflateInput(true))
+    {
+      while (!m_blocks.isEmpty())
+      {
+        if (!writeBlock())
+        {
+          break;
+        }
+      }
+      QByteArray trailer = QCompressor::gzipTrailer(m_crc, m_size);
+      if (!m_error && m_device->write(trailer) != trailer.size())
+      {
+        setError(m_device->errorString());
+      }
+    }
+    // blocks still being deflated own their data, they are discarded when they are done
+    m_blocks.clear();
+  }
+  else if (m_streamInitialized)
+  {
+    inflateEnd(&m_stream);
+  }
+  m_streamInitialized = false;
+  m_input.clear();
+  m_dictionary.clear();
+  QIODevice::close();
+}
+
+bool GzipDevice::isSequential() const
+{
+  return true;
+}
+
+bool GzipDevice::atEnd() const
+{
+  return (openMode() & ReadOnly) && (m_streamEnd || m_error) && QIODevice::bytesAvailable() == 0;
+}
+
+qint64 GzipDevice::bytesAvailable() const
+{
+  // the amount of uncompressed data is unknown, at least one more byte is promised until the end of the stream is reached
+  qint64 buffered = QIODevice::bytesAvailable();
+  if ((openMode() & ReadOnly) && !m_streamEnd && !m_error)
+  {
+    return buffered + 1;
+  }
+  return buffered;
+}
+
+bool GzipDevice::hasError() const
+{
+  return m_error;
+}
+
+qint64 GzipDevice::uncompressedSizeHint(QIODevice *device)
+{
+  if (device == nullptr || device->isSequential() || device->size() < 18)
+  {
+    return 0;
+  }
+  qint64 pos = device->pos();
+  quint32 size = 0;
+  if (device->seek(device->size() - 4))
+  {
+    QByteArray trailer = device->read(4);
+    if (trailer.size() == 4)
+    {
+      // ISIZE is stored little endian
+      for (int i = 3; i >= 0; --i)
+      {
+        size = (size << 8) | static_cast<quint8>(trailer.at(i));
+      }
+    }
+  }
+  device->seek(pos);
+  return size;
+}
+
+qint64 GzipDevice::readData(char *data, qint64 maxSize)
+{
+  if (m_error)
+  {
+    return -1;
+  }
+  if (maxSize <= 0)
+  {
+    return 0;
+  }
+
+  m_stream.next_out = reinterpret_cast<unsigned char *>(data);
+  m_stream.avail_out = static_cast<uInt>(qMin<qint64>(maxSize, std::numeric_limits<uInt>::max()));
+  while (m_stream.avail_out > 0 && !m_streamEnd)
+  {
+    if (m_stream.avail_in == 0)
+    {
+      qint64 read = m_device->read(m_input.data(), m_input.size());
+      if (read < 0)
+      {
+        setError(m_device->errorString());
+        return -1;
+      }
+      if (read == 0)
+      {
+        if (m_device->atEnd())
+        {
+          setError(QStringLiteral("Unexpected end of the compressed stream"));
+          return -1;
+        }
+        // a sequential device without data at the moment
+        break;
+      }
+      m_stream.next_in = reinterpret_cast<unsigned char *>(m_input.data());
+      m_stream.avail_in = static_cast<uInt>(read);
+    }
+
+    int ret = inflate(&m_stream, Z_NO_FLUSH);
+    if (ret == Z_NEED_DICT || ret == Z_DATA_ERROR || ret == Z_MEM_ERROR || ret == Z_STREAM_ERROR)
+    {
+      setError(QStringLiteral("Invalid compressed data"));
+      return -1;
+    }
+    if (ret == Z_STREAM_END)
+    {
+      // another gzip member may follow
+      if (m_stream.avail_in == 0)
+      {
+        qint64 read = m_device->read(m_input.data(), m_input.size());
+        if (read > 0)
+        {
+          m_stream.next_in = reinterpret_cast<unsigned char *>(m_input.data());
+          m_stream.avail_in = static_cast<uInt>(read);
+        }
+      }
+      if (m_stream.avail_in > 0)
+      {
+        inflateReset(&m_stream);
+      }
+      else
+      {
+        m_streamEnd = true;
+      }
+    }
+  }
+  return maxSize - m_stream.avail_out;
+}
+
+qint64 GzipDevice::writeData(const char *data, qint64 maxSize)
+{
+  if (m_error)
+  {
+    return -1;
+  }
+  // QXmlStreamWriter writes token by token, the input is collected to deflate a whole block at once. Large writes are cut into blocks, so
+  // a block never gets larger than QCompressor::parallelBlockSize.
+  qint64 written = 0;
+  while (written < maxSize)
+  {
+    int count = static_cast<int>(std::min<qint64>(maxSize - written, QCompressor::parallelBlockSize - m_input.size()));
+    m_input.append(data + written, count);
+    written += count;
+    if (m_input.size() >= QCompressor::parallelBlockSize && !deflateInput(false))
+    {
+      return -1;
+    }
+  }
+  return maxSize;
+}
+
+bool GzipDevice::deflateInput(bool last)
+{
+  QByteArray block;
+  block.swap(m_input);
+  m_input.reserve(QCompressor::parallelBlockSize);
+
+  // the next block is primed with the end of this one, so the blocks compress almost as well as a single stream
+  QByteArray dictionary = m_dictionary;
+  if (block.size() >= QCompressor::dictionarySize)
+  {
+    m_dictionary = block.right(QCompressor::dictionarySize);
+  }
+  else
+  {
+    m_dictionary = (m_dictionary + block).right(QCompressor::dictionarySize);
+  }
+
+  int level = m_level;
+  m_blocks.enqueue(QtConcurrent::run([block, dictionary, level, last]() { return QCompressor::deflateBlock(block, dictionary, level, last); }));
+
+  // the blocks are written in order, so a slow block holds back the ones behind it
+  while (m_blocks.size() > 2 * qMax(1, QThread::idealThreadCount()))
+  {
+    if (!writeBlock())
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool GzipDevice::writeBlock()
+{
+  QCompressor::DeflatedBlock deflated = m_blocks.dequeue().result();
+  if (!deflated.ok)
+  {
+    setError(QStringLiteral("Could not compress the data"));
+    return false;
+  }
+  m_crc = static_cast<quint32>(crc32_combine(m_crc, deflated.crc, static_cast<z_off_t>(deflated.size)));
+  m_size += deflated.size;
+  if (m_device->write(deflated.data) != deflated.data.size())
+  {
+    setError(m_device->errorString());
+    return false;
+  }
+  return true;
+}
+
+void GzipDevice::setError(const QString &errorString)
+{
+  m_error = true;
+  setErrorString(errorString);
+}
@@ -0,0 +1,83 @@
+#ifndef GZIPDEVICE_H
+#define GZIPDEVICE_H
+
+#include "qcompressor.h"
+
+#include <zlib.h>
+#include <QByteArray>
+#include <QFuture>
+#include <QIODevice>
+#include <QQueue>
+
+/**
+ * @brief The GzipDevice class compresses or decompresses gzip data on the fly while it is written to or read from another device.
+ * @details Opened with QIODevice::WriteOnly, everything written to it is deflated into the underlying device. The data is collected in
+ * blocks of QCompressor::parallelBlockSize bytes, which are deflated concurrently on the global thread pool and written in order as a single
+ * gzip member (see QCompressor::deflateBlock). At most two blocks per thread are kept in memory. Opened with QIODevice::ReadOnly, it
+ * inflates the content of the underlying device (concatenated gzip members are read one after another), keeping one chunk of compressed
+ * and one chunk of uncompressed data in memory. QXmlStreamWriter and QXmlStreamReader can therefore work on files of any size.
+ *
+ * The underlying device has to be opened before and is not closed by the GzipDevice. The compressed stream is only complete after close().
+ */
+class GzipDevice : public QIODevice
+{
+public:
+  /**
+   * @param device is the device containing the compressed data
+   * @param level is the compression level (@c 0 = no compression, @c 9 = max, @c -1 = default)
+   */
+  explicit GzipDevice(QIODevice *device, int level = -1);
+  ~GzipDevice() override;
+
+  bool open(OpenMode mode) override;
+  /**
+   * @brief close writes the rest of the compressed stream and the gzip trailer (in write mode)
+   */
+  void close() override;
+  bool isSequential() const override;
+  bool atEnd() const override;
+  qint64 bytesAvailable() const override;
+
+  /**
+   * @brief hasError
+   * @return true if the compressed stream was invalid or the underlying device could not be read or written
+   */
+  bool hasError() const;
+
+  /**
+   * @brief uncompressedSizeHint reads the size field of the gzip trailer of a seekable device without changing its position
+   * @param device
+   * @return the uncompressed size (modulo 2^32) of the last gzip member, or 0 if it cannot be determined
+   */
+  static qint64 uncompressedSizeHint(QIODevice *device);
+
+protected:
+  qint64 readData(char *data, qint64 maxSize) override;
+  qint64 writeData(const char *data, qint64 maxSize) override;
+
+private:
+  /**
+   * @brief deflateInput queues the collected input as block to be deflated
+   * @param last is true for the last block of the gzip member
+   */
+  bool deflateInput(bool last);
+  /**
+   * @brief writeBlock waits for the oldest queued block and writes it to the device
+   */
+  bool writeBlock();
+  void setError(const QString &errorString);
+
+  QIODevice *m_device;
+  int m_level;
+  z_stream m_stream;
+  bool m_streamInitialized = false;
+  bool m_streamEnd = false; /**< the end of the last gzip member was read */
+  bool m_error = false;
+  QByteArray m_input; /**< uncompressed data waiting to be deflated (write mode) or compressed data read from the device (read mode) */
+  QByteArray m_dictionary; /**< end of the uncompressed data in front of m_input (write mode) */
+  QQueue<QFuture<QCompressor::DeflatedBlock>> m_blocks; /**< blocks being deflated, in order (write mode) */
+  quint32 m_crc = 0; /**< crc32 of the uncompressed data written so far (write mode) */
+  qint64 m_size = 0; /**< size of the uncompressed data written so far (write mode) */
+};
+
+#endif // GZIPDEVICE_H
@@ -0,0 +1,317 @@
+#include "headless.h"
+
+#include "document.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QFileInfo>
+#include <QImage>
+#include <QThreadPool>
+#include <QtConcurrent>
+
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+
+enum class command
+{
+  CONVERT,
+  EXPORT_PDF,
+  RENDER
+};
+
+struct Options
+{
+  command cmd = command::CONVERT;
+  QString format = "moj";
+  QString outputDir; /**< empty to write next to the input file */
+  qreal dpi = 150.0;
+  QString pages; /**< page range of render, empty for all pages */
+};
+
+/**
+ * @brief The Result struct is what processing one file prints, so that the output of parallel jobs is printed in the order of the files
+ */
+struct Result
+{
+  QStringList written;
+  QString error;
+};
+
+/**
+ * @brief outputFileName
+ * @return the path of the file @param tail is written to, e.g. "-3.png" for the third rendered page
+ */
+QString outputFileName(const Options &options, const QString &inputFileName, const QString &tail)
+{
+  QFileInfo inputInfo(inputFileName);
+  QString dir = options.outputDir.isEmpty() ? inputInfo.absolutePath() : options.outputDir;
+  return QDir(dir).filePath(inputInfo.completeBaseName() + tail);
+}
+
+/**
+ * @brief parsePageRange parses a list of pages and ranges like "1-3,5,8-" (the first page is 1)
+ * @param range
+ * @param pageCount
+ * @param pageNums gets the indices of the pages, starting at 0
+ * @return false if the range is invalid or contains a page after the last one
+ */
+bool parsePageRange(const QString &range, int pageCount, QVector<int> &pageNums)
+{
+  if (range.isEmpty())
+  {
+    for (int pageNum = 0; pageNum < pageCount; ++pageNum)
+    {
+      pageNums.append(pageNum);
+    }
+    return true;
+  }
+
+  for (const QString &part : range.split(',', Qt::SkipEmptyParts))
+  {
+    int dash = part.indexOf('-');
+    QString firstText = dash < 0 ? part : part.left(dash);
+    QString lastText = dash < 0 ? part : part.mid(dash + 1);
+    bool ok = true;
+    int first = firstText.trimmed().isEmpty() ? 1 : firstText.toInt(&ok);
+    if (!ok)
+    {
+      return false;
+    }
+    int last = lastText.trimmed().isEmpty() ? pageCount : lastText.toInt(&ok);
+    if (!ok || first < 1 || last < first || last > pageCount)
+    {
+      return false;
+    }
+    for (int pageNum = first - 1; pageNum < last; ++pageNum)
+    {
+      pageNums.append(pageNum);
+    }
+  }
+  return true;
+}
+
+Result processFile(const Options &options, const QString &fileName)
+{
+  Result result;
+  MrDoc::Document document;
+  if (!document.loadBySuffix(fileName))
+  {
+    result.error = QCoreApplication::translate("headless", "could not be opened");
+    return result;
+  }
+
+  if (options.cmd == command::CONVERT)
+  {
+    QString convertedFileName = outputFileName(options, fileName, "." + options.format);
+    if (QFileInfo(convertedFileName) == QFileInfo(fileName))
+    {
+      result.error = QCoreApplication::translate("headless", "would be overwritten by its conversion");
+    }
+    else if (document.saveBySuffix(convertedFileName))
+    {
+      result.written.append(convertedFileName);
+    }
+    else
+    {
+      result.error = QCoreApplication::translate("headless", "could not be saved as %1").arg(convertedFileName);
+    }
+  }
+  else if (options.cmd == command::EXPORT_PDF)
+  {
+    QString pdfFileName = outputFileName(options, fileName, ".pdf");
+    if (QFileInfo(pdfFileName) == QFileInfo(fileName))
+    {
+      result.error = QCoreApplication::translate("headless", "would be overwritten by its export");
+    }
+    else if (document.exportPDF(pdfFileName))
+    {
+      result.written.append(pdfFileName);
+    }
+    else
+    {
+      result.error = QCoreApplication::translate("headless", "could not be exported to %1").arg(pdfFileName);
+    }
+  }
+  else
+  {
+    QVector<int> pageNums;
+    if (!parsePageRange(options.pages, document.pages.size(), pageNums))
+    {
+      result.error = QCoreApplication::translate("headless", "has no pages %1").arg(options.pages);
+      return result;
+    }
+    // the pages are rendered in parallel as well. Every task paints its own copy of the page, see Document::rasterizePage.
+    struct RenderedPage
+    {
+      int pageNum;
+      QString pngFileName; /**< empty if the page could not be written */
+    };
+    QVector<RenderedPage> renderedPages;
+    for (int pageNum : pageNums)
+    {
+      renderedPages.append({pageNum, QString()});
+    }
+    int digits = QString::number(document.pages.size()).size();
+    qreal zoom = options.dpi / 72.0;
+    int dotsPerMeter = qRound(options.dpi / 0.0254);
+    QtConcurrent::blockingMap(renderedPages, [&](RenderedPage &renderedPage) {
+      QImage image = MrDoc::Document::rasterizePage(document.pages.at(renderedPage.pageNum), zoom);
+      image.setDotsPerMeterX(dotsPerMeter);
+      image.setDotsPerMeterY(dotsPerMeter);
+      QString pngFileName = outputFileName(options, fileName, QString("-%1.png").arg(renderedPage.pageNum + 1, digits, 10, QChar('0')));
+      if (image.save(pngFileName, "PNG"))
+      {
+        renderedPage.pngFileName = pngFileName;
+      }
+    });
+    for (const RenderedPage &renderedPage : renderedPages)
+    {
+      if (renderedPage.pngFileName.isEmpty())
+      {
+        result.error = QCoreApplication::translate("headless", "could not be rendered completely");
+      }
+      else
+      {
+        result.written.append(renderedPage.pngFileName);
+      }
+    }
+  }
+  return result;
+}
+}
+
+bool Headless::isRequested(int argc, char *argv[])
+{
+  for (int i = 1; i < argc; ++i)
+  {
+    if (std::strcmp(argv[i], "--headless") == 0)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+int Headless::run(const QStringList &arguments)
+{
+  QCommandLineParser parser;
+  parser.setApplicationDescription(QCoreApplication::translate("headless", "Converts, exports and renders documents without opening a window."));
+  QCommandLineOption helpOption = parser.addHelpOption();
+  parser.addOption(QCommandLineOption("headless", QCoreApplication::translate("headless", "Run without a window.")));
+  QCommandLineOption formatOption("format", QCoreApplication::translate("headless", "Format of convert: moj, mojb or mojt."), "format", "moj");
+  QCommandLineOption outputDirOption("output-dir", QCoreApplication::translate("headless", "Directory of the output files."), "dir");
+  QCommandLineOption jobsOption("jobs", QCoreApplication::translate("headless", "Number of files and pages processed in parallel."), "n");
+  QCommandLineOption dpiOption("dpi", QCoreApplication::translate("headless", "Resolution of render."), "dpi", "150");
+  QCommandLineOption pagesOption("pages", QCoreApplication::translate("headless", "Pages to render, e.g. 1-3,5,8-"), "pages");
+  parser.addOption(formatOption);
+  parser.addOption(outputDirOption);
+  parser.addOption(jobsOption);
+  parser.addOption(dpiOption);
+  parser.addOption(pagesOption);
+  parser.addPositionalArgument("command", QCoreApplication::translate("headless", "convert, export-pdf or render"));
+  parser.addPositionalArgument("files", QCoreApplication::translate("headless", ".xoj, .moj, .mojb, .mojt or .pdf files"), "files...");
+
+  if (!parser.parse(arguments))
+  {
+    std::cerr << qPrintable(parser.errorText()) << std::endl;
+    return 2;
+  }
+  if (parser.isSet(helpOption))
+  {
+    std::cout << qPrintable(parser.helpText()) << std::endl;
+    return 0;
+  }
+
+  QStringList positionalArguments = parser.positionalArguments();
+  if (positionalArguments.size() < 2)
+  {
+    std::cerr << qPrintable(parser.helpText()) << std::endl;
+    return 2;
+  }
+
+  Options options;
+  QString commandName = positionalArguments.takeFirst();
+  if (commandName == "convert")
+  {
+    options.cmd = command::CONVERT;
+  }
+  else if (commandName == "export-pdf")
+  {
+    options.cmd = command::EXPORT_PDF;
+  }
+  else if (commandName == "render")
+  {
+    options.cmd = command::RENDER;
+  }
+  else
+  {
+    std::cerr << qPrintable(QCoreApplication::translate("headless", "Unknown command %1").arg(commandName)) << std::endl;
+    return 2;
+  }
+
+  options.format = parser.value(formatOption).toLower();
+  if (options.format != "moj" && options.format != "mojb" && options.format != "mojt")
+  {
+    std::cerr << qPrintable(QCoreApplication::translate("headless", "Unknown format %1").arg(options.format)) << std::endl;
+    return 2;
+  }
+  bool ok = true;
+  options.dpi = parser.value(dpiOption).toDouble(&ok);
+  if (!ok || options.dpi <= 0.0)
+  {
+    std::cerr << qPrintable(QCoreApplication::translate("headless", "Invalid resolution %1").arg(parser.value(dpiOption))) << std::endl;
+    return 2;
+  }
+  options.pages = parser.value(pagesOption);
+  if (parser.isSet(outputDirOption))
+  {
+    options.outputDir = parser.value(outputDirOption);
+    if (!QDir().mkpath(options.outputDir))
+    {
+      std::cerr << qPrintable(QCoreApplication::translate("headless", "Couldn't create %1").arg(options.outputDir)) << std::endl;
+      return 2;
+    }
+  }
+  if (parser.isSet(jobsOption))
+  {
+    int jobCount = parser.value(jobsOption).toInt(&ok);
+    if (!ok || jobCount < 1)
+    {
+      std::cerr << qPrintable(QCoreApplication::translate("headless", "Invalid number of jobs %1").arg(parser.value(jobsOption))) << std::endl;
+      return 2;
+    }
+    // files, pages and the blocks of the exports all run in the global pool
+    QThreadPool::globalInstance()->setMaxThreadCount(jobCount);
+  }
+
+  struct Job
+  {
+    QString fileName;
+    Result result;
+  };
+  QVector<Job> jobs;
+  for (const QString &fileName : positionalArguments)
+  {
+    jobs.append({fileName, Result()});
+  }
+  QtConcurrent::blockingMap(jobs, [&options](Job &job) { job.result = processFile(options, job.fileName); });
+
+  int exitCode = 0;
+  for (const Job &job : jobs)
+  {
+    for (const QString &written : job.result.written)
+    {
+      std::cout << qPrintable(written) << std::endl;
+    }
+    if (!job.result.error.isEmpty())
+    {
+      std::cerr << qPrintable(job.fileName) << ": " << qPrintable(job.result.error) << std::endl;
+      exitCode = 1;
+    }
+  }
+  return exitCode;
+}
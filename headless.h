@@ -0,0 +1,34 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include <QStringList>
+
+/**
+ * @brief The Headless class runs MrWriter without a window, to convert, export and render documents from the command line.
+ * @details
+ *
+ *     MrWriter --headless convert [--format moj|mojb|mojt] [--output-dir dir] [--jobs n] files...
+ *     MrWriter --headless export-pdf [--output-dir dir] [--jobs n] files...
+ *     MrWriter --headless render [--dpi dpi] [--pages 1-3,5,8-] [--output-dir dir] [--jobs n] files...
+ *
+ * Input files can be .xoj, .moj, .mojb, .mojt or .pdf. The output is written next to the input file (or into the output directory) with the
+ * same base name, rendered pages are named <base name>-<page>.png. The files, and the pages of rendered files, are processed in parallel by
+ * @c --jobs threads.
+ */
+class Headless
+{
+public:
+  /**
+   * @brief isRequested checks the raw command line for @c --headless. It is called before the application is created, because the platform
+   * plugin has to be chosen before.
+   */
+  static bool isRequested(int argc, char *argv[]);
+  /**
+   * @brief run parses the command line and processes all files. An application has to exist.
+   * @param arguments the command line including the program name and @c --headless
+   * @return exit code: 0 if every file was processed, 1 if a file failed, 2 if the command line is invalid
+   */
+  static int run(const QStringList &arguments);
+};
+
+#endif // HEADLESS_H
@@ -0,0 +1,57 @@
+#include "htmlmarkdownrenderer.h"
+
+#include <QMutex>
+#include <QMutexLocker>
+#include <QTextDocument>
+
+extern "C" {
+#include <mkdio.h>
+}
+
+namespace
+{
+// libmarkdown keeps global state, but markdown is laid out and painted from several threads, e.g. by parallel exports
+QMutex libmarkdownMutex;
+}
+
+QSizeF HtmlMarkdownRenderer::size(const QString &markdown, const QSizeF &pageSize) const
+{
+  QTextDocument td;
+  td.setHtml(compileMarkdown(markdown));
+  if (!pageSize.isEmpty())
+  {
+    td.setPageSize(pageSize);
+  }
+  return td.size();
+}
+
+void HtmlMarkdownRenderer::paint(QPainter &painter, const QRectF &rect, const QString &markdown) const
+{
+  QTextDocument td;
+  td.setHtml(compileMarkdown(markdown));
+  painter.translate(rect.x(), rect.y());
+  td.setPageSize(rect.size());
+  td.drawContents(&painter);
+  painter.translate(-rect.x(), -rect.y());
+}
+
+QString HtmlMarkdownRenderer::plainText(const QString &markdown) const
+{
+  QTextDocument td;
+  td.setHtml(compileMarkdown(markdown));
+  return td.toPlainText();
+}
+
+QString HtmlMarkdownRenderer::compileMarkdown(const QString &text)
+{
+  QByteArray data = text.toUtf8();
+  QMutexLocker locker(&libmarkdownMutex);
+  MMIOT *doc = mkd_string(data.data(), data.length(), 0);
+  mkd_compile(doc, 0);
+  char *output = nullptr;
+  int length = mkd_document(doc, &output);
+  // the output belongs to doc
+  QString html = length > 0 ? QString::fromUtf8(output, length) : QString();
+  mkd_cleanup(doc);
+  return html;
+}
@@ -0,0 +1,24 @@
+#ifndef HTMLMARKDOWNRENDERER_H
+#define HTMLMARKDOWNRENDERER_H
+
+#include "markdownrenderer.h"
+
+/**
+ * @brief The HtmlMarkdownRenderer class compiles markdown to html with libmarkdown (discount) and typesets it with QTextDocument. It is
+ * installed by main, so the document core does not depend on libmarkdown.
+ */
+class HtmlMarkdownRenderer : public MrDoc::MarkdownRenderer
+{
+public:
+  QSizeF size(const QString &markdown, const QSizeF &pageSize = QSizeF()) const override;
+  void paint(QPainter &painter, const QRectF &rect, const QString &markdown) const override;
+  QString plainText(const QString &markdown) const override;
+
+  /**
+   * @brief compileMarkdown compiles @param text to html. Calls of libmarkdown are serialized, so it can be called from several threads.
+   * @return the html
+   */
+  static QString compileMarkdown(const QString &text);
+};
+
+#endif // HTMLMARKDOWNRENDERER_H
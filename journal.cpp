@@ -0,0 +1,784 @@
+#include "journal.h"
+#include "binarydocument.h"
+
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QUuid>
+#include <QtConcurrent>
+
+#include <zlib.h>
+
+#ifdef Q_OS_WIN
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace MrDoc
+{
+
+namespace
+{
+/**
+ * @brief syncFile writes the buffered data of @param file and waits until it is on the disk
+ */
+bool syncFile(QFile &file)
+{
+  if (!file.flush())
+  {
+    return false;
+  }
+#ifdef Q_OS_WIN
+  return _commit(file.handle()) == 0;
+#else
+  return fsync(file.handle()) == 0;
+#endif
+}
+
+QString lockFileName(const QString &journalFileName)
+{
+  return journalFileName + ".lock";
+}
+
+const QString journalSuffix = QString(".journal");
+}
+
+const char Journal::magic[4] = {'M', 'O', 'J', 'J'};
+
+Journal::Journal()
+{
+}
+
+Journal::~Journal()
+{
+  // the files are kept, without the lock the journal can be recovered
+  m_compaction.waitForFinished();
+  flush();
+}
+
+bool Journal::start(Document *document)
+{
+  stop();
+
+  QString documentFileName = document->fileName();
+  if (documentFileName.isEmpty())
+  {
+    QDir().mkpath(journalDirectory());
+    m_fileName = journalDirectory() + "/untitled-" + QUuid::createUuid().toString().mid(1, 36) + journalSuffix;
+  }
+  else
+  {
+    m_fileName = journalFileName(documentFileName);
+  }
+
+  m_lockFile.reset(new QLockFile(lockFileName(m_fileName)));
+  m_lockFile->setStaleLockTime(0);
+  if (!m_lockFile->tryLock(0))
+  {
+    qWarning() << "journal" << m_fileName << "is in use";
+    m_lockFile.reset();
+    m_fileName.clear();
+    return false;
+  }
+  m_document = document;
+  m_snapshotSlot = 1;
+
+  bool ok;
+  if (!documentFileName.isEmpty() && !document->documentChanged())
+  {
+    ok = writeHeader(baseType::DOCUMENT_FILE, documentFileName);
+  }
+  else
+  {
+    ok = compact();
+  }
+  if (!ok)
+  {
+    qWarning() << "could not write journal" << m_fileName;
+    stop();
+  }
+  return ok;
+}
+
+void Journal::stop()
+{
+  m_compaction.waitForFinished();
+  m_compacting = false;
+  m_sinceSnapshot.clear();
+  if (m_lockFile != nullptr)
+  {
+    m_file.close();
+    QFile::remove(m_fileName);
+    QFile::remove(snapshotFileName(0));
+    QFile::remove(snapshotFileName(1));
+    m_lockFile.reset();
+  }
+  m_document = nullptr;
+  m_fileName.clear();
+  m_pending.clear();
+  m_journalSize = 0;
+  m_selection.clear();
+  m_selectionChanged = false;
+  m_markdown.clear();
+  m_markdownChanged = false;
+}
+
+bool Journal::isActive() const
+{
+  return m_document != nullptr;
+}
+
+ByteWriter Journal::beginRecord(recordType type)
+{
+  ByteWriter writer(m_pending);
+  writer.write(static_cast<quint8>(type));
+  return writer;
+}
+
+void Journal::insertStroke(int pageNum, int strokeNum, const Stroke &stroke)
+{
+  if (!isActive())
+  {
+    return;
+  }
+  ByteWriter writer = beginRecord(recordType::INSERT_STROKE);
+  writer.write(static_cast<qint32>(pageNum));
+  writer.write(static_cast<qint32>(strokeNum));
+  BinaryDocument::encodeStroke(writer, stroke);
+}
+
+void Journal::removeStroke(int pageNum, int strokeNum)
+{
+  if (!isActive())
+  {
+    return;
+  }
+  ByteWriter writer = beginRecord(recordType::REMOVE_STROKE);
+  writer.write(static_cast<qint32>(pageNum));
+  writer.write(static_cast<qint32>(strokeNum));
+}
+
+void Journal::insertPage(int pageNum, Page &page)
+{
+  if (!isActive())
+  {
+    return;
+  }
+  ByteWriter writer = beginRecord(recordType::INSERT_PAGE);
+  writer.write(static_cast<qint32>(pageNum));
+  writer.writeDouble(page.width());
+  writer.writeDouble(page.height());
+  writer.write(static_cast<quint32>(page.backgroundColor().rgba()));
+  writer.write(BinaryDocument::backgroundTypeToCode(page.getBackgroundType()));
+  writer.write(static_cast<qint32>(page.isPdf() ? page.pageNum() + 1 : 0));
+  BinaryDocument::encodeContent(writer, page);
+}
+
+void Journal::removePage(int pageNum)
+{
+  if (!isActive())
+  {
+    return;
+  }
+  ByteWriter writer = beginRecord(recordType::REMOVE_PAGE);
+  writer.write(static_cast<qint32>(pageNum));
+}
+
+void Journal::changePageSettings(int pageNum, Page &page)
+{
+  if (!isActive())
+  {
+    return;
+  }
+  ByteWriter writer = beginRecord(recordType::CHANGE_PAGE_SETTINGS);
+  writer.write(static_cast<qint32>(pageNum));
+  writer.writeDouble(page.width());
+  writer.writeDouble(page.height());
+  writer.write(static_cast<quint32>(page.backgroundColor().rgba()));
+  writer.write(BinaryDocument::backgroundTypeToCode(page.getBackgroundType()));
+}
+
+void Journal::appendText(int pageNum, const QRectF &rect, const QFont &font, const QColor &color, const QString &text)
+{
+  if (!isActive())
+  {
+    return;
+  }
+  ByteWriter writer = beginRecord(recordType::APPEND_TEXT);
+  writer.write(static_cast<qint32>(pageNum));
+  writer.writeRect(rect);
+  writer.writeString(font.toString());
+  writer.write(static_cast<quint32>(color.rgba()));
+  writer.writeString(text);
+}
+
+void Journal::setText(int pageNum, int textIndex, const QFont &font, const QColor &color, const QString &text)
+{
+  if (!isActive())
+  {
+    return;
+  }
+  ByteWriter writer = beginRecord(recordType::SET_TEXT);
+  writer.write(static_cast<qint32>(pageNum));
+  writer.write(static_cast<qint32>(textIndex));
+  writer.writeString(font.toString());
+  writer.write(static_cast<quint32>(color.rgba()));
+  writer.writeString(text);
+}
+
+void Journal::appendMarkdown(int pageNum, const QRectF &rect, const QString &text)
+{
+  if (!isActive())
+  {
+    return;
+  }
+  ByteWriter writer = beginRecord(recordType::APPEND_MARKDOWN);
+  writer.write(static_cast<qint32>(pageNum));
+  writer.writeRect(rect);
+  writer.writeString(text);
+}
+
+void Journal::insertMarkdown(int pageNum, int markdownIndex, const QString &text, const QRectF &rect)
+{
+  if (!isActive())
+  {
+    return;
+  }
+  ByteWriter writer = beginRecord(recordType::INSERT_MARKDOWN);
+  writer.write(static_cast<qint32>(pageNum));
+  writer.write(static_cast<qint32>(markdownIndex));
+  writer.writeRect(rect);
+  writer.writeString(text);
+}
+
+void Journal::resetMarkdown(int pageNum, int markdownIndex, const QString &text, const QRectF &rect)
+{
+  if (!isActive())
+  {
+    return;
+  }
+  ByteWriter writer = beginRecord(recordType::RESET_MARKDOWN);
+  writer.write(static_cast<qint32>(pageNum));
+  writer.write(static_cast<qint32>(markdownIndex));
+  writer.writeRect(rect);
+  writer.writeString(text);
+}
+
+void Journal::setSelection(int pageNum, const QVector<Stroke> &strokes)
+{
+  if (!isActive() || (strokes.isEmpty() && m_selection.isEmpty()))
+  {
+    return;
+  }
+  m_selectionPageNum = pageNum;
+  m_selection = strokes;
+  m_selectionChanged = true;
+}
+
+void Journal::setMarkdownSelection(int pageNum, const QRectF &rect, const QString &text)
+{
+  if (!isActive() || (text.isEmpty() && m_markdown.isEmpty()) || (pageNum == m_markdownPageNum && rect == m_markdownRect && text == m_markdown))
+  {
+    return;
+  }
+  m_markdownPageNum = pageNum;
+  m_markdownRect = rect;
+  m_markdown = text;
+  m_markdownChanged = true;
+}
+
+bool Journal::flush()
+{
+  if (!isActive())
+  {
+    return true;
+  }
+  bool ok = true;
+  if (m_compacting && m_compaction.isFinished())
+  {
+    ok = finishCompaction();
+    if (!isActive())
+    {
+      return false;
+    }
+  }
+  if (m_selectionChanged)
+  {
+    ByteWriter writer = beginRecord(recordType::SELECTION);
+    writer.write(static_cast<qint32>(m_selectionPageNum));
+    writer.write(static_cast<quint32>(m_selection.size()));
+    for (const Stroke &stroke : m_selection)
+    {
+      BinaryDocument::encodeStroke(writer, stroke);
+    }
+    m_selectionChanged = false;
+  }
+  if (m_markdownChanged)
+  {
+    ByteWriter writer = beginRecord(recordType::MARKDOWN_SELECTION);
+    writer.write(static_cast<qint32>(m_markdownPageNum));
+    writer.writeRect(m_markdownRect);
+    writer.writeString(m_markdown);
+    m_markdownChanged = false;
+  }
+  if (m_pending.isEmpty())
+  {
+    return ok;
+  }
+
+  QByteArray batch;
+  batch.reserve(8 + m_pending.size());
+  ByteWriter writer(batch);
+  writer.write(static_cast<quint32>(m_pending.size()));
+  writer.write(static_cast<quint32>(crc32(0, reinterpret_cast<const Bytef *>(m_pending.constData()), static_cast<uInt>(m_pending.size()))));
+  batch.append(m_pending);
+  m_pending.clear();
+
+  if (m_compacting)
+  {
+    m_sinceSnapshot.append(batch);
+  }
+  if (!m_file.isOpen())
+  {
+    // the journal of a document without base starts when its first snapshot is written
+    return ok && m_compacting;
+  }
+  m_journalSize += batch.size();
+  return m_file.write(batch) == batch.size() && syncFile(m_file) && ok;
+}
+
+bool Journal::needsCompaction() const
+{
+  return isActive() && !m_compacting && m_journalSize > compactionSize;
+}
+
+bool Journal::isCompacting() const
+{
+  return m_compacting;
+}
+
+bool Journal::compact()
+{
+  if (!isActive())
+  {
+    return false;
+  }
+  if (m_compacting)
+  {
+    return true;
+  }
+
+  // the records so far are part of the snapshot, so they end the current journal
+  if (m_file.isOpen() && !flush())
+  {
+    return false;
+  }
+  m_pending.clear();
+
+  // the worker writes a copy of the pages, like MainWindow::saveDocument
+  auto pages = std::make_shared<QVector<Page>>(m_document->pages);
+  pages->detach();
+  QString fileName = snapshotFileName(1 - m_snapshotSlot);
+  QString pdfPath = m_document->pdfPath();
+  m_sinceSnapshot.clear();
+  m_compacting = true;
+  m_compaction = QtConcurrent::run([pages, fileName, pdfPath]() { return BinaryDocument::write(fileName, *pages, pdfPath); });
+  return true;
+}
+
+bool Journal::finishCompaction()
+{
+  m_compacting = false;
+  QByteArray sinceSnapshot;
+  sinceSnapshot.swap(m_sinceSnapshot);
+  int slot = 1 - m_snapshotSlot;
+  if (!m_compaction.result())
+  {
+    QFile::remove(snapshotFileName(slot));
+    if (!m_file.isOpen())
+    {
+      // there is no journal without its first snapshot
+      qWarning() << "could not write journal" << m_fileName;
+      stop();
+      return false;
+    }
+    // the current journal is still complete, compaction is tried again when it grows
+    qWarning() << "could not write snapshot of journal" << m_fileName;
+    return true;
+  }
+
+  // the previous snapshot and journal stay valid until the new header replaces the journal
+  if (!writeHeader(baseType::SNAPSHOT, snapshotFileName(slot)))
+  {
+    return false;
+  }
+  QFile::remove(snapshotFileName(m_snapshotSlot));
+  m_snapshotSlot = slot;
+
+  // the edits made while the snapshot was written follow it, the selection is not part of it
+  m_journalSize = sinceSnapshot.size();
+  m_selectionChanged = !m_selection.isEmpty();
+  m_markdownChanged = !m_markdown.isEmpty();
+  return m_file.write(sinceSnapshot) == sinceSnapshot.size() && syncFile(m_file);
+}
+
+bool Journal::writeHeader(baseType type, const QString &baseFileName)
+{
+  QFileInfo baseInfo(baseFileName);
+  QByteArray header(magic, sizeof(magic));
+  ByteWriter writer(header);
+  writer.write(formatVersion);
+  writer.write(static_cast<quint8>(type));
+  writer.writePadding(3);
+  writer.write(static_cast<quint64>(baseInfo.size()));
+  writer.write(static_cast<qint64>(baseInfo.lastModified().toMSecsSinceEpoch()));
+  // snapshots are next to the journal, so only their name is stored
+  writer.writeString(type == baseType::SNAPSHOT ? baseInfo.fileName() : baseInfo.absoluteFilePath());
+  writer.writeString(m_document->fileName());
+
+  // the header replaces the journal atomically, the previous one stays valid until then
+  m_file.close();
+  QSaveFile saveFile(m_fileName);
+  if (!saveFile.open(QIODevice::WriteOnly) || saveFile.write(header) != header.size() || !saveFile.commit())
+  {
+    return false;
+  }
+  m_file.setFileName(m_fileName);
+  m_journalSize = 0;
+  return m_file.open(QIODevice::WriteOnly | QIODevice::Append);
+}
+
+QString Journal::snapshotFileName(int slot) const
+{
+  return snapshotFileName(m_fileName, slot);
+}
+
+QString Journal::snapshotFileName(const QString &journalFileName, int slot)
+{
+  return journalFileName + QString(".%1.mojb").arg(slot);
+}
+
+QString Journal::journalFileName(const QString &documentFileName)
+{
+  QFileInfo fileInfo(documentFileName);
+  return fileInfo.absolutePath() + "/." + fileInfo.fileName() + journalSuffix;
+}
+
+QString Journal::journalDirectory()
+{
+  return QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/journals";
+}
+
+QStringList Journal::untitledJournals()
+{
+  QStringList journals;
+  QDir directory(journalDirectory());
+  for (const QString &fileName : directory.entryList(QStringList() << ("untitled-*" + journalSuffix), QDir::Files, QDir::Time))
+  {
+    QString journal = directory.absoluteFilePath(fileName);
+    if (isRecoverable(journal))
+    {
+      journals.append(journal);
+    }
+  }
+  return journals;
+}
+
+bool Journal::isRecoverable(const QString &journalFileName)
+{
+  if (!QFile::exists(journalFileName))
+  {
+    return false;
+  }
+  QLockFile lockFile(lockFileName(journalFileName));
+  lockFile.setStaleLockTime(0);
+  return lockFile.tryLock(0);
+}
+
+bool Journal::recover(const QString &journalFileName, Document &document)
+{
+  QFile file(journalFileName);
+  if (!file.open(QIODevice::ReadOnly))
+  {
+    return false;
+  }
+  QByteArray data = file.readAll();
+  file.close();
+
+  if (data.size() < static_cast<int>(sizeof(magic)) || std::memcmp(data.constData(), magic, sizeof(magic)) != 0)
+  {
+    return false;
+  }
+  ByteReader header(reinterpret_cast<const uchar *>(data.constData()) + sizeof(magic), data.size() - static_cast<int>(sizeof(magic)));
+  quint32 version = header.read<quint32>();
+  baseType type = static_cast<baseType>(header.read<quint8>());
+  header.skip(3);
+  quint64 baseSize = header.read<quint64>();
+  qint64 baseModified = header.read<qint64>();
+  QString baseFileName = header.readString();
+  QString documentFileName = header.readString();
+  if (!header.ok() || version > formatVersion)
+  {
+    return false;
+  }
+  if (type == baseType::SNAPSHOT)
+  {
+    baseFileName = QFileInfo(journalFileName).absolutePath() + '/' + baseFileName;
+  }
+
+  QFileInfo baseInfo(baseFileName);
+  if (!baseInfo.exists() || static_cast<quint64>(baseInfo.size()) != baseSize || baseInfo.lastModified().toMSecsSinceEpoch() != baseModified)
+  {
+    qWarning() << "base of journal" << journalFileName << "is missing or was changed";
+    return false;
+  }
+  if (!document.loadBySuffix(baseFileName))
+  {
+    return false;
+  }
+  document.setFileName(documentFileName);
+
+  // a batch which is cut off or damaged was being written when the program stopped, it ends the journal
+  Floating floating;
+  qint64 pos = sizeof(magic) + header.pos();
+  while (pos + 8 <= data.size())
+  {
+    ByteReader batchHeader(reinterpret_cast<const uchar *>(data.constData()) + pos, 8);
+    quint32 size = batchHeader.read<quint32>();
+    quint32 checksum = batchHeader.read<quint32>();
+    if (size > static_cast<quint64>(data.size() - pos - 8))
+    {
+      break;
+    }
+    const uchar *batch = reinterpret_cast<const uchar *>(data.constData()) + pos + 8;
+    if (crc32(0, batch, size) != checksum)
+    {
+      break;
+    }
+    ByteReader reader(batch, size);
+    while (!reader.atEnd())
+    {
+      if (!applyRecord(reader, document, floating))
+      {
+        qWarning() << "journal" << journalFileName << "does not fit its base";
+        return false;
+      }
+    }
+    pos += 8 + size;
+  }
+
+  if (!floating.selection.isEmpty() && floating.selectionPageNum >= 0 && floating.selectionPageNum < document.pages.size())
+  {
+    document.pages[floating.selectionPageNum].appendStrokes(floating.selection);
+  }
+  if (!floating.markdown.isEmpty() && floating.markdownPageNum >= 0 && floating.markdownPageNum < document.pages.size())
+  {
+    document.pages[floating.markdownPageNum].appendMarkdown(floating.markdownRect, floating.markdown);
+  }
+  document.setDocumentChanged(true);
+  return true;
+}
+
+bool Journal::applyRecord(ByteReader &reader, Document &document, Floating &floating)
+{
+  recordType type = static_cast<recordType>(reader.read<quint8>());
+  qint32 pageNum = reader.read<qint32>();
+  if (!reader.ok())
+  {
+    return false;
+  }
+  bool pageExists = pageNum >= 0 && pageNum < document.pages.size();
+
+  switch (type)
+  {
+  case recordType::INSERT_STROKE:
+  {
+    qint32 strokeNum = reader.read<qint32>();
+    Stroke stroke;
+    if (!pageExists || !BinaryDocument::decodeStroke(reader, stroke))
+    {
+      return false;
+    }
+    Page &page = document.pages[pageNum];
+    if (strokeNum == -1)
+    {
+      page.appendStroke(stroke);
+    }
+    else if (strokeNum >= 0 && strokeNum <= page.strokes().size())
+    {
+      page.insertStroke(strokeNum, stroke);
+    }
+    else
+    {
+      return false;
+    }
+    return true;
+  }
+  case recordType::REMOVE_STROKE:
+  {
+    qint32 strokeNum = reader.read<qint32>();
+    if (!pageExists)
+    {
+      return false;
+    }
+    Page &page = document.pages[pageNum];
+    if (strokeNum == -1)
+    {
+      strokeNum = page.strokes().size() - 1;
+    }
+    if (strokeNum < 0 || strokeNum >= page.strokes().size())
+    {
+      return false;
+    }
+    page.removeStrokeAt(strokeNum);
+    return reader.ok();
+  }
+  case recordType::INSERT_PAGE:
+  {
+    Page page;
+    page.setWidth(reader.readDouble());
+    page.setHeight(reader.readDouble());
+    page.setBackgroundColor(QColor::fromRgba(reader.read<quint32>()));
+    page.setBackgroundType(BinaryDocument::codeToBackgroundType(reader.read<quint8>()));
+    qint32 pdfPageNum = reader.read<qint32>();
+    if (pageNum < 0 || pageNum > document.pages.size() || !BinaryDocument::decodeContent(reader, page))
+    {
+      return false;
+    }
+    document.pages.insert(pageNum, page);
+    return pdfPageNum == 0 || document.setPdfBackground(pageNum, pdfPageNum - 1);
+  }
+  case recordType::REMOVE_PAGE:
+  {
+    if (!pageExists)
+    {
+      return false;
+    }
+    document.pages.removeAt(pageNum);
+    return true;
+  }
+  case recordType::CHANGE_PAGE_SETTINGS:
+  {
+    qreal width = reader.readDouble();
+    qreal height = reader.readDouble();
+    QColor backgroundColor = QColor::fromRgba(reader.read<quint32>());
+    Page::backgroundType backgroundType = BinaryDocument::codeToBackgroundType(reader.read<quint8>());
+    if (!pageExists || !reader.ok())
+    {
+      return false;
+    }
+    Page &page = document.pages[pageNum];
+    page.setWidth(width);
+    page.setHeight(height);
+    page.setBackgroundColor(backgroundColor);
+    page.setBackgroundType(backgroundType);
+    return true;
+  }
+  case recordType::APPEND_TEXT:
+  {
+    QRectF rect = reader.readRect();
+    QFont font;
+    font.fromString(reader.readString());
+    QColor color = QColor::fromRgba(reader.read<quint32>());
+    QString text = reader.readString();
+    if (!pageExists || !reader.ok())
+    {
+      return false;
+    }
+    document.pages[pageNum].appendText(rect, font, color, text);
+    return true;
+  }
+  case recordType::SET_TEXT:
+  {
+    qint32 textIndex = reader.read<qint32>();
+    QFont font;
+    font.fromString(reader.readString());
+    QColor color = QColor::fromRgba(reader.read<quint32>());
+    QString text = reader.readString();
+    if (!pageExists || !reader.ok() || textIndex < 0 || textIndex >= document.pages[pageNum].texts().size())
+    {
+      return false;
+    }
+    document.pages[pageNum].setText(textIndex, font, color, text);
+    return true;
+  }
+  case recordType::APPEND_MARKDOWN:
+  {
+    QRectF rect = reader.readRect();
+    QString text = reader.readString();
+    if (!pageExists || !reader.ok())
+    {
+      return false;
+    }
+    document.pages[pageNum].appendMarkdown(rect, text);
+    return true;
+  }
+  case recordType::INSERT_MARKDOWN:
+  case recordType::RESET_MARKDOWN:
+  {
+    qint32 markdownIndex = reader.read<qint32>();
+    QRectF rect = reader.readRect();
+    QString text = reader.readString();
+    if (!pageExists || !reader.ok() || markdownIndex < 0 || markdownIndex > document.pages[pageNum].markdowns().size())
+    {
+      return false;
+    }
+    if (type == recordType::INSERT_MARKDOWN)
+    {
+      document.pages[pageNum].insertMarkdown(markdownIndex, text, rect);
+    }
+    else if (markdownIndex < document.pages[pageNum].markdowns().size())
+    {
+      document.pages[pageNum].resetMarkdown(markdownIndex, text, rect);
+    }
+    else
+    {
+      return false;
+    }
+    return true;
+  }
+  case recordType::SELECTION:
+  {
+    quint32 strokeCount = reader.read<quint32>();
+    QVector<Stroke> strokes;
+    for (quint32 i = 0; i < strokeCount && reader.ok(); ++i)
+    {
+      Stroke stroke;
+      if (!BinaryDocument::decodeStroke(reader, stroke))
+      {
+        return false;
+      }
+      strokes.append(stroke);
+    }
+    floating.selectionPageNum = pageNum;
+    floating.selection = strokes;
+    return reader.ok();
+  }
+  case recordType::MARKDOWN_SELECTION:
+  {
+    floating.markdownPageNum = pageNum;
+    floating.markdownRect = reader.readRect();
+    floating.markdown = reader.readString();
+    return reader.ok();
+  }
+  }
+  return false;
+}
+
+void Journal::remove(const QString &journalFileName)
+{
+  QLockFile lockFile(lockFileName(journalFileName));
+  lockFile.setStaleLockTime(0);
+  if (!lockFile.tryLock(0))
+  {
+    return;
+  }
+  QFile::remove(journalFileName);
+  QFile::remove(snapshotFileName(journalFileName, 0));
+  QFile::remove(snapshotFileName(journalFileName, 1));
+}
+}
@@ -0,0 +1,200 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include "bytestream.h"
+#include "document.h"
+
+#include <QByteArray>
+#include <QFile>
+#include <QFuture>
+#include <QLockFile>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <memory>
+
+namespace MrDoc
+{
+
+/**
+ * @brief The Journal class appends the edits of a document to a file next to it, so that unsaved work can be recovered after a crash.
+ * @details Every undo command records the changes it makes to the document (add a stroke, remove a page, ...) as a compact record, on
+ * undo as well as on redo. Records are collected in memory and appended together by @ref flush, which is called about once per
+ * @ref flushInterval, so a burst of edits costs a single fsync. The cost of an edit is proportional to its size, not to the size of the
+ * document.
+ *
+ * The records apply to a base, which is the file the document was opened from or saved to last. Documents without such a file (new
+ * documents, imported .xoj files, annotated pdfs) and recovered documents use a snapshot (a .mojb file) written when the journal is
+ * started. When the journal grows beyond @ref compactionSize, the document is written as new snapshot and the journal starts over
+ * (@ref compact). Snapshots are written by a worker thread, edits are recorded in the current journal meanwhile.
+ *
+ *     header   "MOJJ", format version (u32), base type (u8: document file, snapshot), 3 bytes padding, base size (u64),
+ *              base modification time (i64, ms since epoch), base file name (string), document file name (string, empty if untitled)
+ *     batches  size (u32), crc32 (u32), records
+ *
+ * Numbers and strings are stored as in .mojb files (see BinaryDocument). A batch which is cut off or has a wrong checksum ends the
+ * journal. The journal of document "name.moj" is ".name.moj.journal" in the same directory, untitled documents use
+ * @ref journalDirectory. A lock file marks a journal in use, the journals of crashed sessions are not locked.
+ */
+class Journal
+{
+public:
+  Journal();
+  ~Journal();
+  Journal(const Journal &) = delete;
+  Journal &operator=(const Journal &) = delete;
+
+  /**
+   * @brief start discards the current journal and starts a new one for @param document. If the document is unchanged since it was opened
+   * from or saved to a file, this file is the base, otherwise a snapshot of the document is written in the background (see @ref compact).
+   * @return false if the journal is locked by another window or could not be written. Edits are not recorded in this case.
+   */
+  bool start(Document *document);
+  /**
+   * @brief stop removes the journal and its snapshot, the document was saved or its changes were discarded
+   */
+  void stop();
+  bool isActive() const;
+
+  void insertStroke(int pageNum, int strokeNum, const Stroke &stroke); /**< strokeNum -1 appends */
+  void removeStroke(int pageNum, int strokeNum);                      /**< strokeNum -1 removes the last stroke */
+  void insertPage(int pageNum, Page &page);
+  void removePage(int pageNum);
+  void changePageSettings(int pageNum, Page &page);
+  void appendText(int pageNum, const QRectF &rect, const QFont &font, const QColor &color, const QString &text);
+  void setText(int pageNum, int textIndex, const QFont &font, const QColor &color, const QString &text);
+  void appendMarkdown(int pageNum, const QRectF &rect, const QString &text);
+  void insertMarkdown(int pageNum, int markdownIndex, const QString &text, const QRectF &rect);
+  void resetMarkdown(int pageNum, int markdownIndex, const QString &text, const QRectF &rect);
+  /**
+   * @brief setSelection records the strokes which are selected and therefore not part of a page. Only the last selection before a flush
+   * is written.
+   * @param strokes is empty if there is no selection
+   */
+  void setSelection(int pageNum, const QVector<Stroke> &strokes);
+  /**
+   * @brief setMarkdownSelection records the selected markdown document, see @ref setSelection
+   * @param text is empty if there is no markdown selection
+   */
+  void setMarkdownSelection(int pageNum, const QRectF &rect, const QString &text);
+
+  /**
+   * @brief flush appends the records since the last flush as one batch and syncs the file to disk. If a snapshot was written in the meantime,
+   * it becomes the base of the journal first.
+   * @return true if successful, otherwise false
+   */
+  bool flush();
+  bool needsCompaction() const;
+  /**
+   * @brief compact starts writing a copy of the document as snapshot on a worker thread. The current journal stays valid and gets the
+   * edits made meanwhile. When the snapshot is written, the next @ref flush makes it the base of a new journal, which starts with these edits.
+   * @return true if the snapshot is written or was being written already, otherwise false
+   */
+  bool compact();
+  /**
+   * @brief isCompacting
+   * @return true if a snapshot is written, it is taken over by the next @ref flush when it is done
+   */
+  bool isCompacting() const;
+
+  /**
+   * @brief journalFileName
+   * @param documentFileName is the full path of a .moj, .mojb or .mojt file
+   * @return the full path of its journal
+   */
+  static QString journalFileName(const QString &documentFileName);
+  static QString journalDirectory();
+  /**
+   * @brief untitledJournals
+   * @return the journals of untitled documents in @ref journalDirectory which are not in use
+   */
+  static QStringList untitledJournals();
+  /**
+   * @brief isRecoverable
+   * @return true if the journal exists and is not in use
+   */
+  static bool isRecoverable(const QString &journalFileName);
+  /**
+   * @brief recover loads the base of a journal into @param document and replays its records. Selected strokes and markdown are put back
+   * on their page.
+   * @return false if the base is missing, was changed after the journal was started, or a record does not fit the document
+   */
+  static bool recover(const QString &journalFileName, Document &document);
+  /**
+   * @brief remove deletes a journal which is not in use and its snapshots
+   */
+  static void remove(const QString &journalFileName);
+
+  static const char magic[4];
+  static constexpr quint32 formatVersion = 1;
+  static constexpr int flushInterval = 1000;                 /**< ms between an edit and the flush of its batch */
+  static constexpr qint64 compactionSize = 8 * 1024 * 1024; /**< journal size (bytes) which triggers a compaction */
+
+private:
+  enum class baseType : quint8
+  {
+    DOCUMENT_FILE = 0,
+    SNAPSHOT = 1
+  };
+  enum class recordType : quint8
+  {
+    INSERT_STROKE = 1,
+    REMOVE_STROKE,
+    INSERT_PAGE,
+    REMOVE_PAGE,
+    CHANGE_PAGE_SETTINGS,
+    APPEND_TEXT,
+    SET_TEXT,
+    APPEND_MARKDOWN,
+    INSERT_MARKDOWN,
+    RESET_MARKDOWN,
+    SELECTION,
+    MARKDOWN_SELECTION
+  };
+  /**
+   * @brief The Floating struct is the selected content, which is not part of a page while the journal is replayed
+   */
+  struct Floating
+  {
+    int selectionPageNum = 0;
+    QVector<Stroke> selection;
+    int markdownPageNum = 0;
+    QRectF markdownRect;
+    QString markdown;
+  };
+
+  /**
+   * @brief beginRecord appends the type of a record to the pending batch, its data is written with the returned writer
+   */
+  ByteWriter beginRecord(recordType type);
+  bool writeHeader(baseType type, const QString &baseFileName);
+  /**
+   * @brief finishCompaction makes the snapshot written by the worker the base of a new journal, see @ref compact
+   */
+  bool finishCompaction();
+  QString snapshotFileName(int slot) const;
+  static QString snapshotFileName(const QString &journalFileName, int slot);
+  static bool applyRecord(ByteReader &reader, Document &document, Floating &floating);
+
+  Document *m_document = nullptr;
+  QString m_fileName;
+  QFile m_file;
+  std::unique_ptr<QLockFile> m_lockFile;
+  QByteArray m_pending;     /**< records since the last flush */
+  qint64 m_journalSize = 0; /**< bytes of batches in the file */
+  int m_snapshotSlot = 1;   /**< snapshots alternate between two files, so that the previous one is valid until the header is replaced */
+  bool m_compacting = false;
+  QFuture<bool> m_compaction; /**< writes the snapshot to slot 1 - @ref m_snapshotSlot */
+  QByteArray m_sinceSnapshot; /**< batches flushed while the snapshot is written, the new journal starts with them */
+
+  int m_selectionPageNum = 0;
+  QVector<Stroke> m_selection;
+  bool m_selectionChanged = false;
+  int m_markdownPageNum = 0;
+  QRectF m_markdownRect;
+  QString m_markdown;
+  bool m_markdownChanged = false;
+};
+}
+
+#endif // JOURNAL_H
@@ -0,0 +1,19 @@
+# Links the static document core library. Include it in projects using the core, they have to depend on libmrdoc in MrWriter.pro.
+
+QT += xml
+QT += concurrent
+
+INCLUDEPATH += $$PWD/..
+INCLUDEPATH += /usr/include/poppler/qt5
+
+MRDOC_DIR = $$OUT_PWD/../libmrdoc
+win32:CONFIG(release, debug|release): MRDOC_DIR = $$MRDOC_DIR/release
+else:win32:CONFIG(debug, debug|release): MRDOC_DIR = $$MRDOC_DIR/debug
+
+LIBS += -L$$MRDOC_DIR -lmrdoc
+win32-msvc*: PRE_TARGETDEPS += $$MRDOC_DIR/mrdoc.lib
+else: PRE_TARGETDEPS += $$MRDOC_DIR/libmrdoc.a
+
+# dependencies of the core, a static library does not bring them along
+LIBS += -L/usr/lib -lpoppler-qt5
+LIBS += -lz
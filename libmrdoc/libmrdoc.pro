@@ -0,0 +1,53 @@
+#-------------------------------------------------
+#
+# The document core: documents, pages, strokes, file formats and export.
+# It does not use QtWidgets, so it can be linked by tools running without a display.
+# Projects using it include libmrdoc.pri.
+#
+#-------------------------------------------------
+
+QT       += core gui
+QT       += xml
+QT       += concurrent
+QT       -= widgets
+
+TARGET = mrdoc
+TEMPLATE = lib
+CONFIG += staticlib c++17
+
+INCLUDEPATH += $$PWD/..
+
+SOURCES += ../document.cpp \
+    ../binarydocument.cpp \
+    ../linedocument.cpp \
+    ../journal.cpp \
+    ../page.cpp \
+    ../selection.cpp \
+    ../stroke.cpp \
+    ../strokeindex.cpp \
+    ../displaylist.cpp \
+    ../markdownrenderer.cpp \
+    ../numberparser.cpp \
+    ../numberwriter.cpp \
+    ../qcompressor.cpp \
+    ../gzipdevice.cpp
+
+HEADERS += ../document.h \
+    ../binarydocument.h \
+    ../bytestream.h \
+    ../linedocument.h \
+    ../journal.h \
+    ../page.h \
+    ../selection.h \
+    ../stroke.h \
+    ../strokeindex.h \
+    ../displaylist.h \
+    ../markdownrenderer.h \
+    ../numberparser.h \
+    ../numberwriter.h \
+    ../qcompressor.h \
+    ../gzipdevice.h \
+    ../mrdoc.h \
+    ../version.h
+
+INCLUDEPATH  += /usr/include/poppler/qt5
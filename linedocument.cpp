@@ -0,0 +1,845 @@
+#include "linedocument.h"
+#include "mrdoc.h"
+#include "numberparser.h"
+#include "numberwriter.h"
+#include "version.h"
+
+#include <QFile>
+#include <QSaveFile>
+#include <QVarLengthArray>
+#include <QtConcurrent>
+#include <cstring>
+
+namespace MrDoc
+{
+
+namespace
+{
+/**
+ * @brief The Field struct is one ';' separated part of a line, with surrounding spaces removed
+ */
+struct Field
+{
+  const char *keyBegin = nullptr; /**< nullptr if the field is a plain value */
+  const char *keyEnd = nullptr;
+  const char *begin = nullptr; /**< the value */
+  const char *end = nullptr;
+};
+
+using Fields = QVarLengthArray<Field, 16>;
+
+/**
+ * @brief The PageLines struct is the range of lines from a "Page" line up to the next one, which is parsed by a worker thread
+ */
+struct PageLines
+{
+  const char *begin = nullptr;
+  const char *end = nullptr;
+  LineDocument::ParsedPage parsedPage;
+  bool ok = false;
+};
+
+const int writeBufferSize = 1024 * 1024; /**< bytes collected before they are written to the file */
+
+bool isBlank(char c)
+{
+  return c == ' ' || c == '\t' || c == '\r';
+}
+
+void trim(const char *&begin, const char *&end)
+{
+  while (begin != end && isBlank(*begin))
+  {
+    ++begin;
+  }
+  while (end != begin && isBlank(*(end - 1)))
+  {
+    --end;
+  }
+}
+
+/**
+ * @brief nextLine finds the line starting at @param it
+ * @param lineBegin and @param lineEnd are set to the line without surrounding spaces and without the line break
+ * @return the beginning of the next line
+ */
+const char *nextLine(const char *it, const char *end, const char *&lineBegin, const char *&lineEnd)
+{
+  const char *lineBreak = static_cast<const char *>(std::memchr(it, '\n', static_cast<size_t>(end - it)));
+  lineBegin = it;
+  lineEnd = lineBreak == nullptr ? end : lineBreak;
+  trim(lineBegin, lineEnd);
+  return lineBreak == nullptr ? end : lineBreak + 1;
+}
+
+bool isIgnored(const char *lineBegin, const char *lineEnd)
+{
+  return lineBegin == lineEnd || *lineBegin == '#';
+}
+
+bool equals(const char *begin, const char *end, const char *text)
+{
+  size_t length = std::strlen(text);
+  return static_cast<size_t>(end - begin) == length && std::memcmp(begin, text, length) == 0;
+}
+
+bool isKey(const Field &field, const char *key)
+{
+  return field.keyBegin != nullptr && equals(field.keyBegin, field.keyEnd, key);
+}
+
+bool isValue(const Field &field, const char *value)
+{
+  return equals(field.begin, field.end, value);
+}
+
+void appendField(const char *begin, const char *end, Fields &fields)
+{
+  trim(begin, end);
+  if (begin == end)
+  {
+    return;
+  }
+  Field field;
+  const char *it = begin;
+  while (it != end && ((*it >= 'a' && *it <= 'z') || (*it >= '0' && *it <= '9') || *it == '-'))
+  {
+    ++it;
+  }
+  if (it != begin && it != end && *it == ':')
+  {
+    field.keyBegin = begin;
+    field.keyEnd = it;
+    begin = it + 1;
+    trim(begin, end);
+  }
+  field.begin = begin;
+  field.end = end;
+  fields.append(field);
+}
+
+/**
+ * @brief splitFields splits a line at the ';' which are not part of a string
+ * @return false if a string is not terminated
+ */
+bool splitFields(const char *begin, const char *end, Fields &fields)
+{
+  fields.clear();
+  const char *fieldBegin = begin;
+  bool quoted = false;
+  for (const char *it = begin;; ++it)
+  {
+    if (it == end || (!quoted && *it == ';'))
+    {
+      appendField(fieldBegin, it, fields);
+      if (it == end)
+      {
+        break;
+      }
+      fieldBegin = it + 1;
+    }
+    else if (quoted && *it == '\\')
+    {
+      if (++it == end)
+      {
+        return false;
+      }
+    }
+    else if (*it == '"')
+    {
+      quoted = !quoted;
+    }
+  }
+  return !quoted && !fields.isEmpty();
+}
+
+bool isRecord(const char *lineBegin, const char *lineEnd, const char *name)
+{
+  const char *recordEnd = static_cast<const char *>(std::memchr(lineBegin, ';', static_cast<size_t>(lineEnd - lineBegin)));
+  if (recordEnd == nullptr)
+  {
+    recordEnd = lineEnd;
+  }
+  trim(lineBegin, recordEnd);
+  return equals(lineBegin, recordEnd, name);
+}
+
+bool parseNumber(const Field &field, double &value)
+{
+  // NumberParser reads anything as number, a single value is checked instead
+  bool ok = false;
+  value = QByteArray::fromRawData(field.begin, static_cast<int>(field.end - field.begin)).toDouble(&ok);
+  return ok;
+}
+
+bool parseInt(const Field &field, int &value)
+{
+  bool ok = false;
+  value = QByteArray::fromRawData(field.begin, static_cast<int>(field.end - field.begin)).toInt(&ok);
+  return ok;
+}
+
+bool parseColor(const Field &field, QRgb &color)
+{
+  int length = static_cast<int>(field.end - field.begin);
+  if ((length != 9 && length != 7) || *field.begin != '#')
+  {
+    return false;
+  }
+  bool ok = false;
+  uint value = QByteArray::fromRawData(field.begin + 1, length - 1).toUInt(&ok, 16);
+  if (!ok)
+  {
+    return false;
+  }
+  if (length == 7)
+  {
+    value = (value << 8) | 0xff;
+  }
+  color = qRgba((value >> 24) & 0xff, (value >> 16) & 0xff, (value >> 8) & 0xff, value & 0xff);
+  return true;
+}
+
+bool parseString(const Field &field, QString &string)
+{
+  if (field.end - field.begin < 2 || *field.begin != '"' || *(field.end - 1) != '"')
+  {
+    return false;
+  }
+  QByteArray utf8;
+  utf8.reserve(static_cast<int>(field.end - field.begin));
+  for (const char *it = field.begin + 1; it != field.end - 1; ++it)
+  {
+    if (*it != '\\')
+    {
+      utf8.append(*it);
+      continue;
+    }
+    ++it;
+    switch (*it)
+    {
+    case 'n':
+      utf8.append('\n');
+      break;
+    case 'r':
+      utf8.append('\r');
+      break;
+    case 't':
+      utf8.append('\t');
+      break;
+    default:
+      utf8.append(*it);
+      break;
+    }
+  }
+  string = QString::fromUtf8(utf8);
+  return true;
+}
+
+bool parsePattern(const Field &field, Stroke &stroke)
+{
+  if (isValue(field, "solid"))
+  {
+    stroke.setPattern(MrDoc::solidLinePattern);
+  }
+  else if (isValue(field, "dash"))
+  {
+    stroke.setPattern(MrDoc::dashLinePattern);
+  }
+  else if (isValue(field, "dashdot"))
+  {
+    stroke.setPattern(MrDoc::dashDotLinePattern);
+  }
+  else if (isValue(field, "dot"))
+  {
+    stroke.setPattern(MrDoc::dotLinePattern);
+  }
+  else
+  {
+    return false;
+  }
+  return true;
+}
+
+bool parseHeader(const Fields &fields, QString &pdfPath)
+{
+  for (const Field &field : fields)
+  {
+    if (isKey(field, "pdf") && !parseString(field, pdfPath))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool parsePage(const Fields &fields, LineDocument::ParsedPage &parsedPage)
+{
+  Page &page = parsedPage.page;
+  for (const Field &field : fields)
+  {
+    double number;
+    QRgb color;
+    if (isKey(field, "width"))
+    {
+      if (!parseNumber(field, number))
+      {
+        return false;
+      }
+      page.setWidth(number);
+    }
+    else if (isKey(field, "height"))
+    {
+      if (!parseNumber(field, number))
+      {
+        return false;
+      }
+      page.setHeight(number);
+    }
+    else if (isKey(field, "color"))
+    {
+      if (!parseColor(field, color))
+      {
+        return false;
+      }
+      page.setBackgroundColor(QColor::fromRgba(color));
+    }
+    else if (isKey(field, "style"))
+    {
+      if (isValue(field, "squared"))
+      {
+        page.setBackgroundType(Page::backgroundType::SQUARED);
+      }
+      else if (isValue(field, "ruled"))
+      {
+        page.setBackgroundType(Page::backgroundType::RULED);
+      }
+      else
+      {
+        page.setBackgroundType(Page::backgroundType::PLAIN);
+      }
+    }
+    else if (isKey(field, "pdf-page"))
+    {
+      if (!parseInt(field, parsedPage.pdfPageNum) || parsedPage.pdfPageNum < 0)
+      {
+        return false;
+      }
+    }
+  }
+  return page.width() > 0 && page.height() > 0;
+}
+
+bool parseStroke(const Fields &fields, Stroke &stroke)
+{
+  int valueCount = 0;
+  bool hasPoints = false;
+  bool hasPressures = false;
+  QPolygonF points;
+  QVector<qreal> pressures;
+  // the first field is the record name
+  for (int i = 1; i < fields.size(); ++i)
+  {
+    const Field &field = fields.at(i);
+    if (field.keyBegin == nullptr)
+    {
+      // color, pattern and width are given by their position
+      double width;
+      QRgb color;
+      switch (valueCount++)
+      {
+      case 0:
+        if (!parseColor(field, color))
+        {
+          return false;
+        }
+        stroke.setColor(QColor::fromRgba(color));
+        break;
+      case 1:
+        if (!parsePattern(field, stroke))
+        {
+          return false;
+        }
+        break;
+      case 2:
+        if (!parseNumber(field, width))
+        {
+          return false;
+        }
+        stroke.setPenWidth(width);
+        break;
+      default:
+        break;
+      }
+    }
+    else if (isKey(field, "points"))
+    {
+      const char *it = field.begin;
+      double x;
+      double y;
+      points.reserve(static_cast<int>(field.end - field.begin) / 8);
+      while (NumberParser::next(it, field.end, x))
+      {
+        if (!NumberParser::next(it, field.end, y))
+        {
+          return false;
+        }
+        points.append(QPointF(x, y));
+      }
+      hasPoints = true;
+    }
+    else if (isKey(field, "pressure"))
+    {
+      const char *it = field.begin;
+      double pressure;
+      pressures.reserve(points.size());
+      while (NumberParser::next(it, field.end, pressure))
+      {
+        pressures.append(pressure);
+      }
+      hasPressures = true;
+    }
+    else if (isKey(field, "tool"))
+    {
+      stroke.setHighlighter(isValue(field, "highlighter"));
+    }
+  }
+  // strokes without pressures are drawn with full pressure, see Stroke::setPoints
+  if (valueCount < 3 || !hasPoints || (hasPressures && pressures.size() != points.size()))
+  {
+    return false;
+  }
+  stroke.setPoints(points, pressures);
+  return true;
+}
+
+/**
+ * @brief parseRect sets the part of @param rect given by @param field, if it is one of x, y, width and height
+ * @return false if the field is part of the rect, but not a number
+ */
+bool parseRect(const Field &field, QRectF &rect)
+{
+  bool isX = isKey(field, "x");
+  bool isY = isKey(field, "y");
+  bool isWidth = isKey(field, "width");
+  bool isHeight = isKey(field, "height");
+  if (!isX && !isY && !isWidth && !isHeight)
+  {
+    return true;
+  }
+  double number;
+  if (!parseNumber(field, number))
+  {
+    return false;
+  }
+  if (isX)
+  {
+    rect.moveLeft(number);
+  }
+  else if (isY)
+  {
+    rect.moveTop(number);
+  }
+  else if (isWidth)
+  {
+    rect.setWidth(number);
+  }
+  else
+  {
+    rect.setHeight(number);
+  }
+  return true;
+}
+
+bool parseText(const Fields &fields, Page &page)
+{
+  QRectF rect;
+  QFont font;
+  QColor color(0, 0, 0);
+  QString text;
+  for (const Field &field : fields)
+  {
+    QString fontString;
+    QRgb rgba;
+    if (!parseRect(field, rect))
+    {
+      return false;
+    }
+    if (isKey(field, "font"))
+    {
+      if (!parseString(field, fontString) || !font.fromString(fontString))
+      {
+        return false;
+      }
+    }
+    else if (isKey(field, "color"))
+    {
+      if (!parseColor(field, rgba))
+      {
+        return false;
+      }
+      color = QColor::fromRgba(rgba);
+    }
+    else if (isKey(field, "text") && !parseString(field, text))
+    {
+      return false;
+    }
+  }
+  page.appendText(rect, font, color, text);
+  return true;
+}
+
+bool parseMarkdown(const Fields &fields, LineDocument::ParsedPage &parsedPage)
+{
+  QRectF rect;
+  QString text;
+  for (const Field &field : fields)
+  {
+    if (!parseRect(field, rect) || (isKey(field, "text") && !parseString(field, text)))
+    {
+      return false;
+    }
+  }
+  // markdown is compiled by libmarkdown, which is not thread safe, so it is appended on the main thread
+  parsedPage.markdown.append(qMakePair(rect, text));
+  return true;
+}
+
+/**
+ * @brief parsePageLines parses a "Page" line and the items following it
+ */
+void parsePageLines(PageLines &pageLines)
+{
+  Fields fields;
+  const char *lineBegin;
+  const char *lineEnd;
+  const char *it = nextLine(pageLines.begin, pageLines.end, lineBegin, lineEnd);
+  if (!splitFields(lineBegin, lineEnd, fields) || !parsePage(fields, pageLines.parsedPage))
+  {
+    return;
+  }
+
+  Page &page = pageLines.parsedPage.page;
+  while (it != pageLines.end)
+  {
+    it = nextLine(it, pageLines.end, lineBegin, lineEnd);
+    if (isIgnored(lineBegin, lineEnd))
+    {
+      continue;
+    }
+    if (!splitFields(lineBegin, lineEnd, fields))
+    {
+      return;
+    }
+    const Field &record = fields.first();
+    if (isValue(record, "Stroke"))
+    {
+      Stroke stroke;
+      if (!parseStroke(fields, stroke))
+      {
+        return;
+      }
+      page.appendStroke(stroke);
+    }
+    else if (isValue(record, "Text"))
+    {
+      if (!parseText(fields, page))
+      {
+        return;
+      }
+    }
+    else if (isValue(record, "Markdown"))
+    {
+      if (!parseMarkdown(fields, pageLines.parsedPage))
+      {
+        return;
+      }
+    }
+  }
+  page.clearDirtyRect();
+  pageLines.ok = true;
+}
+
+void appendNumber(QByteArray &line, NumberWriter &numbers, double value)
+{
+  numbers.clear();
+  numbers.append(value);
+  line.append(numbers.data());
+}
+
+void appendColor(QByteArray &line, QRgb color)
+{
+  static const char hexDigits[] = "0123456789abcdef";
+  const int components[] = {qRed(color), qGreen(color), qBlue(color), qAlpha(color)};
+  line.append('#');
+  for (int component : components)
+  {
+    line.append(hexDigits[component >> 4]);
+    line.append(hexDigits[component & 0xf]);
+  }
+}
+
+void appendString(QByteArray &line, const QString &string)
+{
+  QByteArray utf8 = string.toUtf8();
+  line.append('"');
+  for (char c : utf8)
+  {
+    switch (c)
+    {
+    case '\\':
+      line.append("\\\\");
+      break;
+    case '"':
+      line.append("\\\"");
+      break;
+    case '\n':
+      line.append("\\n");
+      break;
+    case '\r':
+      line.append("\\r");
+      break;
+    case '\t':
+      line.append("\\t");
+      break;
+    default:
+      line.append(c);
+      break;
+    }
+  }
+  line.append('"');
+}
+
+void appendRect(QByteArray &line, NumberWriter &numbers, const QRectF &rect)
+{
+  line.append("; x:");
+  appendNumber(line, numbers, rect.x());
+  line.append("; y:");
+  appendNumber(line, numbers, rect.y());
+  line.append("; width:");
+  appendNumber(line, numbers, rect.width());
+  line.append("; height:");
+  appendNumber(line, numbers, rect.height());
+}
+
+const char *patternName(const Stroke &stroke)
+{
+  if (stroke.pattern() == MrDoc::dashLinePattern)
+  {
+    return "dash";
+  }
+  else if (stroke.pattern() == MrDoc::dashDotLinePattern)
+  {
+    return "dashdot";
+  }
+  else if (stroke.pattern() == MrDoc::dotLinePattern)
+  {
+    return "dot";
+  }
+  return "solid";
+}
+
+void appendStroke(QByteArray &buffer, NumberWriter &numbers, const Stroke &stroke)
+{
+  buffer.append("Stroke; ");
+  appendColor(buffer, stroke.rgba());
+  buffer.append("; ");
+  buffer.append(patternName(stroke));
+  buffer.append("; ");
+  appendNumber(buffer, numbers, stroke.penWidth());
+  if (stroke.isHighlighter())
+  {
+    buffer.append("; tool:highlighter");
+  }
+  numbers.clear();
+  for (int k = 0; k < stroke.size(); ++k)
+  {
+    // points are stored as floats, so they are written as floats
+    QPointF point = stroke.point(k);
+    numbers.append(static_cast<float>(point.x()));
+    numbers.append(static_cast<float>(point.y()));
+  }
+  buffer.append("; points: ");
+  buffer.append(numbers.data());
+  numbers.clear();
+  for (int k = 0; k < stroke.size(); ++k)
+  {
+    numbers.append(stroke.pressure(k));
+  }
+  buffer.append("; pressure: ");
+  buffer.append(numbers.data());
+  buffer.append('\n');
+}
+}
+
+bool LineDocument::read(const QString &fileName, QVector<ParsedPage> &pages, QString &pdfPath)
+{
+  QFile file(fileName);
+  if (!file.open(QIODevice::ReadOnly))
+  {
+    return false;
+  }
+  QByteArray data = file.readAll();
+  file.close();
+
+  // only the "Page" lines are looked at here, everything else is parsed by the workers
+  QVector<PageLines> pageLinesList;
+  bool headerRead = false;
+  const char *end = data.constData() + data.size();
+  const char *it = data.constData();
+  while (it != end)
+  {
+    const char *lineStart = it;
+    const char *lineBegin;
+    const char *lineEnd;
+    it = nextLine(it, end, lineBegin, lineEnd);
+    if (isIgnored(lineBegin, lineEnd))
+    {
+      continue;
+    }
+    if (!headerRead)
+    {
+      Fields fields;
+      if (!isRecord(lineBegin, lineEnd, "MrDoc") || !splitFields(lineBegin, lineEnd, fields) || !parseHeader(fields, pdfPath))
+      {
+        return false;
+      }
+      headerRead = true;
+    }
+    else if (isRecord(lineBegin, lineEnd, "Page"))
+    {
+      if (!pageLinesList.isEmpty())
+      {
+        pageLinesList.last().end = lineStart;
+      }
+      pageLinesList.append(PageLines());
+      pageLinesList.last().begin = lineStart;
+      pageLinesList.last().end = end;
+    }
+    else if (pageLinesList.isEmpty())
+    {
+      // items in front of the first page do not belong to a page
+      return false;
+    }
+  }
+  if (pageLinesList.isEmpty())
+  {
+    return false;
+  }
+
+  QtConcurrent::blockingMap(pageLinesList, parsePageLines);
+
+  pages.clear();
+  pages.reserve(pageLinesList.size());
+  for (auto &pageLines : pageLinesList)
+  {
+    if (!pageLines.ok)
+    {
+      return false;
+    }
+    pages.append(std::move(pageLines.parsedPage));
+  }
+  return true;
+}
+
+bool LineDocument::write(const QString &fileName, QVector<Page> &pages, const QString &pdfPath)
+{
+  QSaveFile file(fileName);
+  if (!file.open(QIODevice::WriteOnly))
+  {
+    return false;
+  }
+
+  NumberWriter numbers;
+  QByteArray buffer;
+  buffer.reserve(writeBufferSize + 64 * 1024);
+
+  buffer.append("MrDoc; doc-version:");
+  buffer.append(QByteArray::number(formatVersion));
+  buffer.append("; app-version:");
+  buffer.append(QByteArray::number(MAJOR_VERSION)).append('.').append(QByteArray::number(MINOR_VERSION)).append('.');
+  buffer.append(QByteArray::number(PATCH_VERSION));
+  if (!pdfPath.isEmpty())
+  {
+    buffer.append("; pdf:");
+    appendString(buffer, pdfPath);
+  }
+  buffer.append('\n');
+
+  for (auto &page : pages)
+  {
+    // stubs are loaded for writing and given back afterwards, so saving a large document does not load all of it
+    bool wasLoaded = page.isLoaded();
+    // the content of a page which failed to load is unknown, writing the page empty would lose it
+    page.strokes();
+    if (page.loadFailed())
+    {
+      file.cancelWriting();
+      return false;
+    }
+
+    buffer.append("Page; width:");
+    appendNumber(buffer, numbers, page.width());
+    buffer.append("; height:");
+    appendNumber(buffer, numbers, page.height());
+    buffer.append("; style:");
+    switch (page.getBackgroundType())
+    {
+    case Page::backgroundType::PLAIN:
+      buffer.append("plain");
+      break;
+    case Page::backgroundType::SQUARED:
+      buffer.append("squared");
+      break;
+    case Page::backgroundType::RULED:
+      buffer.append("ruled");
+      break;
+    }
+    buffer.append("; color:");
+    appendColor(buffer, page.backgroundColor().rgba());
+    if (page.isPdf())
+    {
+      buffer.append("; pdf-page:");
+      buffer.append(QByteArray::number(page.pageNum() + 1));
+    }
+    buffer.append('\n');
+
+    for (const auto &text : page.texts())
+    {
+      buffer.append("Text");
+      appendRect(buffer, numbers, std::get<0>(text));
+      buffer.append("; font:");
+      appendString(buffer, std::get<1>(text).toString());
+      buffer.append("; color:");
+      appendColor(buffer, std::get<2>(text).rgba());
+      buffer.append("; text:");
+      appendString(buffer, std::get<3>(text));
+      buffer.append('\n');
+    }
+    for (const auto &markdown : page.markdowns())
+    {
+      buffer.append("Markdown");
+      appendRect(buffer, numbers, std::get<0>(markdown));
+      buffer.append("; text:");
+      appendString(buffer, std::get<1>(markdown));
+      buffer.append('\n');
+    }
+    for (const auto &stroke : page.strokes())
+    {
+      appendStroke(buffer, numbers, stroke);
+      if (buffer.size() > writeBufferSize)
+      {
+        file.write(buffer);
+        buffer.resize(0);
+      }
+    }
+
+    if (!wasLoaded)
+    {
+      page.unload();
+    }
+  }
+  file.write(buffer);
+  return file.commit();
+}
+}
@@ -0,0 +1,68 @@
+#ifndef LINEDOCUMENT_H
+#define LINEDOCUMENT_H
+
+#include "page.h"
+
+#include <QPair>
+#include <QRectF>
+#include <QString>
+#include <QVector>
+
+namespace MrDoc
+{
+
+/**
+ * @brief The LineDocument class reads and writes .mojt files, the line based text counterpart of .moj files (see
+ * documentation/line-based-file-format.adoc).
+ * @details Every line is one record: the header, a page or an item on the page below the last page line. Changing a stroke therefore
+ * changes a single line, which keeps the diffs of documents under version control small. The file is neither compressed nor indented.
+ *
+ *     MrDoc; doc-version:1; app-version:0.0.3; pdf:"/path/to/file.pdf"
+ *     Page; width:595; height:842; style:plain; color:#ffffffff; pdf-page:1
+ *     Stroke; #000000ff; solid; 1.41; points: 10.1 12.2 15.7 16.2; pressure: 0.9 0.85
+ *     Text; x:100; y:200; width:300; height:20; font:"Sans Serif,12,-1,5,50,0,0,0,0,0"; color:#000000ff; text:"This is the text"
+ *     Markdown; x:100; y:300; width:300; height:200; text:"# Title\nText"
+ *
+ * A record is a list of fields separated by ';'. A field is either a value or "key:value". Strings are quoted, with \\, \", \n, \r and \t
+ * escaped, so a string never spans lines. Colors are #rrggbbaa. Unknown records and keys are skipped, empty lines and lines starting with
+ * '#' are ignored.
+ *
+ * Since a line can be parsed without the lines before it (apart from knowing its page), the pages are parsed in parallel.
+ */
+class LineDocument
+{
+public:
+  /**
+   * @brief The ParsedPage struct is a page as it is read from the file. Markdown has to be appended on the main thread, see
+   * Page::appendMarkdown.
+   */
+  struct ParsedPage
+  {
+    Page page;
+    int pdfPageNum = 0; /**< page in the pdf (first page is 1), 0 if there is no pdf background */
+    QVector<QPair<QRectF, QString>> markdown;
+  };
+
+  /**
+   * @brief read reads a .mojt file
+   * @param fileName is the full path
+   * @param pages gets one entry per page, in document order
+   * @param pdfPath is the path of the pdf the pages are drawn on, empty if there is none
+   * @return false if the file could not be read, is not a .mojt file or one of its lines is invalid
+   */
+  static bool read(const QString &fileName, QVector<ParsedPage> &pages, QString &pdfPath);
+  /**
+   * @brief write writes @param pages as .mojt file. The file is replaced atomically. Pages which are not loaded are loaded for writing and
+   * unloaded again afterwards.
+   * @param fileName is the full path
+   * @param pages
+   * @param pdfPath is the path of the pdf the pages are drawn on
+   * @return true if successful, otherwise false
+   */
+  static bool write(const QString &fileName, QVector<Page> &pages, const QString &pdfPath);
+
+  static constexpr int formatVersion = 1;
+};
+}
+
+#endif // LINEDOCUMENT_H
@@ -1,18 +1,36 @@
 //#include <QApplication>
 #include <QCommandLineParser>
 #include <QDebug>
+#include <QGuiApplication>
 #include <QMessageBox>
+#include "headless.h"
+#include "htmlmarkdownrenderer.h"
 #include "mainwindow.h"
 #include "tabletapplication.h"
 
 int main(int argc, char *argv[])
 {
+  MrDoc::MarkdownRenderer::setInstance(std::make_shared<HtmlMarkdownRenderer>());
+
+  if (Headless::isRequested(argc, argv))
+  {
+    // no window is opened, so no display is needed either
+    qputenv("QT_QPA_PLATFORM", "offscreen");
+    QGuiApplication a(argc, argv);
+    QCoreApplication::setOrganizationName("unruhschuh");
+    QCoreApplication::setOrganizationDomain("unruhschuh.com");
+    QCoreApplication::setApplicationName("MrWriter");
+    QCoreApplication::setApplicationVersion("0.1");
+    return Headless::run(a.arguments());
+  }
+
   TabletApplication a(argc, argv);
 
   QCommandLineParser parser;
 
   parser.addHelpOption();
   parser.addVersionOption();
+  parser.addOption(QCommandLineOption("headless", QCoreApplication::translate("main", "Convert, export or render files without opening a window, see --headless --help.")));
   parser.addPositionalArgument("file", QCoreApplication::translate("main", "File to open."));
 
   parser.process(a);
@@ -36,6 +54,14 @@ int main(int argc, char *argv[])
     {
       success = w->loadMOJ(fileName);
     }
+    else if (fileNameSplitted.last().compare(QString("mojb"), Qt::CaseInsensitive) == 0)
+    {
+      success = w->loadMOJB(fileName);
+    }
+    else if (fileNameSplitted.last().compare(QString("mojt"), Qt::CaseInsensitive) == 0)
+    {
+      success = w->loadMOJT(fileName);
+    }
     else if (fileNameSplitted.last().compare(QString("pdf"), Qt::CaseInsensitive) == 0){
         success = w->loadPDF(fileName);
     }
@@ -48,6 +74,7 @@ int main(int argc, char *argv[])
   }
   w->show();
   w->updateGUI();
+  w->recoverUntitledJournals();
 
   return a.exec();
 }
@@ -6,6 +6,7 @@
 #include <QToolBar>
 #include <QToolButton>
 #include <QMessageBox>
+#include <QPushButton>
 #include <QStatusBar>
 #include <QInputDialog>
 #include <QSysInfo>
@@ -13,11 +14,18 @@
 #include <QPageSize>
 #include <QSettings>
 #include <QDateTime>
+#include <QFileInfo>
+#include <QLocale>
 //#include <QWebEngineView>
 #include <QDesktopServices>
 #include <QBoxLayout>
+#include <QtConcurrent>
+#include <QEventLoop>
+#include <QProgressDialog>
 
+#include <atomic>
 #include <iostream>
+#include <memory>
 
 #include "widget.h"
 #include "mrdoc.h"
@@ -77,6 +85,14 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent)
   statusBar()->addPermanentWidget(sep2);
   statusBar()->addPermanentWidget(&pageStatus);
 
+  saveProgress.setRange(0, 0);
+  saveProgress.setMaximumWidth(100);
+  saveProgress.setTextVisible(false);
+  statusBar()->addPermanentWidget(&saveProgress);
+  saveProgress.hide();
+  connect(&saveWatcher, &QFutureWatcher<bool>::finished, this, &MainWindow::saveFinished);
+  connect(&checkWatcher, &QFutureWatcher<QVector<int>>::finished, this, &MainWindow::pagesChecked);
+
   createActions();
   createMenus();
   createToolBars();
@@ -835,7 +851,7 @@ void MainWindow::openFile()
     dir = mainWidget->currentDocument.path();
   }
 
-  QString fileName = QFileDialog::getOpenFileName(this, tr("Open MOJ"), dir, tr("MrWriter Files (*.moj)"));
+  QString fileName = QFileDialog::getOpenFileName(this, tr("Open MOJ"), dir, tr("MrWriter Files (*.moj *.mojb *.mojt)"));
 
   if (fileName.isNull())
   {
@@ -844,12 +860,14 @@ void MainWindow::openFile()
 
   MrDoc::Document openDocument;
 
-  if (openDocument.loadMOJ(fileName))
+  if (openDocument.loadBySuffix(fileName))
   {
+    recoverJournal(openDocument);
     mainWidget->letGoSelection();
     mainWidget->setDocument(openDocument);
     setTitle();
     modified();
+    checkPages();
   }
   else
   {
@@ -868,11 +886,169 @@ QString MainWindow::askForFileName()
   dir.append("-Note-");
   dir.append(dateTime.toString("HH-mm"));
   dir.append(".moj");
-  QString fileName = QFileDialog::getSaveFileName(this, tr("Save MOJ"), dir, tr("MrWriter Files (*.moj)"));
+  QString fileName = QFileDialog::getSaveFileName(this, tr("Save MOJ"), dir, tr("MrWriter Files (*.moj);;MrWriter Binary Files (*.mojb);;MrWriter Text Files (*.mojt)"));
 
   return fileName;
 }
 
+bool MainWindow::saveDocument(const QString &fileName)
+{
+  // saves are written one after another, so that an older snapshot never replaces a newer one
+  waitForSave();
+
+  // the worker gets its own copy of the pages, because loading a stub for writing changes the page (see Page::load). Strokes, texts and
+  // markdown are implicitly shared, so the copy is cheap.
+  auto snapshot = std::make_shared<MrDoc::Document>(mainWidget->currentDocument);
+  snapshot->pages.detach();
+
+  // edits made while the snapshot is written mark the document as changed again
+  mainWidget->currentDocument.setDocumentChanged(false);
+  modified();
+
+  saving = true;
+  savingFileName = fileName;
+  saveProgress.show();
+  statusBar()->showMessage(tr("Saving %1 ...").arg(QFileInfo(fileName).fileName()));
+  saveWatcher.setFuture(QtConcurrent::run([snapshot, fileName]() { return snapshot->saveBySuffix(fileName); }));
+  return true;
+}
+
+bool MainWindow::waitForSave()
+{
+  if (saving)
+  {
+    saveWatcher.waitForFinished();
+    saveFinished();
+  }
+  return lastSaveSucceeded;
+}
+
+void MainWindow::saveFinished()
+{
+  // called by waitForSave or by the watcher, whichever comes first
+  if (!saving)
+  {
+    return;
+  }
+  saving = false;
+  saveProgress.hide();
+  lastSaveSucceeded = saveWatcher.result();
+  if (lastSaveSucceeded)
+  {
+    mainWidget->currentDocument.setFileName(savingFileName);
+    // the saved file is the base of the new journal, unless the document was changed while saving
+    mainWidget->startJournal();
+    statusBar()->showMessage(tr("Saved %1").arg(QFileInfo(savingFileName).fileName()), 3000);
+  }
+  else
+  {
+    mainWidget->currentDocument.setDocumentChanged(true);
+    statusBar()->clearMessage();
+    QMessageBox errMsgBox;
+    errMsgBox.setText(tr("Couldn't save %1").arg(savingFileName));
+    errMsgBox.exec();
+  }
+  setTitle();
+  modified();
+}
+
+void MainWindow::checkPages()
+{
+  // opening isn't slowed down by the check, the pages are decoded once more on the worker
+  auto snapshot = std::make_shared<MrDoc::Document>(mainWidget->currentDocument);
+  snapshot->pages.detach();
+  checkedFileName = mainWidget->currentDocument.fileName();
+  checkWatcher.setFuture(QtConcurrent::run([snapshot]() { return snapshot->damagedPages(); }));
+}
+
+void MainWindow::pagesChecked()
+{
+  QVector<int> pageNums = checkWatcher.result();
+  if (pageNums.isEmpty())
+  {
+    return;
+  }
+  QStringList pageList;
+  for (int pageNum : pageNums)
+  {
+    pageList.append(QString::number(pageNum + 1));
+  }
+  QMessageBox::warning(this, tr("Damaged pages"),
+                       tr("Pages %1 of %2 could not be read and are shown empty.\n"
+                          "Their original content is kept when the document is saved as .mojb, if it was opened from a .mojb file. "
+                          "Otherwise saving fails rather than overwriting them.")
+                           .arg(pageList.join(", "), QFileInfo(checkedFileName).fileName()));
+}
+
+void MainWindow::recoverJournal(MrDoc::Document &document)
+{
+  if (document.fileName().isEmpty())
+  {
+    return;
+  }
+  QString journalFileName = MrDoc::Journal::journalFileName(document.fileName());
+  if (!MrDoc::Journal::isRecoverable(journalFileName))
+  {
+    return;
+  }
+
+  QMessageBox::StandardButton ret;
+  ret = QMessageBox::question(this, tr("Recover"), tr("%1 has unsaved changes from a previous session.\n"
+                                                      "Do you want to recover them?").arg(QFileInfo(document.fileName()).fileName()),
+                              QMessageBox::Yes | QMessageBox::No);
+  if (ret != QMessageBox::Yes)
+  {
+    return; // the journal is replaced when the document is shown
+  }
+
+  MrDoc::Document recoveredDocument;
+  if (MrDoc::Journal::recover(journalFileName, recoveredDocument))
+  {
+    document = recoveredDocument;
+  }
+  else
+  {
+    QMessageBox errMsgBox;
+    errMsgBox.setText("Couldn't recover the changes");
+    errMsgBox.exec();
+  }
+}
+
+void MainWindow::recoverUntitledJournals()
+{
+  for (const QString &journalFileName : MrDoc::Journal::untitledJournals())
+  {
+    QMessageBox::StandardButton ret;
+    ret = QMessageBox::question(this, tr("Recover"), tr("An untitled document of %1 was not saved.\n"
+                                                        "Do you want to recover it?")
+                                                         .arg(QLocale::system().toString(QFileInfo(journalFileName).lastModified(), QLocale::ShortFormat)),
+                                QMessageBox::Yes | QMessageBox::No);
+    MrDoc::Document recoveredDocument;
+    if (ret == QMessageBox::Yes && !MrDoc::Journal::recover(journalFileName, recoveredDocument))
+    {
+      QMessageBox errMsgBox;
+      errMsgBox.setText("Couldn't recover the document");
+      errMsgBox.exec();
+    }
+    else if (ret == QMessageBox::Yes)
+    {
+      MainWindow *window = this;
+      if (!mainWidget->currentDocument.docName().isEmpty() || mainWidget->currentDocument.documentChanged())
+      {
+        window = new MainWindow();
+        static_cast<TabletApplication *>(qApp)->mainWindows.append(window);
+        window->show();
+      }
+      window->mainWidget->letGoSelection();
+      // starts a journal with a snapshot of the recovered document, before the old one is removed
+      window->mainWidget->setDocument(recoveredDocument);
+      window->setTitle();
+      window->modified();
+    }
+    MrDoc::Journal::remove(journalFileName);
+  }
+}
+
 bool MainWindow::saveFileAs()
 {
   QString fileName = askForFileName();
@@ -882,7 +1058,7 @@ bool MainWindow::saveFileAs()
     return false;
   }
 
-  if (mainWidget->currentDocument.saveMOJ(fileName))
+  if (saveDocument(fileName))
   {
     modified();
     setTitle();
@@ -907,7 +1083,8 @@ bool MainWindow::saveFile()
     dir = mainWidget->currentDocument.path();
     dir.append('/');
     dir.append(mainWidget->currentDocument.docName());
-    dir.append(".moj");
+    dir.append('.');
+    dir.append(mainWidget->currentDocument.fileSuffix());
     fileName = dir;
   }
 
@@ -916,7 +1093,7 @@ bool MainWindow::saveFile()
     return false;
   }
 
-  if (mainWidget->currentDocument.saveMOJ(fileName))
+  if (saveDocument(fileName))
   {
     modified();
     setTitle();
@@ -949,7 +1126,61 @@ void MainWindow::exportPDF()
     return;
   }
 
-  mainWidget->currentDocument.exportPDF(fileName);
+  if (mainWidget->currentDocument.pdfPath().isEmpty())
+  {
+    exportPDFAsImage(fileName);
+    return;
+  }
+
+  if (!mainWidget->currentDocument.exportPDF(fileName))
+  {
+    QMessageBox::StandardButton answer =
+        QMessageBox::warning(this, tr("Export PDF"), tr("The PDF could not be exported. Pages which are not part of the annotated PDF are "
+                                                        "combined with it using pdftk, check if you have pdftk installed and the "
+                                                        "permission to start it.\n"
+                                                        "Do you want to export the PDF as image instead?"),
+                             QMessageBox::Yes | QMessageBox::No);
+    if (answer == QMessageBox::Yes)
+    {
+      exportPDFAsImage(fileName);
+    }
+  }
+}
+
+void MainWindow::exportPDFAsImage(const QString &fileName)
+{
+  // like saveDocument, the worker gets its own copy of the pages
+  auto snapshot = std::make_shared<MrDoc::Document>(mainWidget->currentDocument);
+  snapshot->pages.detach();
+
+  QProgressDialog progressDialog(tr("Exporting %1 ...").arg(QFileInfo(fileName).fileName()), tr("Cancel"), 0, snapshot->pages.size(), this);
+  progressDialog.setWindowModality(Qt::WindowModal);
+  progressDialog.setMinimumDuration(500);
+  auto cancelled = std::make_shared<std::atomic<bool>>(false);
+  connect(&progressDialog, &QProgressDialog::canceled, [cancelled]() { *cancelled = true; });
+
+  // the progress is reported from the worker, so the dialog is updated with queued calls
+  QProgressDialog *dialog = &progressDialog;
+  auto progress = [dialog, cancelled](int pagesWritten) {
+    QMetaObject::invokeMethod(dialog, "setValue", Qt::QueuedConnection, Q_ARG(int, pagesWritten));
+    return !*cancelled;
+  };
+
+  QEventLoop loop;
+  QFutureWatcher<bool> watcher;
+  connect(&watcher, &QFutureWatcher<bool>::finished, &loop, &QEventLoop::quit);
+  watcher.setFuture(QtConcurrent::run([snapshot, fileName, progress]() { return snapshot->exportPDFAsImage(fileName, progress); }));
+  loop.exec();
+  progressDialog.reset();
+
+  if (*cancelled)
+  {
+    statusBar()->showMessage(tr("Export cancelled"), 3000);
+  }
+  else if (!watcher.result())
+  {
+    QMessageBox::warning(this, tr("Export PDF"), tr("Couldn't export %1").arg(fileName));
+  }
 }
 
 void MainWindow::importXOJ()
@@ -985,6 +1216,7 @@ void MainWindow::importXOJ()
     mainWidget->setDocument(openDocument);
     setTitle();
     modified();
+    checkPages();
   }
   else
   {
@@ -1316,6 +1548,7 @@ void MainWindow::closeEvent(QCloseEvent *event)
   if (maybeSave())
   {
     event->accept();
+    mainWidget->journal.stop();
     TabletApplication *myApp = static_cast<TabletApplication *>(qApp);
     myApp->mainWindows.removeOne(this);
     saveMyGeometry();
@@ -1344,6 +1577,8 @@ void MainWindow::keyReleaseEvent(QKeyEvent *event){
 
 bool MainWindow::maybeSave()
 {
+  // a failed save leaves the document changed
+  waitForSave();
   if (mainWidget->currentDocument.documentChanged())
   {
     QMessageBox::StandardButton ret;
@@ -1351,7 +1586,7 @@ bool MainWindow::maybeSave()
                                                            "Do you want to save your changes?"),
                                QMessageBox::Save | QMessageBox::Discard | QMessageBox::Cancel);
     if (ret == QMessageBox::Save)
-      return saveFile();
+      return saveFile() && waitForSave();
     else if (ret == QMessageBox::Cancel)
       return false;
   }
@@ -1462,9 +1697,9 @@ void MainWindow::cloneWindow()
   MainWindow *window = new MainWindow();
   window->mainWidget->currentDocument = mainWidget->currentDocument;
   window->mainWidget->currentDocument.setDocName("");
-  window->mainWidget->pageBufferPtr = mainWidget->pageBufferPtr;
   window->mainWidget->currentSelection = mainWidget->currentSelection;
   window->mainWidget->setCurrentState(mainWidget->getCurrentState());
+  window->mainWidget->startJournal();
   //  window->mainWidget->zoomTo(mainWidget->zoom);
   window->mainWidget->zoom = mainWidget->zoom;
 
@@ -1475,6 +1710,7 @@ void MainWindow::cloneWindow()
   window->scrollArea->verticalScrollBar()->setValue(scrollArea->verticalScrollBar()->value());
   window->scrollArea->horizontalScrollBar()->setValue(scrollArea->horizontalScrollBar()->value());
 
+  window->mainWidget->updateAllPageBuffers();
   window->mainWidget->update();
   window->mainWidget->updateGUI();
 
@@ -1498,14 +1734,49 @@ void MainWindow::verticalView(){
 
 bool MainWindow::loadXOJ(QString fileName)
 {
-  return mainWidget->currentDocument.loadXOJ(fileName);
-  updateGUI();
+  if (!mainWidget->currentDocument.loadXOJ(fileName))
+  {
+    return false;
+  }
+  mainWidget->startJournal();
+  checkPages();
+  return true;
 }
 
 bool MainWindow::loadMOJ(QString fileName)
 {
-  return mainWidget->currentDocument.loadMOJ(fileName);
-  updateGUI();
+  if (!mainWidget->currentDocument.loadMOJ(fileName))
+  {
+    return false;
+  }
+  recoverJournal(mainWidget->currentDocument);
+  mainWidget->startJournal();
+  checkPages();
+  return true;
+}
+
+bool MainWindow::loadMOJB(QString fileName)
+{
+  if (!mainWidget->currentDocument.loadMOJB(fileName))
+  {
+    return false;
+  }
+  recoverJournal(mainWidget->currentDocument);
+  mainWidget->startJournal();
+  checkPages();
+  return true;
+}
+
+bool MainWindow::loadMOJT(QString fileName)
+{
+  if (!mainWidget->currentDocument.loadMOJT(fileName))
+  {
+    return false;
+  }
+  recoverJournal(mainWidget->currentDocument);
+  mainWidget->startJournal();
+  checkPages();
+  return true;
 }
 
 bool MainWindow::loadPDF(QString fileName){
@@ -6,6 +6,8 @@
 #include <QToolButton>
 #include <QScrollArea>
 #include <QFontDialog>
+#include <QFutureWatcher>
+#include <QProgressBar>
 
 #include "widget.h"
 #include "searchbar.h"
@@ -27,8 +29,15 @@ public:
   void setTitle();
   bool loadXOJ(QString fileName);
   bool loadMOJ(QString fileName);
+  bool loadMOJB(QString fileName);
+  bool loadMOJT(QString fileName);
   bool loadPDF(QString fileName);
 
+  /**
+   * @brief recoverUntitledJournals offers to recover the untitled documents of crashed sessions, see MrDoc::Journal
+   */
+  void recoverUntitledJournals();
+
 protected:
   void closeEvent(QCloseEvent *event) Q_DECL_OVERRIDE;
   void showEvent(QShowEvent *event) Q_DECL_OVERRIDE;
@@ -52,6 +61,15 @@ private slots:
   void importXOJ();
   bool exportXOJ();
 
+  /**
+   * @brief saveFinished is called when the worker started by @ref saveDocument is done. It reports errors and starts a new journal.
+   */
+  void saveFinished();
+  /**
+   * @brief pagesChecked is called when the worker started by @ref checkPages is done. It warns about pages which can't be loaded.
+   */
+  void pagesChecked();
+
   void exit();
 
   void zoomIn();
@@ -122,10 +140,46 @@ private:
   void createMenus();
 
   QString askForFileName();
+  /**
+   * @brief saveDocument starts saving a snapshot of the current document on a worker thread, as .mojb, .mojt or .moj depending on the
+   * suffix of @param fileName. Editing can continue while the snapshot is written, the result is reported by @ref saveFinished.
+   * @return true if saving was started
+   */
+  bool saveDocument(const QString &fileName);
+  /**
+   * @brief waitForSave blocks until a running save is finished
+   * @return false if the last save failed
+   */
+  bool waitForSave();
+  /**
+   * @brief exportPDFAsImage exports a snapshot of the current document with Document::exportPDFAsImage on a worker thread. A modal progress
+   * dialog shows the pages written so far and cancels the export. Errors are reported to the user.
+   * @param fileName is the full path
+   */
+  void exportPDFAsImage(const QString &fileName);
+  /**
+   * @brief recoverJournal offers to replace @param document, which was just opened, with its recovered version if its journal was left
+   * behind by a crashed session
+   */
+  void recoverJournal(MrDoc::Document &document);
+  /**
+   * @brief checkPages looks for pages of the current document which can't be loaded (see Document::damagedPages) on a worker thread, right
+   * after a document was opened. The result is reported by @ref pagesChecked.
+   */
+  void checkPages();
 
   QLabel pageStatus;
   QLabel penWidthStatus;
   QLabel colorStatus;
+  QProgressBar saveProgress; /**< busy indicator in the status bar while a save is running */
+
+  QFutureWatcher<bool> saveWatcher;
+  QString savingFileName;
+  bool saving = false;
+  bool lastSaveSucceeded = true;
+
+  QFutureWatcher<QVector<int>> checkWatcher;
+  QString checkedFileName;
 
   SearchBar* searchBar;
 
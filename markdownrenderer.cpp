@@ -0,0 +1,55 @@
+#include "markdownrenderer.h"
+
+#include <QFont>
+#include <QFontMetricsF>
+
+#include <algorithm>
+#include <atomic>
+
+namespace MrDoc
+{
+
+namespace
+{
+std::shared_ptr<const MarkdownRenderer> installedRenderer = std::make_shared<PlainMarkdownRenderer>(); /**< accessed with std::atomic_load and std::atomic_store */
+}
+
+std::shared_ptr<const MarkdownRenderer> MarkdownRenderer::instance()
+{
+  return std::atomic_load(&installedRenderer);
+}
+
+void MarkdownRenderer::setInstance(std::shared_ptr<const MarkdownRenderer> renderer)
+{
+  if (!renderer)
+  {
+    renderer = std::make_shared<PlainMarkdownRenderer>();
+  }
+  std::atomic_store(&installedRenderer, renderer);
+}
+
+QSizeF PlainMarkdownRenderer::size(const QString &markdown, const QSizeF &pageSize) const
+{
+  QFontMetricsF metrics{QFont()};
+  if (pageSize.isEmpty())
+  {
+    return metrics.boundingRect(QRectF(), 0, markdown).size();
+  }
+  QSizeF textSize = metrics.boundingRect(QRectF(QPointF(0, 0), pageSize), Qt::TextWordWrap, markdown).size();
+  return QSizeF(pageSize.width(), std::max(textSize.height(), pageSize.height()));
+}
+
+void PlainMarkdownRenderer::paint(QPainter &painter, const QRectF &rect, const QString &markdown) const
+{
+  painter.save();
+  painter.setFont(QFont());
+  painter.setPen(Qt::black);
+  painter.drawText(rect, Qt::TextWordWrap, markdown);
+  painter.restore();
+}
+
+QString PlainMarkdownRenderer::plainText(const QString &markdown) const
+{
+  return markdown;
+}
+}
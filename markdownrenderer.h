@@ -0,0 +1,66 @@
+#ifndef MARKDOWNRENDERER_H
+#define MARKDOWNRENDERER_H
+
+#include <QPainter>
+#include <QRectF>
+#include <QSizeF>
+#include <QString>
+
+#include <memory>
+
+namespace MrDoc
+{
+
+/**
+ * @brief The MarkdownRenderer class lays out and paints the markdown documents of pages.
+ * @details Pages only store the markdown source. How it is compiled and typeset is up to the renderer installed with @ref setInstance, so
+ * the document core does not depend on a markdown library. Without an installed renderer, the source is painted as plain text (see
+ * PlainMarkdownRenderer). Renderers are called from several threads at once, e.g. when pages are rasterized for export.
+ */
+class MarkdownRenderer
+{
+public:
+  virtual ~MarkdownRenderer() = default;
+
+  /**
+   * @brief size
+   * @param markdown
+   * @param pageSize is the size the document is laid out in. If it is empty, lines are not wrapped.
+   * @return the size of the laid out document (zoom factor 1)
+   */
+  virtual QSizeF size(const QString &markdown, const QSizeF &pageSize = QSizeF()) const = 0;
+  /**
+   * @brief paint paints @param markdown laid out in @param rect (zoom factor 1, the painter has to be scaled)
+   */
+  virtual void paint(QPainter &painter, const QRectF &rect, const QString &markdown) const = 0;
+  /**
+   * @brief plainText
+   * @return the text of @param markdown without markup, as used for pdf annotations
+   */
+  virtual QString plainText(const QString &markdown) const = 0;
+
+  /**
+   * @brief instance
+   * @return the renderer used by all pages. It is safe to call from several threads.
+   */
+  static std::shared_ptr<const MarkdownRenderer> instance();
+  /**
+   * @brief setInstance replaces the renderer used by all pages. It is meant to be called once at startup, before any page is painted.
+   * @param renderer
+   */
+  static void setInstance(std::shared_ptr<const MarkdownRenderer> renderer);
+};
+
+/**
+ * @brief The PlainMarkdownRenderer class is the default renderer. It paints the markdown source as it is, wrapped at word boundaries.
+ */
+class PlainMarkdownRenderer : public MarkdownRenderer
+{
+public:
+  QSizeF size(const QString &markdown, const QSizeF &pageSize = QSizeF()) const override;
+  void paint(QPainter &painter, const QRectF &rect, const QString &markdown) const override;
+  QString plainText(const QString &markdown) const override;
+};
+}
+
+#endif // MARKDOWNRENDERER_H
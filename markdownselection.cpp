@@ -67,13 +67,8 @@ void MarkdownSelection::paint(QPainter &painter, qreal zoom){
 
     painter.setRenderHint(QPainter::Antialiasing, true);
 
-    QTextDocument td;
-    td.setHtml(Page::compileMarkdown(std::get<1>(m_markdown)));
     painter.scale(zoom,zoom);
-    painter.translate(std::get<0>(m_markdown).x(), std::get<0>(m_markdown).y());
-    td.setPageSize(QSizeF(std::get<0>(m_markdown).width(), std::get<0>(m_markdown).height()));
-    td.drawContents(&painter);
-    painter.translate(-std::get<0>(m_markdown).x(), -std::get<0>(m_markdown).y());
+    MarkdownRenderer::instance()->paint(painter, std::get<0>(m_markdown), std::get<1>(m_markdown));
 
     QPen pen;
     pen.setStyle(Qt::SolidLine);
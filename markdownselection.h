@@ -3,7 +3,6 @@
 #include<QPainter>
 #include<QRect>
 #include<QString>
-#include<QTextDocument>
 
 #include<tuple>
 
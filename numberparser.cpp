@@ -0,0 +1,213 @@
+#include "numberparser.h"
+
+#include <QByteArray>
+#include <QString>
+
+namespace MrDoc
+{
+
+namespace
+{
+const double powersOfTen[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                              1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+const int maxExactPowerOfTen = 22;
+const int maxExactDigits = 15;
+
+ushort code(QChar c)
+{
+  return c.unicode();
+}
+
+ushort code(char c)
+{
+  return static_cast<uchar>(c);
+}
+
+bool isSpaceCode(ushort u)
+{
+  return u == ' ' || u == '\n' || u == '\t' || u == '\r';
+}
+
+double toDouble(const QChar *begin, const QChar *end)
+{
+  return QString::fromRawData(begin, static_cast<int>(end - begin)).toDouble();
+}
+
+double toDouble(const char *begin, const char *end)
+{
+  return QByteArray::fromRawData(begin, static_cast<int>(end - begin)).toDouble();
+}
+
+template <typename Char> bool parseNext(const Char *&it, const Char *end, double &value)
+{
+  while (it != end && isSpaceCode(code(*it)))
+  {
+    ++it;
+  }
+  if (it == end)
+  {
+    return false;
+  }
+
+  const Char *tokenBegin = it;
+  while (it != end && !isSpaceCode(code(*it)))
+  {
+    ++it;
+  }
+  const Char *tokenEnd = it;
+
+  // fast path: [-+]digits[.digits][(e|E)[-+]digits]
+  const Char *p = tokenBegin;
+  bool negative = false;
+  if (p != tokenEnd && (code(*p) == '-' || code(*p) == '+'))
+  {
+    negative = code(*p) == '-';
+    ++p;
+  }
+  quint64 mantissa = 0;
+  int digits = 0;
+  int exponent = 0;
+  bool anyDigit = false;
+  while (p != tokenEnd && code(*p) >= '0' && code(*p) <= '9')
+  {
+    if (mantissa != 0 || code(*p) != '0')
+    {
+      mantissa = mantissa * 10 + (code(*p) - '0');
+      ++digits;
+    }
+    anyDigit = true;
+    ++p;
+  }
+  if (p != tokenEnd && code(*p) == '.')
+  {
+    ++p;
+    while (p != tokenEnd && code(*p) >= '0' && code(*p) <= '9')
+    {
+      if (mantissa != 0 || code(*p) != '0')
+      {
+        mantissa = mantissa * 10 + (code(*p) - '0');
+        ++digits;
+      }
+      --exponent;
+      anyDigit = true;
+      ++p;
+    }
+  }
+  if (anyDigit && p != tokenEnd && (code(*p) == 'e' || code(*p) == 'E'))
+  {
+    ++p;
+    bool negativeExponent = false;
+    if (p != tokenEnd && (code(*p) == '-' || code(*p) == '+'))
+    {
+      negativeExponent = code(*p) == '-';
+      ++p;
+    }
+    int explicitExponent = 0;
+    bool anyExponentDigit = false;
+    while (p != tokenEnd && code(*p) >= '0' && code(*p) <= '9' && explicitExponent < 10000)
+    {
+      explicitExponent = explicitExponent * 10 + (code(*p) - '0');
+      anyExponentDigit = true;
+      ++p;
+    }
+    if (!anyExponentDigit)
+    {
+      anyDigit = false;
+    }
+    exponent += negativeExponent ? -explicitExponent : explicitExponent;
+  }
+
+  if (anyDigit && p == tokenEnd && digits <= maxExactDigits && exponent >= -maxExactPowerOfTen && exponent <= maxExactPowerOfTen)
+  {
+    // both the mantissa and the power of ten are exact doubles, so a single operation gives the correctly rounded result
+    double result = static_cast<double>(mantissa);
+    result = exponent < 0 ? result / powersOfTen[-exponent] : result * powersOfTen[exponent];
+    value = negative ? -result : result;
+    return true;
+  }
+
+  value = toDouble(tokenBegin, tokenEnd);
+  return true;
+}
+}
+
+bool NumberParser::isSpace(QChar c)
+{
+  return isSpaceCode(c.unicode());
+}
+
+bool NumberParser::next(const QChar *&it, const QChar *end, double &value)
+{
+  return parseNext(it, end, value);
+}
+
+bool NumberParser::next(const char *&it, const char *end, double &value)
+{
+  return parseNext(it, end, value);
+}
+
+int NumberParser::countNumbers(const QChar *it, const QChar *end)
+{
+  int count = 0;
+  bool inToken = false;
+  for (; it != end; ++it)
+  {
+    bool space = isSpace(*it);
+    if (!space && !inToken)
+    {
+      ++count;
+    }
+    inToken = !space;
+  }
+  return count;
+}
+
+int NumberParser::countNumbers(const QStringRef &text)
+{
+  return countNumbers(text.unicode(), text.unicode() + text.size());
+}
+
+int NumberParser::countNumbers(const QString &text)
+{
+  return countNumbers(text.unicode(), text.unicode() + text.size());
+}
+
+void NumberParser::parseNumbers(const QChar *it, const QChar *end, QVector<qreal> &values)
+{
+  double value;
+  while (next(it, end, value))
+  {
+    values.append(value);
+  }
+}
+
+void NumberParser::parseNumbers(const QStringRef &text, QVector<qreal> &values)
+{
+  parseNumbers(text.unicode(), text.unicode() + text.size(), values);
+}
+
+void NumberParser::parseNumbers(const QString &text, QVector<qreal> &values)
+{
+  parseNumbers(text.unicode(), text.unicode() + text.size(), values);
+}
+
+void NumberParser::parsePoints(const QChar *it, const QChar *end, QPolygonF &points)
+{
+  double x;
+  double y;
+  while (next(it, end, x) && next(it, end, y))
+  {
+    points.append(QPointF(x, y));
+  }
+}
+
+void NumberParser::parsePoints(const QStringRef &text, QPolygonF &points)
+{
+  parsePoints(text.unicode(), text.unicode() + text.size(), points);
+}
+
+void NumberParser::parsePoints(const QString &text, QPolygonF &points)
+{
+  parsePoints(text.unicode(), text.unicode() + text.size(), points);
+}
+}
@@ -0,0 +1,61 @@
+#ifndef NUMBERPARSER_H
+#define NUMBERPARSER_H
+
+#include <QChar>
+#include <QPolygonF>
+#include <QStringRef>
+#include <QVector>
+
+namespace MrDoc
+{
+
+/**
+ * @brief The NumberParser class reads whitespace separated numbers (like the points and pressures in .moj and .xoj files) directly from the
+ * characters of a string, without splitting it into a list of strings first.
+ * @details Plain decimal numbers with up to 15 significant digits are converted exactly with a single multiplication or division by a power
+ * of ten. Everything else (more digits, large exponents, garbage) falls back to QString::toDouble, so the results are the same as before.
+ */
+class NumberParser
+{
+public:
+  /**
+   * @brief next parses the next number and advances @param it behind it
+   * @param it
+   * @param end
+   * @param value
+   * @return false if there are no more numbers
+   */
+  static bool next(const QChar *&it, const QChar *end, double &value);
+  /**
+   * @brief next parses the next number of ASCII or UTF-8 text, see above
+   */
+  static bool next(const char *&it, const char *end, double &value);
+
+  /**
+   * @brief parseNumbers appends all numbers in @param text to @param values
+   */
+  static void parseNumbers(const QStringRef &text, QVector<qreal> &values);
+  static void parseNumbers(const QString &text, QVector<qreal> &values);
+
+  /**
+   * @brief parsePoints appends pairs of numbers in @param text as points to @param points. A trailing single number is ignored.
+   */
+  static void parsePoints(const QStringRef &text, QPolygonF &points);
+  static void parsePoints(const QString &text, QPolygonF &points);
+
+  /**
+   * @brief countNumbers
+   * @return the number of whitespace separated tokens in @param text. It is used to reserve capacity before parsing.
+   */
+  static int countNumbers(const QStringRef &text);
+  static int countNumbers(const QString &text);
+
+private:
+  static bool isSpace(QChar c);
+  static int countNumbers(const QChar *it, const QChar *end);
+  static void parseNumbers(const QChar *it, const QChar *end, QVector<qreal> &values);
+  static void parsePoints(const QChar *it, const QChar *end, QPolygonF &points);
+};
+}
+
+#endif // NUMBERPARSER_H
@@ -0,0 +1,62 @@
+#include "numberwriter.h"
+
+#include <charconv>
+
+namespace MrDoc
+{
+
+NumberWriter::NumberWriter()
+{
+  m_buffer.reserve(4096);
+}
+
+void NumberWriter::clear()
+{
+  // resize keeps the reserved capacity, clear would free it
+  m_buffer.resize(0);
+}
+
+void NumberWriter::appendSeparator()
+{
+  if (!m_buffer.isEmpty())
+  {
+    m_buffer.append(' ');
+  }
+}
+
+void NumberWriter::append(double value)
+{
+  appendSeparator();
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+  char digits[32];
+  std::to_chars_result result = std::to_chars(digits, digits + sizeof(digits), value);
+  m_buffer.append(digits, static_cast<int>(result.ptr - digits));
+#else
+  m_buffer.append(QByteArray::number(value, 'g', 6));
+#endif
+}
+
+void NumberWriter::append(float value)
+{
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+  // the shortest representation of the float, not of the double it converts to
+  appendSeparator();
+  char digits[32];
+  std::to_chars_result result = std::to_chars(digits, digits + sizeof(digits), value);
+  m_buffer.append(digits, static_cast<int>(result.ptr - digits));
+#else
+  append(static_cast<double>(value));
+#endif
+}
+
+QString NumberWriter::toString() const
+{
+  // numbers are plain ASCII
+  return QString::fromLatin1(m_buffer.constData(), m_buffer.size());
+}
+
+const QByteArray &NumberWriter::data() const
+{
+  return m_buffer;
+}
+}
@@ -0,0 +1,49 @@
+#ifndef NUMBERWRITER_H
+#define NUMBERWRITER_H
+
+#include <QByteArray>
+#include <QString>
+
+namespace MrDoc
+{
+
+/**
+ * @brief The NumberWriter class formats whitespace separated numbers (like the points and pressures in .moj and .xoj files) into a reusable
+ * buffer, so that writing a stroke does not create a string per number.
+ * @details Numbers are written with the shortest representation that reads back to the same value (std::to_chars). If the standard library
+ * does not provide floating point std::to_chars, they are written with 6 significant digits like QString::number.
+ */
+class NumberWriter
+{
+public:
+  NumberWriter();
+
+  /**
+   * @brief clear empties the buffer, but keeps its capacity
+   */
+  void clear();
+  /**
+   * @brief append appends @param value, separated by a space from the previous number
+   */
+  void append(double value);
+  void append(float value);
+
+  /**
+   * @brief toString
+   * @return the numbers written since the last clear()
+   */
+  QString toString() const;
+  /**
+   * @brief data
+   * @return the numbers as ASCII, for writers which produce bytes instead of strings
+   */
+  const QByteArray &data() const;
+
+private:
+  void appendSeparator();
+
+  QByteArray m_buffer;
+};
+}
+
+#endif // NUMBERWRITER_H
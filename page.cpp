@@ -1,10 +1,25 @@
 #include "page.h"
 #include "mrdoc.h"
 #include <QDebug>
+#include <QMutex>
+#include <QMutexLocker>
 
 namespace MrDoc
 {
 
+std::shared_ptr<PdfDocument> PdfDocument::load(const QString &fileName)
+{
+  auto pdfDocument = std::make_shared<PdfDocument>();
+  pdfDocument->document.reset(Poppler::Document::load(fileName));
+  if (pdfDocument->document == nullptr || pdfDocument->document->isLocked())
+  {
+    return nullptr;
+  }
+  pdfDocument->document->setRenderHint(Poppler::Document::Antialiasing);
+  pdfDocument->document->setRenderHint(Poppler::Document::TextAntialiasing);
+  return pdfDocument;
+}
+
 Page::Page(/*const Page &page*/)
 {
     // set up standard page (Letter, white background)
@@ -43,53 +58,89 @@ void Page::setWidth(qreal width)
 }
 
 void Page::paint(QPainter &painter, qreal zoom, QRectF region)
+{
+    paintBackground(painter, zoom, region);
+    paintInk(painter, zoom, region);
+}
+
+bool Page::hasBackground() const
+{
+    return m_pdfPointer != nullptr || m_backgroundType != backgroundType::PLAIN;
+}
+
+Page::Background Page::background() const
+{
+  return Background{m_width, m_height, m_backgroundColor, m_backgroundType, m_pdfPointer, m_pdfDocument};
+}
+
+void Page::paintBackground(QPainter &painter, qreal zoom, QRectF region) const
+{
+  background().paint(painter, zoom, region);
+}
+
+void Page::Background::paint(QPainter &painter, qreal zoom, QRectF region) const
 {
     painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
-    if(m_backgroundType != backgroundType::PLAIN){
+    if(type != backgroundType::PLAIN){
         QPen pen;
         pen.setColor(QColor(100,100,150));
         painter.setPen(pen);
-        if(m_backgroundType == backgroundType::SQUARED){
-            for(int i = 0; i < 42*m_width/595.0; ++i){
-                painter.drawLine(QPointF(595.0/42*(i+1)*zoom,0), QPointF(595.0/42*(i+1)*zoom, m_height*zoom));
+        if(type == backgroundType::SQUARED){
+            for(int i = 0; i < 42*width/595.0; ++i){
+                painter.drawLine(QPointF(595.0/42*(i+1)*zoom,0), QPointF(595.0/42*(i+1)*zoom, height*zoom));
             }
-            for(int i = 0; i < 59.4*m_height/842.0; ++i){
-                painter.drawLine(QPointF(0, 842.0/59.4*(i+1)*zoom), QPointF(m_width*zoom, 842.0/59.4*(i+1)*zoom));
+            for(int i = 0; i < 59.4*height/842.0; ++i){
+                painter.drawLine(QPointF(0, 842.0/59.4*(i+1)*zoom), QPointF(width*zoom, 842.0/59.4*(i+1)*zoom));
             }
         }
-        else if(m_backgroundType == backgroundType::RULED){
-            for(int i = 0; i < 29.7*m_height/842.0; ++i){
-                painter.drawLine(QPointF(0, 842.0/29.7*(i+1)*zoom), QPointF(m_width*zoom, 842.0/29.7*(i+1)*zoom));
+        else if(type == backgroundType::RULED){
+            for(int i = 0; i < 29.7*height/842.0; ++i){
+                painter.drawLine(QPointF(0, 842.0/29.7*(i+1)*zoom), QPointF(width*zoom, 842.0/29.7*(i+1)*zoom));
             }
         }
         pen.setColor(QColor(255,255,255));
         painter.setPen(pen);
     }
-    if(m_pdfPointer != nullptr){
+    if(pdfPage != nullptr){
         //double eZoom = zoom*(exp(-zoom)+2) > 10 ? 10 : zoom*(exp(-zoom)+2);
-        //auto img = m_pdfPointer->renderToImage(72.0*eZoom, 72.0*eZoom, 0,0,int(m_width*eZoom), int(m_height*eZoom));
-        //QImage image = m_pdfPointer->renderToImage(72.0*eZoom, 72.0*eZoom, 0,0,int(m_width*eZoom), int(m_height*eZoom));
-        //painter.drawImage(0,0, image.scaled(m_width*zoom, m_height*zoom, Qt::KeepAspectRatio, Qt::SmoothTransformation));
-
-        QImage image = m_pdfPointer->renderToImage(72.0*zoom, 72.0*zoom, 0,0, int(m_width*zoom), int(m_height*zoom));
-        painter.drawImage(0,0, image);
+        //auto img = pdfPage->renderToImage(72.0*eZoom, 72.0*eZoom, 0,0,int(width*eZoom), int(height*eZoom));
+        //QImage image = pdfPage->renderToImage(72.0*eZoom, 72.0*eZoom, 0,0,int(width*eZoom), int(height*eZoom));
+        //painter.drawImage(0,0, image.scaled(width*zoom, height*zoom, Qt::KeepAspectRatio, Qt::SmoothTransformation));
+
+        // render only the requested region, so a tile doesn't cost a whole page
+        QRect pixelRect(0, 0, int(width*zoom), int(height*zoom));
+        if(!region.isNull()){
+            pixelRect = pixelRect.intersected(QRectF(region.topLeft()*zoom, region.bottomRight()*zoom).toAlignedRect());
+        }
+        if(!pixelRect.isEmpty()){
+            // pages are painted by the render service and by parallel exports at the same time
+            QMutexLocker locker(&pdfDocument->mutex);
+            QImage image = pdfPage->renderToImage(72.0*zoom, 72.0*zoom, pixelRect.x(), pixelRect.y(), pixelRect.width(), pixelRect.height());
+            painter.drawImage(pixelRect.topLeft(), image);
+        }
 
         /*if(region.isNull()){
             qDebug() << "region is null";
-            QImage image = m_pdfPointer->renderToImage(72.0*eZoom, 72.0*eZoom, 0,0,int(m_width*eZoom), int(m_height*eZoom));
-            painter.drawImage(0,0, image.scaled(m_width*zoom, m_height*zoom, Qt::KeepAspectRatio, Qt::SmoothTransformation));
+            QImage image = pdfPage->renderToImage(72.0*eZoom, 72.0*eZoom, 0,0,int(width*eZoom), int(height*eZoom));
+            painter.drawImage(0,0, image.scaled(width*zoom, height*zoom, Qt::KeepAspectRatio, Qt::SmoothTransformation));
         }
         else{
             qDebug() << "region";
-            //QImage image = m_pdfPointer->renderToImage(72.0*eZoom, 72.0*eZoom, region.x(), region.y(), region.width(), region.height());
-            QImage image = m_pdfPointer->renderToImage(72.0*eZoom, 72.0*eZoom, 0,0,int(m_width*eZoom), int(m_height*eZoom));
+            //QImage image = pdfPage->renderToImage(72.0*eZoom, 72.0*eZoom, region.x(), region.y(), region.width(), region.height());
+            QImage image = pdfPage->renderToImage(72.0*eZoom, 72.0*eZoom, 0,0,int(width*eZoom), int(height*eZoom));
             QRectF source(0.0, 0.0, 200, 800);
             painter.drawImage(region, image.scaled(region.width()*zoom, region.height()*zoom, Qt::KeepAspectRatio, Qt::SmoothTransformation), source);
         }*/
     }
     /*if(!m_pdf.isNull()){
-        painter.drawImage(0,0, m_pdf.scaled(m_width*zoom, m_height*zoom, Qt::KeepAspectRatio, Qt::SmoothTransformation));
+        painter.drawImage(0,0, m_pdf.scaled(width*zoom, height*zoom, Qt::KeepAspectRatio, Qt::SmoothTransformation));
     }*/
+}
+
+void Page::paintInk(QPainter &painter, qreal zoom, QRectF region)
+{
+    ensureLoaded();
+    painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
     if(rectIsPoint){
         for(int i = 0; i < m_texts.length(); ++i){
             QFont font = std::get<1>(m_texts[i]);
@@ -113,14 +164,17 @@ void Page::paint(QPainter &painter, qreal zoom, QRectF region)
             painter.drawText(std::get<0>(t).x()*zoom, std::get<0>(t).y()*zoom, m_width, m_height, Qt::TextWordWrap, std::get<3>(t));
         }
     }
-    for (Stroke &stroke : m_strokes)
+    if (!m_displayList.isValid())
     {
-        if (region.isNull() || stroke.boundingRect().intersects(region))
-        {
-            //stroke.paint(painter, QRect(stroke.boundingRect().x()*zoom, stroke.boundingRect().y()*zoom, stroke.boundingRect().width()*zoom, stroke.boundingRect().height()*zoom), zoom);
-            stroke.paint(painter, zoom);
-            //stroke.paint(painter, QRect(0,0, m_width*zoom, m_height*zoom), zoom);
-        }
+        m_displayList.build(m_strokes);
+    }
+    if (region.isNull())
+    {
+        m_displayList.paint(painter, zoom, m_strokes);
+    }
+    else
+    {
+        m_displayList.paint(painter, zoom, m_strokes, m_strokeIndex.query(region));
     }
     painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
 
@@ -130,18 +184,14 @@ void Page::paint(QPainter &painter, qreal zoom, QRectF region)
     }
 
     painter.scale(zoom, zoom);
+    std::shared_ptr<const MarkdownRenderer> markdownRenderer = MarkdownRenderer::instance();
     for(auto t : m_markdownDocs){
-        qDebug() << std::get<0>(t);
-        QTextDocument td;
-        td.setHtml(compileMarkdown(std::get<1>(t)));
-        painter.translate(std::get<0>(t).x(), std::get<0>(t).y());
-        td.setPageSize(QSizeF(std::get<0>(t).width(), std::get<0>(t).height()));
-        td.drawContents(&painter);
-        painter.translate(-std::get<0>(t).x(), -std::get<0>(t).y());
+        markdownRenderer->paint(painter, std::get<0>(t), std::get<1>(t));
     }
 }
 
 void Page::paintForPdfExport(QPainter &painter, qreal zoom){
+    ensureLoaded();
 
     if(rectIsPoint){
         for(int i = 0; i < m_texts.length(); ++i){
@@ -166,21 +216,51 @@ void Page::paintForPdfExport(QPainter &painter, qreal zoom){
     }
 
 
-    for (Stroke &stroke : m_strokes)
-    {
-        stroke.paint(painter, zoom);
-    }
+    paintStrokesForExport(painter, zoom);
 
     painter.scale(zoom, zoom);
+    std::shared_ptr<const MarkdownRenderer> markdownRenderer = MarkdownRenderer::instance();
     for(auto t : m_markdownDocs){
-        qDebug() << std::get<0>(t);
-        QTextDocument td;
-        td.setHtml(compileMarkdown(std::get<1>(t)));
-        painter.translate(std::get<0>(t).x(), std::get<0>(t).y());
-        td.setPageSize(QSizeF(std::get<0>(t).width(), std::get<0>(t).height()));
-        td.drawContents(&painter);
-        painter.translate(-std::get<0>(t).x(), -std::get<0>(t).y());
+        markdownRenderer->paint(painter, std::get<0>(t), std::get<1>(t));
+    }
+}
+
+void Page::paintStrokesForExport(QPainter &painter, qreal zoom) const
+{
+  QTransform oldTransform = painter.transform();
+  painter.scale(zoom, zoom);
+  painter.setPen(Qt::NoPen);
+
+  // consecutive pen strokes of the same colour are filled as one path, so the pdf gets one fill operator and one colour for all of them.
+  // Overlapping translucent strokes (e.g. highlighters) have to be blended twice, so they are filled one by one.
+  QPainterPath batch;
+  QColor batchColor;
+  auto fillBatch = [&]() {
+    if (!batch.isEmpty())
+    {
+      painter.setBrush(batchColor);
+      painter.drawPath(batch);
+      batch = QPainterPath();
+    }
+  };
+  for (const Stroke &stroke : m_strokes)
+  {
+    bool translucent = stroke.isHighlighter() || stroke.color().alpha() != 255;
+    if (translucent || stroke.color() != batchColor)
+    {
+      fillBatch();
+    }
+    batch.setFillRule(Qt::WindingFill);
+    batch.addPath(stroke.exportOutline());
+    batchColor = stroke.color();
+    if (translucent)
+    {
+      fillBatch();
     }
+  }
+  fillBatch();
+
+  painter.setTransform(oldTransform);
 }
 
 void Page::setBackgroundColor(QColor backgroundColor)
@@ -213,13 +293,16 @@ void Page::clearDirtyRect()
 
 bool Page::changePenWidth(int strokeNum, qreal penWidth)
 {
+  prepareChange();
   if (strokeNum < 0 || strokeNum >= m_strokes.size() || m_strokes.isEmpty())
   {
     return false;
   }
   else
   {
-    m_strokes[strokeNum].penWidth = penWidth;
+    m_strokes[strokeNum].setPenWidth(penWidth);
+    m_strokeIndex.update(strokeNum, m_strokes[strokeNum].boundingRect());
+    m_displayList.update(m_strokes, strokeNum);
     m_dirtyRect = m_dirtyRect.united(m_strokes[strokeNum].boundingRect());
     return true;
   }
@@ -227,13 +310,15 @@ bool Page::changePenWidth(int strokeNum, qreal penWidth)
 
 bool Page::changeStrokeColor(int strokeNum, QColor color)
 {
+  prepareChange();
   if (strokeNum < 0 || strokeNum >= m_strokes.size() || m_strokes.isEmpty())
   {
     return false;
   }
   else
   {
-    m_strokes[strokeNum].color = color;
+    m_strokes[strokeNum].setColor(color);
+    m_displayList.update(m_strokes, strokeNum);
     m_dirtyRect = m_dirtyRect.united(m_strokes[strokeNum].boundingRect());
     return true;
   }
@@ -241,19 +326,22 @@ bool Page::changeStrokeColor(int strokeNum, QColor color)
 
 bool Page::changeStrokePattern(int strokeNum, QVector<qreal> pattern)
 {
+  prepareChange();
   if (strokeNum < 0 || strokeNum >= m_strokes.size() || m_strokes.isEmpty())
   {
     return false;
   }
   else
   {
-    m_strokes[strokeNum].pattern = pattern;
+    m_strokes[strokeNum].setPattern(pattern);
+    m_displayList.update(m_strokes, strokeNum);
     m_dirtyRect = m_dirtyRect.united(m_strokes[strokeNum].boundingRect());
     return true;
   }
 }
 
 int Page::textIndexFromMouseClick(int x, int y){
+    ensureLoaded();
     for(int i = 0; i < m_texts.length(); ++i){
         if(std::get<0>(m_texts[i]).contains(x, y)){
             return i;
@@ -263,16 +351,19 @@ int Page::textIndexFromMouseClick(int x, int y){
 }
 
 int Page::appendText(const QRectF &rect, const QFont &font, const QColor &color, const QString &text){
+    prepareChange();
     m_texts.append(std::make_tuple(rect, font, color, text));
     rectIsPoint = true;
     return m_texts.size()-1;
 }
 
 const QString& Page::textByIndex(int i){
+    ensureLoaded();
     return std::get<3>(m_texts[i]);
 }
 
 void Page::setText(int index, const QFont& font, const QColor& color, const QString& text){
+    prepareChange();
     if(text.isEmpty()){
         m_texts.remove(index);
     }
@@ -285,18 +376,22 @@ void Page::setText(int index, const QFont& font, const QColor& color, const QStr
 }
 
 const QRectF& Page::textRectByIndex(int i){
+    ensureLoaded();
     return std::get<0>(m_texts[i]);
 }
 
 const QColor& Page::textColorByIndex(int i){
+    ensureLoaded();
     return std::get<2>(m_texts[i]);
 }
 
 const QFont& Page::textFontByIndex(int i){
+    ensureLoaded();
     return std::get<1>(m_texts[i]);
 }
 
 int Page::markdownIndexFromMouseClick(int x, int y){
+    ensureLoaded();
     for(int i = 0; i < m_markdownDocs.size(); ++i){
         if(std::get<0>(m_markdownDocs[i]).contains(x, y)){
             return i;
@@ -306,16 +401,15 @@ int Page::markdownIndexFromMouseClick(int x, int y){
 }
 
 int Page::appendMarkdown(const QRectF &rect, const QString &text){
+    prepareChange();
     QRectF boundingRect;
 
-    QTextDocument td;
-
-    td.setHtml(compileMarkdown(text));
-
-    td.setPageSize(adjustMarkdownSize(rect.x(), rect.y(), td.size()));
-
+    // documents loaded from a file have their rect, so loading a page (possibly on a worker thread) doesn't lay out markdown
     if(rect.width() == 0 && rect.height() == 0){
-        boundingRect = QRectF(rect.x(), rect.y(), td.size().width(), td.size().height());
+        std::shared_ptr<const MarkdownRenderer> markdownRenderer = MarkdownRenderer::instance();
+        QSizeF pageSize = adjustMarkdownSize(rect.x(), rect.y(), markdownRenderer->size(text));
+        QSizeF size = markdownRenderer->size(text, pageSize);
+        boundingRect = QRectF(rect.x(), rect.y(), size.width(), size.height());
     }
     else{
         boundingRect = rect;
@@ -325,6 +419,7 @@ int Page::appendMarkdown(const QRectF &rect, const QString &text){
 }
 
 void Page::insertMarkdown(int index, const QString &text, const QRectF& rect){
+    prepareChange();
     if(!text.isEmpty()){
 
         //td.setPageSize(adjustMarkdownSize(std::get<0>(m_markdownDocs[index]).x(), std::get<0>(m_markdownDocs[index]).y(), td.size()));
@@ -337,6 +432,7 @@ void Page::insertMarkdown(int index, const QString &text, const QRectF& rect){
 }
 
 void Page::resetMarkdown(int index, const QString &text, const QRectF &rect){
+    prepareChange();
     if(text.isEmpty()){
         m_markdownDocs.remove(index);
     }
@@ -344,13 +440,11 @@ void Page::resetMarkdown(int index, const QString &text, const QRectF &rect){
         if(index < m_markdownDocs.size()){
             QRectF boundingRect;
 
-            QTextDocument td;
-
-            td.setHtml(compileMarkdown(text));
-
-            td.setPageSize(adjustMarkdownSize(rect.x(), rect.y(), td.size()));
+            std::shared_ptr<const MarkdownRenderer> markdownRenderer = MarkdownRenderer::instance();
+            QSizeF pageSize = adjustMarkdownSize(rect.x(), rect.y(), markdownRenderer->size(text));
+            QSizeF size = markdownRenderer->size(text, pageSize);
 
-            boundingRect = QRectF(rect.x(), rect.y(), td.size().width(), td.size().height());
+            boundingRect = QRectF(rect.x(), rect.y(), size.width(), size.height());
 
             m_markdownDocs[index] = std::make_tuple(boundingRect, text);
         }
@@ -358,47 +452,73 @@ void Page::resetMarkdown(int index, const QString &text, const QRectF &rect){
 }
 
 QString Page::markdownByIndex(int i){
+    ensureLoaded();
     return std::get<1>(m_markdownDocs[i]);
 }
 
 QRectF Page::markdownRectByIndex(int i){
+    ensureLoaded();
     return std::get<0>(m_markdownDocs[i]);
 }
 
 const QVector<Stroke> &Page::strokes()
 {
+  ensureLoaded();
   return m_strokes;
 }
 
 const QVector<std::tuple<QRectF, QFont, QColor, QString> > &Page::texts(){
+    ensureLoaded();
     return m_texts;
 }
 
 const QVector<std::tuple<QRectF, QString>>& Page::markdowns(){
+    ensureLoaded();
     return m_markdownDocs;
 }
 
-QVector<QPair<Stroke, int>> Page::getStrokes(QPolygonF selectionPolygon)
+QVector<int> Page::strokesInRect(const QRectF &rect) const
 {
-  QVector<QPair<Stroke, int>> strokesAndPositions;
+  ensureLoaded();
+  return m_strokeIndex.query(rect);
+}
 
-  for (int i = m_strokes.size() - 1; i >= 0; --i)
+QVector<int> Page::strokesInPolygon(const QPolygonF &polygon) const
+{
+  ensureLoaded();
+  QVector<int> positions;
+  for (int i : m_strokeIndex.query(polygon))
   {
     const MrDoc::Stroke &stroke = m_strokes.at(i);
     bool containsStroke = true;
-    for (int j = 0; j < stroke.points.size(); ++j)
+    for (int j = 0; j < stroke.size(); ++j)
     {
-      if (!selectionPolygon.containsPoint(stroke.points.at(j), Qt::OddEvenFill))
+      if (!polygon.containsPoint(stroke.point(j), Qt::OddEvenFill))
       {
         containsStroke = false;
+        break;
       }
     }
     if (containsStroke)
     {
-      // add selected strokes and positions to return vector
-      strokesAndPositions.append(QPair<Stroke, int>(stroke, i));
+      positions.append(i);
     }
   }
+  return positions;
+}
+
+QVector<QPair<Stroke, int>> Page::getStrokes(QPolygonF selectionPolygon)
+{
+  ensureLoaded();
+  QVector<QPair<Stroke, int>> strokesAndPositions;
+
+  QVector<int> positions = strokesInPolygon(selectionPolygon);
+  for (int k = positions.size() - 1; k >= 0; --k)
+  {
+    int i = positions[k];
+    // add selected strokes and positions to return vector
+    strokesAndPositions.append(QPair<Stroke, int>(m_strokes.at(i), i));
+  }
 
   return strokesAndPositions;
 }
@@ -417,12 +537,16 @@ QVector<QPair<Stroke, int>> Page::removeStrokes(QPolygonF selectionPolygon)
 
 void Page::removeStrokeAt(int i)
 {
+  prepareChange();
   m_dirtyRect = m_dirtyRect.united(m_strokes[i].boundingRect());
   m_strokes.removeAt(i);
+  m_strokeIndex.remove(i);
+  m_displayList.remove(m_strokes, i);
 }
 
 void Page::removeLastStroke()
 {
+  ensureLoaded();
   removeStrokeAt(m_strokes.size() - 1);
 }
 
@@ -436,20 +560,29 @@ void Page::insertStrokes(const QVector<QPair<Stroke, int>> &strokesAndPositions)
 
 void Page::insertStroke(int position, const Stroke &stroke)
 {
+  prepareChange();
   m_dirtyRect = m_dirtyRect.united(stroke.boundingRect());
   m_strokes.insert(position, stroke);
+  m_strokeIndex.insert(position, stroke.boundingRect());
+  m_displayList.insert(m_strokes, position);
 }
 
 void Page::appendStroke(const Stroke &stroke)
 {
+  prepareChange();
   m_dirtyRect = m_dirtyRect.united(stroke.boundingRect());
   m_strokes.append(stroke);
+  m_strokeIndex.append(stroke.boundingRect());
+  m_displayList.append(m_strokes);
 }
 
 void Page::prependStroke(const Stroke &stroke)
 {
+  prepareChange();
   m_dirtyRect = m_dirtyRect.united(stroke.boundingRect());
   m_strokes.prepend(stroke);
+  m_strokeIndex.insert(0, stroke.boundingRect());
+  m_displayList.insert(m_strokes, 0);
 }
 
 void Page::appendStrokes(const QVector<Stroke> &strokes)
@@ -460,35 +593,123 @@ void Page::appendStrokes(const QVector<Stroke> &strokes)
   }
 }
 
-void Page::setPdf(Poppler::Page* page, int pageNum, bool adjustSize){
-    /*Poppler::Document* doc = Poppler::Document::load(path);
-    if (!doc || doc->isLocked()){
-        qDebug() << "Couldn't load PDF";
-    }
-    else{
-        Poppler::Page* page = doc->page(pageNum);
-        if(page == 0){
-            qDebug() << "Couldn't load PDF page";
-        }
-        else{
-            //m_pdf = page->renderToImage(72.0*10, 72.0*10, 0,0,int(m_width*10), int(m_height*10));
-            m_pdfPointer.reset(page); //= std::make_shared<Poppler::Page>(page);
-            pageno = pageNum;
-            //delete page;
-        }
-    }*/
-    //delete doc;
+void Page::setSource(std::shared_ptr<const PageSource> source, int index)
+{
+  m_source = std::move(source);
+  m_sourceIndex = index;
+  m_loaded = true;
+  m_loadFailed = false;
+  unload();
+}
+
+bool Page::isLoaded() const
+{
+  return m_loaded;
+}
+
+const std::shared_ptr<const PageSource> &Page::source() const
+{
+  return m_source;
+}
+
+int Page::sourceIndex() const
+{
+  return m_sourceIndex;
+}
+
+bool Page::loadFailed() const
+{
+  return m_loadFailed;
+}
 
-    if(adjustSize){
-        m_width = page->pageSizeF().width();
-        m_height = page->pageSizeF().height();
+bool Page::unload()
+{
+  // a page which couldn't be loaded would only fail again
+  if (!m_loaded || m_source == nullptr || m_loadFailed)
+  {
+    return false;
+  }
+  m_strokes.clear();
+  m_texts.clear();
+  m_markdownDocs.clear();
+  rebuildStrokeIndex();
+  m_loaded = false;
+  return true;
+}
+
+void Page::load() const
+{
+  // loading does not change what the page looks like, so it is done in const functions, too
+  Page *page = const_cast<Page *>(this);
+  page->m_loaded = true;
+  // the source appends the content like any other change, which would detach the page from it
+  std::shared_ptr<const PageSource> source = m_source;
+  if (!source->loadPage(m_sourceIndex, *page))
+  {
+    // whatever was appended before the error is dropped, the page is shown empty but keeps its source for the savers
+    qWarning() << "Couldn't load page" << m_sourceIndex;
+    page->m_strokes.clear();
+    page->m_texts.clear();
+    page->m_markdownDocs.clear();
+    page->rebuildStrokeIndex();
+    page->m_loadFailed = true;
+  }
+  page->m_source = source;
+  page->clearDirtyRect();
+}
+
+void Page::prepareChange()
+{
+  ensureLoaded();
+  // the content differs from the source from now on, so it must not be discarded anymore
+  m_source = nullptr;
+}
+
+void Page::rebuildStrokeIndex()
+{
+  m_displayList.invalidate();
+  m_strokeIndex.clear();
+  for (const Stroke &stroke : m_strokes)
+  {
+    m_strokeIndex.append(stroke.boundingRect());
+  }
+}
+
+bool Page::setPdf(const std::shared_ptr<PdfDocument> &document, int pageNum, bool adjustSize)
+{
+  Poppler::Page *page;
+  QSizeF pageSize;
+  {
+    // released before the previous pdf page is deleted below, which may lock the same mutex
+    QMutexLocker locker(&document->mutex);
+    page = document->document->page(pageNum);
+    if (page != nullptr)
+    {
+      pageSize = page->pageSizeF();
     }
-    m_pdfPointer.reset(page);
-    pageno = pageNum;
+  }
+  if (page == nullptr)
+  {
+    return false;
+  }
+  if (adjustSize)
+  {
+    m_width = pageSize.width();
+    m_height = pageSize.height();
+  }
+  // the deleter holds the document, poppler pages must not outlive it
+  m_pdfPointer = std::shared_ptr<Poppler::Page>(page, [document](Poppler::Page *pdfPage) {
+    QMutexLocker locker(&document->mutex);
+    delete pdfPage;
+  });
+  m_pdfDocument = document;
+  pageno = pageNum;
+  return true;
 }
 
 bool Page::searchPdfNext(const QString &text){
     if(isPdf()){
+        QMutexLocker locker(&m_pdfDocument->mutex);
         searchResultRects = m_pdfPointer->search(text, Poppler::Page::IgnoreCase);
         return !searchResultRects.isEmpty();
     }
@@ -497,6 +718,7 @@ bool Page::searchPdfNext(const QString &text){
 
 bool Page::searchPdfPrev(const QString &text){
     if(isPdf()){
+        QMutexLocker locker(&m_pdfDocument->mutex);
         searchResultRects = m_pdfPointer->search(text, Poppler::Page::IgnoreCase);
         return !searchResultRects.isEmpty();
     }
@@ -509,6 +731,7 @@ void Page::clearPdfSearch(){
 
 Poppler::LinkGoto* Page::linkFromMouseClick(qreal x, qreal y){
     if(isPdf()){
+        QMutexLocker locker(&m_pdfDocument->mutex);
         QList<Poppler::Link*> links = m_pdfPointer->links();
         for(auto link : links){
             if(link->linkArea().contains(x/m_width,y/m_height) && link->linkType() == Poppler::Link::LinkType::Goto){
@@ -519,16 +742,6 @@ Poppler::LinkGoto* Page::linkFromMouseClick(qreal x, qreal y){
     return nullptr;
 }
 
-char* Page::compileMarkdown(const QString &text){
-    MMIOT* doc;
-    char* output;
-    QByteArray data = text.toUtf8();
-    doc = mkd_string(data, data.length(), 0);
-    mkd_compile(doc, 0);
-    mkd_document(doc, &output);
-    return output;
-}
-
 QSizeF Page::adjustMarkdownSize(int x, int y, QSizeF oldSize){
     QSizeF returnSize = oldSize;
     bool sizeChanged = false;
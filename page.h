@@ -2,21 +2,57 @@
 #define PAGE_H
 
 #include "stroke.h"
+#include "strokeindex.h"
+#include "displaylist.h"
+#include "markdownrenderer.h"
 #include <poppler-qt5.h>
 #include <poppler-link.h>
 #include <QDebug>
 #include <QImage>
-#include <QTextEdit>
-#include <QTextDocument>
+#include <QMutex>
 #include <memory>
 #include <algorithm>
 #include <math.h>
-extern "C" {
-#include<mkdio.h>
-}
 
 namespace MrDoc
 {
+class Page;
+
+/**
+ * @brief The PageSource class provides the content of pages which is loaded when it is needed for the first time
+ * @see Page::setSource
+ */
+class PageSource
+{
+public:
+  virtual ~PageSource() = default;
+  /**
+   * @brief loadPage appends the strokes, texts and markdown documents of a page
+   * @param index is the index of the page in the source
+   * @param page
+   * @return true if successful, otherwise false
+   */
+  virtual bool loadPage(int index, Page &page) const = 0;
+};
+
+/**
+ * @brief The PdfDocument class is a poppler document together with the mutex serializing all calls to it and to its pages. Poppler is not
+ * thread safe, but different documents can be used in parallel. It is shared by the document, its pages and their backgrounds.
+ */
+class PdfDocument
+{
+public:
+  /**
+   * @brief load opens a pdf file with antialiasing
+   * @param fileName
+   * @return the document or nullptr if the file could not be opened
+   */
+  static std::shared_ptr<PdfDocument> load(const QString &fileName);
+
+  std::unique_ptr<Poppler::Document> document;
+  QMutex mutex; /**< has to be held for every call to @ref document and its pages */
+};
+
 /**
  * @brief The Page class is the class containing all information about a page. A page can be blank or contain a pdf page to draw on.
  */
@@ -31,6 +67,25 @@ public:
         RULED
     };
 
+  /**
+   * @brief The Background struct is everything paintBackground needs. It is a small copy which can be painted on another thread while the
+   * page is changed, and its pdf page keeps the poppler document alive (see setPdf).
+   */
+  struct Background
+  {
+    qreal width;
+    qreal height;
+    QColor color;
+    backgroundType type;
+    std::shared_ptr<Poppler::Page> pdfPage; /**< nullptr if the page has no pdf page */
+    std::shared_ptr<PdfDocument> pdfDocument; /**< document of @ref pdfPage, its mutex is held while the page is rendered */
+
+    /**
+     * @see Page::paintBackground
+     */
+    void paint(QPainter &painter, qreal zoom, QRectF region = QRect(0, 0, 0, 0)) const;
+  };
+
   qreal width() const;
   qreal height() const;
 
@@ -139,6 +194,19 @@ public:
   const QVector<std::tuple<QRectF, QFont, QColor, QString> > &texts();
   const QVector<std::tuple<QRectF, QString>>& markdowns();
 
+  /**
+   * @brief strokesInRect
+   * @param rect
+   * @return indices of all strokes whose bounding rect intersects @param rect in ascending order
+   */
+  QVector<int> strokesInRect(const QRectF &rect) const;
+  /**
+   * @brief strokesInPolygon
+   * @param polygon
+   * @return indices of all strokes lying completely inside @param polygon in ascending order
+   */
+  QVector<int> strokesInPolygon(const QPolygonF &polygon) const;
+
   QVector<QPair<Stroke, int>> getStrokes(QPolygonF selectionPolygon);
   QVector<QPair<Stroke, int>> removeStrokes(QPolygonF selectionPolygon);
   void removeStrokeAt(int i);
@@ -153,11 +221,12 @@ public:
 
   /**
    * @brief setPdf sets a pdf page as "background" for the page
-   * @param page is the pointer to pdf page (provided by poppler)
+   * @param document is the pdf. The page keeps it alive as long as the pdf page is used, also by copies of the page on other threads.
    * @param pageNum is the page number (first page is 0)
    * @param adjustSize if true, the size will adjusted to pdf's size
+   * @return false if @param document has no page @param pageNum
    */
-  void setPdf(Poppler::Page *page, int pageNum, bool adjustSize);
+  bool setPdf(const std::shared_ptr<PdfDocument> &document, int pageNum, bool adjustSize);
   //void setPdfPath(const QString path);
 
   /**
@@ -187,12 +256,44 @@ public:
 
   //    virtual void paint(QPainter &painter, qreal zoom);
   /**
-   * @brief paint paints the page with @param painter
+   * @brief paint paints the page with @param painter, i.e. the background and the ink on top
    * @param painter
    * @param zoom
    * @param region
+   * @see paintBackground
+   * @see paintInk
    */
   virtual void paint(QPainter &painter, qreal zoom, QRectF region = QRect(0, 0, 0, 0));
+  /**
+   * @brief paintBackground paints the ruling and the pdf page. It does not depend on strokes, texts or markdown, so it can be cached.
+   * @param painter
+   * @param zoom
+   * @param region is the region to paint (zoom factor 1). If it is null, the whole page is painted.
+   */
+  void paintBackground(QPainter &painter, qreal zoom, QRectF region = QRect(0, 0, 0, 0)) const;
+  /**
+   * @brief paintInk paints texts, strokes, search results and markdown documents
+   * @param painter
+   * @param zoom
+   * @param region is the region to paint (zoom factor 1). If it is null, the whole page is painted. Otherwise the painter has to be clipped to it.
+   */
+  void paintInk(QPainter &painter, qreal zoom, QRectF region = QRect(0, 0, 0, 0));
+  /**
+   * @brief hasBackground
+   * @return true if the page has a pdf page or a ruling, i.e. if paintBackground paints anything
+   */
+  bool hasBackground() const;
+  /**
+   * @brief background
+   * @return a copy of size, background color, ruling and pdf page, without strokes, texts or markdown
+   */
+  Background background() const;
+  /**
+   * @brief paintForPdfExport paints texts, strokes and markdown documents, but neither the background nor search results. Every stroke is
+   * painted as a filled outline, so vector output gets one path per stroke instead of one line per segment.
+   * @param painter
+   * @param zoom
+   */
   void paintForPdfExport(QPainter &painter, qreal zoom);
 
   //    QVector<Stroke> strokes;
@@ -205,11 +306,49 @@ public:
       return pageno;
   }
 
-  static char* compileMarkdown(const QString& text);
+  /**
+   * @brief setSource turns the page into a stub. Its strokes, texts and markdown documents are loaded from @param source when they are
+   * accessed for the first time. Size, background and pdf page are not part of the source and have to be set by the caller.
+   * @param source
+   * @param index is the index of the page in @param source
+   */
+  void setSource(std::shared_ptr<const PageSource> source, int index);
+  /**
+   * @brief isLoaded
+   * @return false if the page is a stub whose content is not in memory
+   */
+  bool isLoaded() const;
+  /**
+   * @brief source
+   * @return the source the content of the page was loaded from. It is nullptr if the page has no source or the content was changed since it was
+   * loaded, i.e. if the content would be lost by unloading it.
+   */
+  const std::shared_ptr<const PageSource> &source() const;
+  int sourceIndex() const;
+  /**
+   * @brief loadFailed
+   * @return true if the content could not be loaded from the source. The page is shown empty, but stays tied to its source, so that savers can
+   * copy the original content (see BinaryDocument::write) or refuse to save instead of replacing it by nothing.
+   */
+  bool loadFailed() const;
+  /**
+   * @brief unload turns an unchanged page back into a stub to free its memory. The content is loaded from the source again when it is needed.
+   * @return true if the content was discarded, false if the page has no source or was changed
+   */
+  bool unload();
 
 protected:
+  /**
+   * @brief rebuildStrokeIndex rebuilds @ref m_strokeIndex and invalidates @ref m_displayList. It has to be called after @ref m_strokes was changed
+   * directly.
+   */
+  void rebuildStrokeIndex();
+
   QVector<Stroke> m_strokes;
+  StrokeIndex m_strokeIndex; /**< spatial index of the bounding rects of @ref m_strokes */
+  DisplayList m_displayList; /**< compiled @ref m_strokes, built when the page is painted */
   std::shared_ptr<Poppler::Page> m_pdfPointer = std::shared_ptr<Poppler::Page>(nullptr); /**< pointer to the pdf page to draw on (nullptr, if blank page) */
+  std::shared_ptr<PdfDocument> m_pdfDocument; /**< document of @ref m_pdfPointer */
   int pageno; //pageNumber in the document
   QList<QRectF> searchResultRects; /**< list of the (yellow) rectangles around search results */
 
@@ -217,6 +356,29 @@ protected:
   QVector<std::tuple<QRectF, QString>> m_markdownDocs; /**< contains the inserted markdown documents, QRectF is the bounding rect (zoom factor 1)*/
 
 private:
+  void ensureLoaded() const
+  {
+    if (!m_loaded)
+    {
+      load();
+    }
+  }
+  void load() const;
+  /**
+   * @brief prepareChange loads the page and detaches it from its source. It is called by every function changing strokes, texts or markdown.
+   */
+  void prepareChange();
+  /**
+   * @brief paintStrokesForExport fills the export outlines of the strokes, batching consecutive pen strokes of the same colour
+   * @see Stroke::exportOutline
+   */
+  void paintStrokesForExport(QPainter &painter, qreal zoom) const;
+
+  std::shared_ptr<const PageSource> m_source; /**< source of the content, nullptr if there is none or the content was changed */
+  int m_sourceIndex = -1;
+  bool m_loaded = true; /**< false if the page is a stub */
+  bool m_loadFailed = false; /**< true if the source couldn't provide the content, kept when the page is changed afterwards */
+
   QSizeF adjustMarkdownSize(int x, int y, QSizeF oldSize);
   QColor m_backgroundColor;
   backgroundType m_backgroundType;
@@ -1,5 +1,7 @@
 #include "qcompressor.h"
 
+#include <QtConcurrent>
+
 /**
  * @brief Compresses the given buffer using the standard GZIP algorithm
  * @param input The buffer to be compressed
@@ -7,7 +9,7 @@
  * @param level The compression level to be used (@c 0 = no compression, @c 9 = max, @c -1 = default)
  * @return @c true if the compression was successful, @c false otherwise
  */
-bool QCompressor::gzipCompress(QByteArray input, QByteArray &output, int level)
+bool QCompressor::gzipCompress(const QByteArray &input, QByteArray &output, int level)
 {
   // Prepare output
   output.clear();
@@ -36,7 +38,7 @@ bool QCompressor::gzipCompress(QByteArray input, QByteArray &output, int level)
     output.clear();
 
     // Extract pointer to input data
-    char *input_data = input.data();
+    const char *input_data = input.constData();
     int input_data_left = input.length();
 
     // Compress data until available
@@ -101,13 +103,128 @@ bool QCompressor::gzipCompress(QByteArray input, QByteArray &output, int level)
     return (true);
 }
 
+bool QCompressor::gzipCompressParallel(const QByteArray &input, QByteArray &output, int level)
+{
+  output.clear();
+  if (input.isEmpty())
+  {
+    return true;
+  }
+
+  struct Block
+  {
+    int offset;
+    int size;
+    DeflatedBlock deflated;
+  };
+  QVector<Block> blocks;
+  for (int offset = 0; offset < input.size(); offset += parallelBlockSize)
+  {
+    blocks.append({offset, qMin(parallelBlockSize, input.size() - offset), DeflatedBlock()});
+  }
+
+  // the blocks and dictionaries refer to the input, it is not copied
+  QtConcurrent::blockingMap(blocks, [&input, level](Block &block) {
+    int dictionaryOffset = qMax(0, block.offset - dictionarySize);
+    QByteArray data = QByteArray::fromRawData(input.constData() + block.offset, block.size);
+    QByteArray dictionary = QByteArray::fromRawData(input.constData() + dictionaryOffset, block.offset - dictionaryOffset);
+    bool last = block.offset + block.size == input.size();
+    block.deflated = deflateBlock(data, dictionary, level, last);
+  });
+
+  output = gzipHeader();
+  quint32 crc = static_cast<quint32>(crc32(0L, Z_NULL, 0));
+  for (const Block &block : blocks)
+  {
+    if (!block.deflated.ok)
+    {
+      output.clear();
+      return false;
+    }
+    output.append(block.deflated.data);
+    crc = static_cast<quint32>(crc32_combine(crc, block.deflated.crc, static_cast<z_off_t>(block.deflated.size)));
+  }
+  output.append(gzipTrailer(crc, input.size()));
+  return true;
+}
+
+QCompressor::DeflatedBlock QCompressor::deflateBlock(const QByteArray &block, const QByteArray &dictionary, int level, bool last)
+{
+  DeflatedBlock result;
+  result.size = block.size();
+  result.crc = static_cast<quint32>(
+      crc32(crc32(0L, Z_NULL, 0), reinterpret_cast<const Bytef *>(block.constData()), static_cast<uInt>(block.size())));
+
+  z_stream strm;
+  strm.zalloc = Z_NULL;
+  strm.zfree = Z_NULL;
+  strm.opaque = Z_NULL;
+  // negative window bits give raw deflate data, header and trailer of the member are written by the caller
+  if (deflateInit2(&strm, qMax(-1, qMin(9, level)), Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+  {
+    return result;
+  }
+  if (!dictionary.isEmpty() &&
+      deflateSetDictionary(&strm, reinterpret_cast<const Bytef *>(dictionary.constData()), static_cast<uInt>(dictionary.size())) != Z_OK)
+  {
+    deflateEnd(&strm);
+    return result;
+  }
+
+  // a sync flush ends the block on a byte boundary without marking it as the last one
+  int flush = last ? Z_FINISH : Z_SYNC_FLUSH;
+  result.data.resize(static_cast<int>(deflateBound(&strm, static_cast<uLong>(block.size()))) + 16);
+  strm.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(block.constData()));
+  strm.avail_in = static_cast<uInt>(block.size());
+  strm.next_out = reinterpret_cast<Bytef *>(result.data.data());
+  strm.avail_out = static_cast<uInt>(result.data.size());
+  int ret;
+  for (;;)
+  {
+    ret = deflate(&strm, flush);
+    if (ret == Z_STREAM_ERROR || (last ? ret == Z_STREAM_END : strm.avail_out != 0))
+    {
+      break;
+    }
+    int used = result.data.size();
+    result.data.resize(2 * used);
+    strm.next_out = reinterpret_cast<Bytef *>(result.data.data() + used);
+    strm.avail_out = static_cast<uInt>(used);
+  }
+  result.data.resize(result.data.size() - static_cast<int>(strm.avail_out));
+  deflateEnd(&strm);
+
+  result.ok = last ? ret == Z_STREAM_END : (ret == Z_OK || ret == Z_BUF_ERROR);
+  return result;
+}
+
+QByteArray QCompressor::gzipHeader()
+{
+  // magic, deflate, no flags, no modification time, no extra flags, unknown operating system
+  static const char header[] = {'\x1f', '\x8b', 8, 0, 0, 0, 0, 0, 0, '\xff'};
+  return QByteArray(header, sizeof(header));
+}
+
+QByteArray QCompressor::gzipTrailer(quint32 crc, qint64 size)
+{
+  // crc32 and size modulo 2^32, both little endian
+  QByteArray trailer(8, 0);
+  quint32 size32 = static_cast<quint32>(size);
+  for (int i = 0; i < 4; ++i)
+  {
+    trailer[i] = static_cast<char>((crc >> (8 * i)) & 0xff);
+    trailer[4 + i] = static_cast<char>((size32 >> (8 * i)) & 0xff);
+  }
+  return trailer;
+}
+
 /**
  * @brief Decompresses the given buffer using the standard GZIP algorithm
  * @param input The buffer to be decompressed
  * @param output The result of the decompression
  * @return @c true if the decompression was successfull, @c false otherwise
  */
-bool QCompressor::gzipDecompress(QByteArray input, QByteArray &output)
+bool QCompressor::gzipDecompress(const QByteArray &input, QByteArray &output)
 {
   // Prepare output
   output.clear();
@@ -130,7 +247,7 @@ bool QCompressor::gzipDecompress(QByteArray input, QByteArray &output)
       return (false);
 
     // Extract pointer to input data
-    char *input_data = input.data();
+    const char *input_data = input.constData();
     int input_data_left = input.length();
 
     // Decompress data until available
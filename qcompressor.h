@@ -18,8 +18,45 @@
 class QCompressor
 {
 public:
-  static bool gzipCompress(QByteArray input, QByteArray &output, int level = -1);
-  static bool gzipDecompress(QByteArray input, QByteArray &output);
+  static bool gzipCompress(const QByteArray &input, QByteArray &output, int level = -1);
+  /**
+   * @brief gzipCompressParallel compresses @param input into a single gzip member like gzipCompress, but deflates blocks of
+   * @ref parallelBlockSize bytes on all cores (like pigz). Every block is primed with the 32 KiB in front of it, so the result is hardly larger.
+   */
+  static bool gzipCompressParallel(const QByteArray &input, QByteArray &output, int level = -1);
+  static bool gzipDecompress(const QByteArray &input, QByteArray &output);
+
+  /**
+   * @brief The DeflatedBlock struct is a part of a gzip member which was deflated independently of the other parts
+   */
+  struct DeflatedBlock
+  {
+    QByteArray data; /**< raw deflate data, ends on a byte boundary so that the next block can be appended */
+    quint32 crc = 0; /**< crc32 of the uncompressed block, see crc32_combine */
+    qint64 size = 0; /**< uncompressed size */
+    bool ok = false;
+  };
+
+  /**
+   * @brief deflateBlock deflates @param block as part of a gzip member. It is thread safe.
+   * @param dictionary is the end (up to @ref dictionarySize bytes) of the uncompressed data in front of the block, empty for the first block
+   * @param level is the compression level (@c 0 = no compression, @c 9 = max, @c -1 = default)
+   * @param last has to be true for the last block of the member, which terminates the deflate stream
+   */
+  static DeflatedBlock deflateBlock(const QByteArray &block, const QByteArray &dictionary, int level, bool last);
+  /**
+   * @brief gzipHeader
+   * @return the header of a gzip member without file name and modification time, which is followed by the deflated blocks
+   */
+  static QByteArray gzipHeader();
+  /**
+   * @brief gzipTrailer
+   * @return the trailer of a gzip member with the (combined) crc32 and the size of its uncompressed data
+   */
+  static QByteArray gzipTrailer(quint32 crc, qint64 size);
+
+  static constexpr int parallelBlockSize = 128 * 1024;
+  static constexpr int dictionarySize = 32 * 1024; /**< size of the deflate window */
 };
 
 #endif // QCOMPRESSOR_H
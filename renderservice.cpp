@@ -0,0 +1,227 @@
+#include "renderservice.h"
+
+#include <QMutexLocker>
+#include <QPainter>
+
+class RenderThread : public QThread
+{
+public:
+  RenderThread(RenderService *service) : m_service{service}
+  {
+  }
+
+protected:
+  void run() override
+  {
+    m_service->process();
+  }
+
+private:
+  RenderService *m_service;
+};
+
+RenderService::RenderService(QObject *parent) : QObject(parent)
+{
+  qRegisterMetaType<TileKey>("TileKey");
+
+  int threadCount = std::max(1, std::min(QThread::idealThreadCount() - 1, 4));
+  for (int i = 0; i < threadCount; ++i)
+  {
+    RenderThread *thread = new RenderThread(this);
+    m_threads.append(thread);
+    thread->start(QThread::LowPriority);
+  }
+}
+
+RenderService::~RenderService()
+{
+  {
+    QMutexLocker locker(&m_mutex);
+    m_stopping = true;
+    m_queue.clear();
+    m_queued.clear();
+    m_condition.wakeAll();
+  }
+  for (RenderThread *thread : m_threads)
+  {
+    thread->wait();
+    delete thread;
+  }
+}
+
+void RenderService::request(const TileKey &key, const MrDoc::Page::Background &background, qreal devicePixelRatio, priority prio)
+{
+  QMutexLocker locker(&m_mutex);
+
+  auto runningIter = m_running.find(key);
+  if (runningIter != m_running.end() && isCurrentLocked(key, runningIter->second))
+  {
+    return;
+  }
+
+  auto queuedIter = m_queued.find(key);
+  if (queuedIter != m_queued.end())
+  {
+    if (queuedIter->second.first == static_cast<int>(prio))
+    {
+      return;
+    }
+    m_queue.erase(queuedIter->second);
+    m_queued.erase(queuedIter);
+  }
+
+  QueuePosition position(static_cast<int>(prio), m_sequence++);
+  Job job;
+  job.key = key;
+  job.background = background;
+  job.devicePixelRatio = devicePixelRatio;
+  m_queue.insert({position, job});
+  m_queued.insert({key, position});
+
+  m_condition.wakeOne();
+}
+
+void RenderService::retain(const QVector<TileKey> &keys)
+{
+  std::unordered_map<TileKey, QueuePosition, TileKeyHash, TileKeyEqual> retained;
+
+  QMutexLocker locker(&m_mutex);
+  for (const TileKey &key : keys)
+  {
+    auto queuedIter = m_queued.find(key);
+    if (queuedIter != m_queued.end())
+    {
+      retained.insert(*queuedIter);
+      m_queued.erase(queuedIter);
+    }
+  }
+  for (auto &cancelled : m_queued)
+  {
+    m_queue.erase(cancelled.second);
+  }
+  m_queued.swap(retained);
+}
+
+void RenderService::cancelAll()
+{
+  QMutexLocker locker(&m_mutex);
+  m_queue.clear();
+  m_queued.clear();
+  m_validFrom = m_sequence;
+  m_pageValidFrom.clear();
+}
+
+void RenderService::cancelPage(int pageNum)
+{
+  QMutexLocker locker(&m_mutex);
+  for (auto queuedIter = m_queued.begin(); queuedIter != m_queued.end();)
+  {
+    if (queuedIter->first.pageNum == pageNum)
+    {
+      m_queue.erase(queuedIter->second);
+      queuedIter = m_queued.erase(queuedIter);
+    }
+    else
+    {
+      ++queuedIter;
+    }
+  }
+  m_pageValidFrom[pageNum] = m_sequence;
+}
+
+void RenderService::drain()
+{
+  QMutexLocker locker(&m_mutex);
+  m_queue.clear();
+  m_queued.clear();
+  m_validFrom = m_sequence;
+  m_pageValidFrom.clear();
+  while (m_busyThreads > 0)
+  {
+    m_idleCondition.wait(&m_mutex);
+  }
+}
+
+void RenderService::process()
+{
+  forever
+  {
+    Job job;
+    quint64 generation;
+    {
+      QMutexLocker locker(&m_mutex);
+      while (m_queue.empty() && !m_stopping)
+      {
+        m_condition.wait(&m_mutex);
+      }
+      if (m_stopping)
+      {
+        return;
+      }
+      auto first = m_queue.begin();
+      job = first->second;
+      generation = first->first.second;
+      m_queued.erase(job.key);
+      m_queue.erase(first);
+      m_running[job.key] = generation;
+      ++m_busyThreads;
+    }
+
+    QImage image = renderBackgroundTile(job.key, job.background, job.devicePixelRatio);
+
+    QMutexLocker locker(&m_mutex);
+    if (--m_busyThreads == 0)
+    {
+      m_idleCondition.wakeAll();
+    }
+    auto runningIter = m_running.find(job.key);
+    if (runningIter != m_running.end() && runningIter->second == generation)
+    {
+      m_running.erase(runningIter);
+    }
+    if (isCurrentLocked(job.key, generation) && !m_stopping)
+    {
+      emit tileRendered(job.key, image, generation);
+    }
+  }
+}
+
+bool RenderService::isCurrent(const TileKey &key, quint64 generation) const
+{
+  QMutexLocker locker(&m_mutex);
+  return isCurrentLocked(key, generation);
+}
+
+bool RenderService::isCurrentLocked(const TileKey &key, quint64 generation) const
+{
+  if (generation < m_validFrom)
+  {
+    return false;
+  }
+  auto pageIter = m_pageValidFrom.find(key.pageNum);
+  return pageIter == m_pageValidFrom.end() || generation >= pageIter->second;
+}
+
+QImage RenderService::renderBackgroundTile(const TileKey &key, const MrDoc::Page::Background &background, qreal devicePixelRatio)
+{
+  QRect tileRect = TileCache::tileRect(key, QSizeF(background.width, background.height), devicePixelRatio);
+
+  QImage image(tileRect.size(), QImage::Format_ARGB32_Premultiplied);
+  image.setDevicePixelRatio(devicePixelRatio);
+  image.fill(background.color);
+
+  QRectF clipRect(QPointF(tileRect.topLeft()) / devicePixelRatio, QSizeF(tileRect.size()) / devicePixelRatio);
+  QRectF paintRect(clipRect.topLeft() / key.zoom, clipRect.bottomRight() / key.zoom);
+
+  QPainter painter;
+  painter.begin(&image);
+  painter.setRenderHint(QPainter::Antialiasing, true);
+  painter.translate(-clipRect.topLeft());
+  painter.setClipRect(clipRect);
+  painter.setClipping(true);
+
+  background.paint(painter, key.zoom, paintRect);
+
+  painter.end();
+  return image;
+}
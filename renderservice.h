@@ -0,0 +1,121 @@
+#ifndef RENDERSERVICE_H
+#define RENDERSERVICE_H
+
+#include <QObject>
+#include <QImage>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QThread>
+#include <QVector>
+#include <map>
+#include <unordered_map>
+
+#include "page.h"
+#include "tilecache.h"
+
+class RenderThread;
+
+/**
+ * @brief The RenderService class renders background tiles (pdf and ruling) in worker threads.
+ * @details Requests are queued by priority and can be cancelled when they became stale after zooming or scrolling.
+ * Rendered tiles are delivered by @ref tileRendered, so the thread requesting tiles never waits for poppler.
+ */
+class RenderService : public QObject
+{
+  Q_OBJECT
+public:
+  enum class priority
+  {
+    VISIBLE,   /**< tiles in the visible area */
+    NEIGHBOUR, /**< tiles next to the visible area */
+    PREFETCH   /**< everything else */
+  };
+
+  explicit RenderService(QObject *parent = 0);
+  ~RenderService();
+
+  /**
+   * @brief request queues rendering of a background tile. If the tile is already queued, its priority is updated.
+   * @param key key of the background tile
+   * @param background of the page, see Page::background. It is copied, so that the document can be changed while the tile is rendered.
+   * @param devicePixelRatio
+   * @param prio
+   */
+  void request(const TileKey &key, const MrDoc::Page::Background &background, qreal devicePixelRatio, priority prio);
+  /**
+   * @brief retain cancels all queued requests which are not in @param keys
+   */
+  void retain(const QVector<TileKey> &keys);
+  /**
+   * @brief cancelAll cancels all queued requests. Tiles which are rendered at the moment are not delivered.
+   */
+  void cancelAll();
+  /**
+   * @brief cancelPage cancels the queued requests of page @param pageNum. Its tiles which are rendered at the moment are not delivered, the
+   * tiles of other pages are not affected.
+   */
+  void cancelPage(int pageNum);
+  /**
+   * @brief drain cancels all queued requests and waits until the tiles which are rendered at the moment are done. It is called before the
+   * document is replaced.
+   */
+  void drain();
+
+  /**
+   * @brief renderBackgroundTile renders the background (pdf and ruling) of a single tile
+   * @param key
+   * @param background
+   * @param devicePixelRatio
+   * @return the tile, cut to the page borders
+   */
+  static QImage renderBackgroundTile(const TileKey &key, const MrDoc::Page::Background &background, qreal devicePixelRatio);
+
+  /**
+   * @brief isCurrent
+   * @return false if the request @param generation of tile @param key was cancelled after it was made. Tiles are delivered by a queued
+   * signal, so the receiver checks this again before it uses a tile.
+   */
+  bool isCurrent(const TileKey &key, quint64 generation) const;
+
+signals:
+  /**
+   * @brief tileRendered delivers a tile
+   * @param key
+   * @param image
+   * @param generation of the request, see isCurrent
+   */
+  void tileRendered(TileKey key, QImage image, quint64 generation);
+
+private:
+  friend class RenderThread;
+
+  struct Job
+  {
+    TileKey key;
+    MrDoc::Page::Background background;
+    qreal devicePixelRatio;
+  };
+  typedef std::pair<int, quint64> QueuePosition; /**< priority and sequence number of a queued job */
+
+  /**
+   * @brief process takes jobs from the queue and renders them until the service is destroyed. It runs in every RenderThread.
+   */
+  void process();
+  bool isCurrentLocked(const TileKey &key, quint64 generation) const;
+
+  std::map<QueuePosition, Job> m_queue;
+  std::unordered_map<TileKey, QueuePosition, TileKeyHash, TileKeyEqual> m_queued; /**< position of every queued tile in @ref m_queue */
+  std::unordered_map<TileKey, quint64, TileKeyHash, TileKeyEqual> m_running;     /**< tiles rendered at the moment and their generation */
+  quint64 m_sequence = 0;   /**< generation of the next request */
+  quint64 m_validFrom = 0;  /**< requests of earlier generations were cancelled by cancelAll */
+  std::unordered_map<int, quint64> m_pageValidFrom; /**< per page, requests of earlier generations were cancelled by cancelPage */
+  int m_busyThreads = 0;    /**< threads rendering a tile at the moment */
+  bool m_stopping = false;
+
+  mutable QMutex m_mutex;
+  QWaitCondition m_condition;
+  QWaitCondition m_idleCondition; /**< woken when @ref m_busyThreads drops to 0 */
+  QVector<RenderThread *> m_threads;
+};
+
+#endif // RENDERSERVICE_H
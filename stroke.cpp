@@ -1,5 +1,8 @@
 #include "stroke.h"
 
+#include <algorithm>
+#include <math.h>
+
 namespace MrDoc
 {
 
@@ -128,58 +131,67 @@ Stroke::Stroke()
 
 //}
 
-void Stroke::paint(QPainter &painter, qreal zoom, bool last)
+void Stroke::paint(QPainter &painter, qreal zoom, bool last) const
 {
-    if (points.length() == 1)
+    int n = size();
+    QColor strokeColor = color();
+    if (n == 1)
     {
-        QRectF pointRect(zoom * points[0], QSizeF(0, 0));
-        qreal pad = penWidth * zoom / 2;
+        QRectF pointRect(zoom * point(0), QSizeF(0, 0));
+        qreal pad = m_penWidth * zoom / 2;
         painter.setPen(Qt::NoPen);
-        painter.setBrush(QBrush(color));
+        painter.setBrush(QBrush(strokeColor));
         painter.drawEllipse(pointRect.adjusted(-pad, -pad, pad, pad));
     }
+    else if (!last && m_pattern == dashPattern::SolidLine)
+    {
+        // a single fill instead of one drawLine per segment. Since every pixel is covered only once, this works for highlighters as well
+        std::shared_ptr<const QPainterPath> strokeOutline = outline();
+        QTransform oldTransform = painter.transform();
+        painter.scale(zoom, zoom);
+        painter.fillPath(*strokeOutline, strokeColor);
+        painter.setTransform(oldTransform);
+    }
     else
     {
-        if(!isHighlighter){
+        if(!m_isHighlighter){
             QPen pen;
-            pen.setColor(color);
-            if (pattern != solidLinePattern)
+            pen.setColor(strokeColor);
+            if (m_pattern != dashPattern::SolidLine)
             {
-                pen.setDashPattern(pattern);
+                pen.setDashPattern(pattern());
             }
             pen.setCapStyle(Qt::RoundCap);
             painter.setPen(pen);
 
             qreal dashOffset = 0.0;
-            for (int j = 1; j < points.length(); ++j)
+            for (int j = 1; j < n; ++j)
             {
-                qreal tmpPenWidth = zoom * penWidth * (pressures.at(j - 1) + pressures.at(j)) / 2.0;
-                if (pattern != solidLinePattern)
+                qreal tmpPenWidth = zoom * m_penWidth * (pressure(j - 1) + pressure(j)) / 2.0;
+                if (m_pattern != dashPattern::SolidLine)
                 {
                     pen.setDashOffset(dashOffset);
                 }
                 pen.setWidthF(tmpPenWidth);
                 painter.setPen(pen);
-                //                painter.drawLine(zoom * points.at(j-1), zoom * points.at(j));
                 if (last == false)
                 {
-                    painter.drawLine(zoom * points.at(j - 1), zoom * points.at(j));
+                    painter.drawLine(zoom * point(j - 1), zoom * point(j));
                 }
-                else if (last == true && j == points.length() - 1)
+                else if (last == true && j == n - 1)
                 {
-                    painter.drawLine(zoom * points.at(j - 1), zoom * points.at(j));
+                    painter.drawLine(zoom * point(j - 1), zoom * point(j));
                 }
 
                 if (tmpPenWidth != 0.0)
-                    dashOffset += 1.0 / tmpPenWidth * (QLineF(zoom * points.at(j - 1), zoom * points.at(j))).length();
+                    dashOffset += 1.0 / tmpPenWidth * (QLineF(zoom * point(j - 1), zoom * point(j))).length();
             }
         }
         else{
+            // the segments are drawn into a pixmap with QPainter::CompositionMode_Source first. Otherwise overlapping segments would be blended twice.
             QRectF bRect = boundingRect();
-            QRectF bRectZ(boundingRect().x()*zoom, boundingRect().y()*zoom, boundingRect().width()*zoom, boundingRect().height()*zoom);
-            if(tmpPixmap.rect().width() != bRectZ.width() || tmpPixmap.rect().height() != bRectZ.height()){
-                tmpPixmap = tmpPixmap.scaled(bRectZ.width(), bRectZ.height());
-            }
+            QRectF bRectZ(bRect.x()*zoom, bRect.y()*zoom, bRect.width()*zoom, bRect.height()*zoom);
+            QPixmap tmpPixmap(std::max(1, static_cast<int>(bRectZ.width())), std::max(1, static_cast<int>(bRectZ.height())));
             tmpPixmap.fill(QColor(0,0,0,0));
             QPainter tmpPainter;
             tmpPainter.begin(&tmpPixmap);
@@ -187,39 +199,37 @@ void Stroke::paint(QPainter &painter, qreal zoom, bool last)
             tmpPainter.setCompositionMode(QPainter::CompositionMode_Source);
             QPen pen;
 
-            pen.setColor(color);
-            if (pattern != solidLinePattern)
+            pen.setColor(strokeColor);
+            if (m_pattern != dashPattern::SolidLine)
             {
-                pen.setDashPattern(pattern);
+                pen.setDashPattern(pattern());
             }
             pen.setCapStyle(Qt::RoundCap);
             tmpPainter.setPen(pen);
 
             qreal dashOffset = 0.0;
-            for (int j = 1; j < points.length(); ++j)
+            QPointF upperLeftCorner(bRect.x(), bRect.y());
+            for (int j = 1; j < n; ++j)
             {
-                qreal tmpPenWidth = zoom * penWidth;
-                if (pattern != solidLinePattern)
+                qreal tmpPenWidth = zoom * m_penWidth;
+                if (m_pattern != dashPattern::SolidLine)
                 {
                     pen.setDashOffset(dashOffset);
                 }
                 pen.setWidthF(tmpPenWidth);
                 tmpPainter.setPen(pen);
-                //                painter.drawLine(zoom * points.at(j-1), zoom * points.at(j));
-                QPointF upperLeftCorner(bRect.x(), bRect.y());
                 if (last == false)
                 {
-                    tmpPainter.drawLine(zoom*(points.at(j - 1)-upperLeftCorner), zoom*(points.at(j)-upperLeftCorner));
+                    tmpPainter.drawLine(zoom*(point(j - 1)-upperLeftCorner), zoom*(point(j)-upperLeftCorner));
                 }
-                else if (last == true && j == points.length() - 1)
+                else if (last == true && j == n - 1)
                 {
-                    tmpPainter.drawLine(zoom*(points.at(j - 1)-upperLeftCorner), zoom*(points.at(j)-upperLeftCorner));
+                    tmpPainter.drawLine(zoom*(point(j - 1)-upperLeftCorner), zoom*(point(j)-upperLeftCorner));
                 }
 
                 if (tmpPenWidth != 0.0)
-                    dashOffset += 1.0 / tmpPenWidth * (QLineF(zoom * points.at(j - 1), zoom * points.at(j))).length();
+                    dashOffset += 1.0 / tmpPenWidth * (QLineF(zoom * point(j - 1), zoom * point(j))).length();
             }
-            //tmpPainter.setCompositionMode(QPainter::CompositionMode_SourceOver);
             tmpPainter.end();
             painter.drawPixmap(bRectZ.toRect(), tmpPixmap);
         }
@@ -230,27 +240,18 @@ void Stroke::paint(QPainter &painter, qreal zoom, bool last)
 QRectF Stroke::boundingRect() const
 {
     QRectF bRect = boundingRectSansPenWidth();
-    if(!isHighlighter){
-        qreal maxPressure = 0.0;
-        for (qreal p : pressures)
-        {
-            if (p > maxPressure)
-            {
-                maxPressure = p;
-            }
-        }
-        qreal pad = maxPressure * penWidth;
+    if(!m_isHighlighter){
+        qreal pad = m_maxPressure * m_penWidth;
         return bRect.adjusted(-pad, -pad, pad, pad);
     }
     else{
-        return bRect.adjusted(-penWidth, -penWidth, penWidth, penWidth);
+        return bRect.adjusted(-m_penWidth, -m_penWidth, m_penWidth, m_penWidth);
     }
 }
 
 QRectF Stroke::boundingRectSansPenWidth() const
 {
-  QPolygonF tmpPoints = points;
-  QRectF bRect = tmpPoints.boundingRect();
+  QRectF bRect = m_pointsRect;
   if (bRect.isNull())
   {
     qreal ad = 0.0001;
@@ -258,4 +259,464 @@ QRectF Stroke::boundingRectSansPenWidth() const
   }
   return bRect;
 }
+
+qreal Stroke::maxPressure() const
+{
+  return m_maxPressure;
+}
+
+qreal Stroke::length() const
+{
+  return m_length;
+}
+
+std::shared_ptr<const QPainterPath> Stroke::outline() const
+{
+  std::shared_ptr<const QPainterPath> strokeOutline = std::atomic_load(&m_outline);
+  if (!strokeOutline)
+  {
+    strokeOutline = std::make_shared<const QPainterPath>(buildOutline());
+    std::atomic_store(&m_outline, strokeOutline);
+  }
+  return strokeOutline;
+}
+
+QPainterPath Stroke::exportOutline() const
+{
+  if (size() < 2 || m_pattern == dashPattern::SolidLine)
+  {
+    return *outline();
+  }
+
+  QPainterPath polyline;
+  polyline.moveTo(point(0));
+  qreal pressureSum = pressure(0);
+  for (int i = 1; i < size(); ++i)
+  {
+    polyline.lineTo(point(i));
+    pressureSum += pressure(i);
+  }
+  QPainterPathStroker stroker;
+  stroker.setWidth(m_isHighlighter ? m_penWidth : m_penWidth * pressureSum / size());
+  stroker.setCapStyle(Qt::RoundCap);
+  stroker.setJoinStyle(Qt::RoundJoin);
+  stroker.setDashPattern(pattern());
+  return stroker.createStroke(polyline);
+}
+
+QPainterPath Stroke::buildOutline() const
+{
+  QPainterPath path;
+  path.setFillRule(Qt::WindingFill);
+  if (isEmpty())
+  {
+    return path;
+  }
+
+  // duplicate points would give segments without a direction
+  QVector<QPointF> points;
+  QVector<qreal> radii;
+  points.reserve(size());
+  radii.reserve(size());
+  for (int i = 0; i < size(); ++i)
+  {
+    qreal r = m_isHighlighter ? m_penWidth / 2.0 : m_penWidth * pressure(i) / 2.0;
+    if (!points.isEmpty() && points.last() == point(i))
+    {
+      radii.last() = std::max(radii.last(), r);
+      continue;
+    }
+    points.append(point(i));
+    radii.append(r);
+  }
+  addOutline(path, points, radii);
+  return path;
+}
+
+void Stroke::addOutline(QPainterPath &path, const QVector<QPointF> &points, const QVector<qreal> &radii)
+{
+  // addEllipse runs clockwise on the screen, and so do the contours below: they go forward along the -normal side and back along the
+  // +normal side. Otherwise overlapping parts would cancel out with Qt::WindingFill.
+  auto addCircle = [&path](const QPointF &center, qreal r) {
+    if (r > 0.0)
+    {
+      path.addEllipse(center, r, r);
+    }
+  };
+
+  int n = points.size();
+  addCircle(points.first(), radii.first());
+  if (n == 1)
+  {
+    return;
+  }
+
+  QVector<QPointF> directions(n - 1);
+  QVector<QPointF> normals(n - 1);
+  for (int j = 0; j < n - 1; ++j)
+  {
+    QPointF delta = points.at(j + 1) - points.at(j);
+    directions[j] = delta / sqrt(QPointF::dotProduct(delta, delta));
+    normals[j] = QPointF(-directions.at(j).y(), directions.at(j).x());
+  }
+
+  // Where the stroke bends only slightly, the quads of both segments share the mitred edge at their common point, so they are merged into
+  // one contour. At sharp corners the contour is split and a round join is added instead.
+  QVector<bool> isJoin(n, false);
+  QVector<QPointF> miters(n);
+  isJoin[0] = true;
+  isJoin[n - 1] = true;
+  for (int i = 1; i < n - 1; ++i)
+  {
+    if (QPointF::dotProduct(directions.at(i - 1), directions.at(i)) < maxMiterCos)
+    {
+      isJoin[i] = true;
+      continue;
+    }
+    QPointF miter = normals.at(i - 1) + normals.at(i);
+    miters[i] = miter / QPointF::dotProduct(miter, normals.at(i));
+  }
+  auto startOffset = [&](int j) { return radii.at(j) * (isJoin.at(j) ? normals.at(j) : miters.at(j)); };
+  auto endOffset = [&](int j) { return radii.at(j + 1) * (isJoin.at(j + 1) ? normals.at(j) : miters.at(j + 1)); };
+
+  // A contour is the sum of its quads, so it covers the union of them as long as no quad is folded. Short segments at a bend can fold the
+  // inner side of their quad, their points become joins as well. With joins at both ends a quad is a trapezoid, so this terminates.
+  bool changed = true;
+  while (changed)
+  {
+    changed = false;
+    for (int j = 0; j < n - 1; ++j)
+    {
+      if (isJoin.at(j) && isJoin.at(j + 1))
+      {
+        continue;
+      }
+      QPointF a = points.at(j);
+      QPointF b = points.at(j + 1);
+      QPointF left = (b + endOffset(j)) - (a + startOffset(j));
+      QPointF right = (b - endOffset(j)) - (a - startOffset(j));
+      if (QPointF::dotProduct(left, directions.at(j)) <= 0.0 || QPointF::dotProduct(right, directions.at(j)) <= 0.0)
+      {
+        isJoin[j] = true;
+        isJoin[j + 1] = true;
+        changed = true;
+      }
+    }
+  }
+
+  int first = 0;
+  for (int last = 1; last < n; ++last)
+  {
+    if (!isJoin.at(last))
+    {
+      continue;
+    }
+    path.moveTo(points.at(first) - startOffset(first));
+    for (int j = first; j < last; ++j)
+    {
+      path.lineTo(points.at(j + 1) - endOffset(j));
+    }
+    for (int j = last - 1; j >= first; --j)
+    {
+      path.lineTo(points.at(j + 1) + endOffset(j));
+    }
+    path.lineTo(points.at(first) + startOffset(first));
+    path.closeSubpath();
+    addCircle(points.at(last), radii.at(last));
+    first = last;
+  }
+}
+
+void Stroke::invalidateOutline()
+{
+  std::atomic_store(&m_outline, std::shared_ptr<const QPainterPath>());
+}
+
+int Stroke::size() const
+{
+  return m_pressures.size();
+}
+
+bool Stroke::isEmpty() const
+{
+  return m_pressures.isEmpty();
+}
+
+QPointF Stroke::point(int i) const
+{
+  return QPointF(m_coordinates.at(2 * i), m_coordinates.at(2 * i + 1));
+}
+
+qreal Stroke::pressure(int i) const
+{
+  return m_pressures.at(i) / pressureScale;
+}
+
+QPolygonF Stroke::points() const
+{
+  QPolygonF points;
+  points.reserve(size());
+  for (int i = 0; i < size(); ++i)
+  {
+    points.append(point(i));
+  }
+  return points;
+}
+
+QVector<qreal> Stroke::pressures() const
+{
+  QVector<qreal> pressures;
+  pressures.reserve(size());
+  for (int i = 0; i < size(); ++i)
+  {
+    pressures.append(pressure(i));
+  }
+  return pressures;
+}
+
+void Stroke::setPoints(const QPolygonF &points, const QVector<qreal> &pressures)
+{
+  m_coordinates.resize(2 * points.size());
+  m_pressures.resize(points.size());
+  for (int i = 0; i < points.size(); ++i)
+  {
+    m_coordinates[2 * i] = static_cast<float>(points.at(i).x());
+    m_coordinates[2 * i + 1] = static_cast<float>(points.at(i).y());
+    m_pressures[i] = quantizePressure(i < pressures.size() ? pressures.at(i) : 1.0);
+  }
+  m_coordinates.squeeze();
+  m_pressures.squeeze();
+  updateGeometry();
+  invalidateOutline();
+}
+
+const QVector<float> &Stroke::packedCoordinates() const
+{
+  return m_coordinates;
+}
+
+const QVector<quint16> &Stroke::packedPressures() const
+{
+  return m_pressures;
+}
+
+bool Stroke::setPackedPoints(const QVector<float> &coordinates, const QVector<quint16> &pressures)
+{
+  if (coordinates.size() != 2 * pressures.size())
+  {
+    return false;
+  }
+  m_coordinates = coordinates;
+  m_pressures = pressures;
+  updateGeometry();
+  invalidateOutline();
+  return true;
+}
+
+void Stroke::appendPoint(const QPointF &point, qreal pressure)
+{
+  m_coordinates.append(static_cast<float>(point.x()));
+  m_coordinates.append(static_cast<float>(point.y()));
+  m_pressures.append(quantizePressure(pressure));
+
+  // the cached geometry is computed from the stored (rounded) values
+  int n = size();
+  QPointF storedPoint = this->point(n - 1);
+  qreal storedPressure = this->pressure(n - 1);
+  if (n == 1)
+  {
+    m_pointsRect = QRectF(storedPoint, QSizeF(0.0, 0.0));
+    m_maxPressure = storedPressure;
+  }
+  else
+  {
+    m_pointsRect.setLeft(std::min(m_pointsRect.left(), storedPoint.x()));
+    m_pointsRect.setRight(std::max(m_pointsRect.right(), storedPoint.x()));
+    m_pointsRect.setTop(std::min(m_pointsRect.top(), storedPoint.y()));
+    m_pointsRect.setBottom(std::max(m_pointsRect.bottom(), storedPoint.y()));
+    m_maxPressure = std::max(m_maxPressure, storedPressure);
+    m_length += QLineF(this->point(n - 2), storedPoint).length();
+  }
+  invalidateOutline();
+}
+
+void Stroke::removePointAt(int i)
+{
+  m_coordinates.remove(2 * i, 2);
+  m_pressures.removeAt(i);
+  updateGeometry();
+  invalidateOutline();
+}
+
+void Stroke::clearPoints()
+{
+  m_coordinates.clear();
+  m_pressures.clear();
+  updateGeometry();
+  invalidateOutline();
+}
+
+void Stroke::removeDuplicatePoints()
+{
+  int n = size();
+  int kept = 0;
+  for (int i = 0; i < n; ++i)
+  {
+    if (kept > 0 && m_coordinates.at(2 * i) == m_coordinates.at(2 * (kept - 1)) && m_coordinates.at(2 * i + 1) == m_coordinates.at(2 * (kept - 1) + 1))
+    {
+      continue;
+    }
+    if (kept != i)
+    {
+      m_coordinates[2 * kept] = m_coordinates.at(2 * i);
+      m_coordinates[2 * kept + 1] = m_coordinates.at(2 * i + 1);
+      m_pressures[kept] = m_pressures.at(i);
+    }
+    ++kept;
+  }
+  if (kept != n)
+  {
+    m_coordinates.resize(2 * kept);
+    m_pressures.resize(kept);
+    updateGeometry();
+    invalidateOutline();
+  }
+}
+
+void Stroke::translate(const QPointF &offset)
+{
+  for (int i = 0; i < m_coordinates.size(); i += 2)
+  {
+    m_coordinates[i] += static_cast<float>(offset.x());
+    m_coordinates[i + 1] += static_cast<float>(offset.y());
+  }
+  updateGeometry();
+  invalidateOutline();
+}
+
+void Stroke::transform(const QTransform &transform)
+{
+  for (int i = 0; i < m_coordinates.size(); i += 2)
+  {
+    QPointF mappedPoint = transform.map(QPointF(m_coordinates.at(i), m_coordinates.at(i + 1)));
+    m_coordinates[i] = static_cast<float>(mappedPoint.x());
+    m_coordinates[i + 1] = static_cast<float>(mappedPoint.y());
+  }
+  updateGeometry();
+  invalidateOutline();
+}
+
+const QVector<qreal> &Stroke::pattern() const
+{
+  switch (m_pattern)
+  {
+  case dashPattern::DashLine:
+    return dashLinePattern;
+  case dashPattern::DashDotLine:
+    return dashDotLinePattern;
+  case dashPattern::DotLine:
+    return dotLinePattern;
+  default:
+    return solidLinePattern;
+  }
+}
+
+void Stroke::setPattern(const QVector<qreal> &pattern)
+{
+  if (pattern == dashLinePattern)
+  {
+    m_pattern = dashPattern::DashLine;
+  }
+  else if (pattern == dashDotLinePattern)
+  {
+    m_pattern = dashPattern::DashDotLine;
+  }
+  else if (pattern == dotLinePattern)
+  {
+    m_pattern = dashPattern::DotLine;
+  }
+  else
+  {
+    m_pattern = dashPattern::SolidLine;
+  }
+}
+
+qreal Stroke::penWidth() const
+{
+  return m_penWidth;
+}
+
+void Stroke::setPenWidth(qreal penWidth)
+{
+  m_penWidth = penWidth;
+  invalidateOutline();
+}
+
+QColor Stroke::color() const
+{
+  return QColor::fromRgba(m_color);
+}
+
+QRgb Stroke::rgba() const
+{
+  return m_color;
+}
+
+void Stroke::setColor(const QColor &color)
+{
+  m_color = color.rgba();
+}
+
+bool Stroke::isHighlighter() const
+{
+  return m_isHighlighter;
+}
+
+void Stroke::setHighlighter(bool isHighlighter)
+{
+  m_isHighlighter = isHighlighter;
+  invalidateOutline();
+}
+
+quint16 Stroke::quantizePressure(qreal pressure)
+{
+  return static_cast<quint16>(qRound(qBound(0.0, pressure, 65535.0 / pressureScale) * pressureScale));
+}
+
+void Stroke::updateGeometry()
+{
+  m_pointsRect = QRectF();
+  m_maxPressure = 0.0;
+  m_length = 0.0;
+  int n = size();
+  if (n == 0)
+  {
+    return;
+  }
+
+  qreal left = m_coordinates.at(0);
+  qreal right = left;
+  qreal top = m_coordinates.at(1);
+  qreal bottom = top;
+  for (int i = 0; i < n; ++i)
+  {
+    QPointF p = point(i);
+    left = std::min(left, p.x());
+    right = std::max(right, p.x());
+    top = std::min(top, p.y());
+    bottom = std::max(bottom, p.y());
+    if (i > 0)
+    {
+      m_length += QLineF(point(i - 1), p).length();
+    }
+  }
+  m_pointsRect = QRectF(QPointF(left, top), QPointF(right, bottom));
+
+  quint16 maxPressure = 0;
+  for (quint16 p : m_pressures)
+  {
+    maxPressure = std::max(maxPressure, p);
+  }
+  m_maxPressure = maxPressure / pressureScale;
+}
 }
@@ -3,6 +3,7 @@
 
 #include <QObject>
 #include <QPainter>
+#include <QPainterPath>
 #include <QVector>
 #include <QVector2D>
 #include <QPixmap>
@@ -10,31 +11,175 @@
 
 #include "mrdoc.h"
 
+#include <memory>
+
 namespace MrDoc
 {
 
 /**
- * @brief The Stroke struct
- * @todo turn this into a class. make sure, points and pressures are of the same length using a setter
+ * @brief The Stroke class is a polyline with a pressure per point.
+ * @details Points and pressures can only be changed together, so they always have the same length. The bounding rect, the maximal pressure and the
+ * length of the stroke are cached and kept up to date by every function changing the points, so querying them is cheap.
+ *
+ * To keep large documents small in memory, the coordinates are stored as interleaved floats and the pressures are quantized to 16 bit
+ * (@ref pressureScale steps per unit), i.e. a point takes 10 bytes instead of 24. The dash pattern is stored as an index into the standard
+ * patterns and the color as QRgb.
  */
-struct Stroke
+class Stroke
 {
 public:
   Stroke();
-  //    enum class dashPattern { SolidLine, DashLine, DashDotLine, DotLine };
-  void paint(QPainter &painter, qreal zoom, bool last = false);
+  void paint(QPainter &painter, qreal zoom, bool last = false) const;
 
+  /**
+   * @brief boundingRect
+   * @return bounding rect of the points, padded by the pen width
+   */
   QRectF boundingRect() const;
+  /**
+   * @brief boundingRectSansPenWidth
+   * @return bounding rect of the points. It is never null, even if the stroke consists of a single point.
+   */
   QRectF boundingRectSansPenWidth() const;
+  /**
+   * @brief maxPressure
+   * @return the largest pressure of all points or 0.0 if the stroke is empty
+   */
+  qreal maxPressure() const;
+  /**
+   * @brief length
+   * @return the arc length of the stroke (zoom factor 1)
+   */
+  qreal length() const;
+  /**
+   * @brief outline
+   * @return the filled outline of the stroke (zoom factor 1), built from the points and pressures when it is needed for the first time. It is
+   * cached until the points or the pen width change, and it is safe to call from several threads.
+   */
+  std::shared_ptr<const QPainterPath> outline() const;
+  /**
+   * @brief exportOutline
+   * @return the filled outline for vector export (zoom factor 1). For solid strokes it is @ref outline. Dashed strokes are outlined with
+   * their dashes, at the mean pressure of the stroke.
+   */
+  QPainterPath exportOutline() const;
+
+  int size() const;
+  bool isEmpty() const;
+  QPointF point(int i) const;
+  qreal pressure(int i) const;
+  /**
+   * @brief points
+   * @return a copy of all points. Use @ref point in loops, it does not allocate.
+   */
+  QPolygonF points() const;
+  /**
+   * @brief pressures
+   * @return a copy of all pressures. Use @ref pressure in loops, it does not allocate.
+   */
+  QVector<qreal> pressures() const;
+
+  /**
+   * @brief setPoints replaces all points of the stroke. If there are less pressures than points, the missing pressures are set to 1.0. Surplus
+   * pressures are dropped.
+   * @param points
+   * @param pressures
+   */
+  void setPoints(const QPolygonF &points, const QVector<qreal> &pressures);
+  /**
+   * @brief packedCoordinates
+   * @return the coordinates as they are stored (x and y of every point, interleaved). Together with @ref packedPressures this is the packed form
+   * written by the binary file format.
+   */
+  const QVector<float> &packedCoordinates() const;
+  /**
+   * @brief packedPressures
+   * @return the pressures as they are stored, i.e. multiplied by @ref pressureScale
+   */
+  const QVector<quint16> &packedPressures() const;
+  /**
+   * @brief setPackedPoints replaces all points by their packed form
+   * @param coordinates see @ref packedCoordinates
+   * @param pressures see @ref packedPressures
+   * @return false (and the stroke is unchanged) if there are not exactly two coordinates per pressure
+   */
+  bool setPackedPoints(const QVector<float> &coordinates, const QVector<quint16> &pressures);
+  void appendPoint(const QPointF &point, qreal pressure);
+  void removePointAt(int i);
+  void clearPoints();
+  /**
+   * @brief removeDuplicatePoints removes points which are equal to their predecessor
+   */
+  void removeDuplicatePoints();
+  void translate(const QPointF &offset);
+  void transform(const QTransform &transform);
+
+  /**
+   * @brief pattern
+   * @return one of the standard patterns defined in mrdoc.h
+   */
+  const QVector<qreal> &pattern() const;
+  /**
+   * @brief setPattern sets the dash pattern. Patterns other than the standard patterns defined in mrdoc.h are replaced by a solid line.
+   * @param pattern
+   */
+  void setPattern(const QVector<qreal> &pattern);
+
+  qreal penWidth() const;
+  void setPenWidth(qreal penWidth);
+
+  QColor color() const;
+  QRgb rgba() const;
+  void setColor(const QColor &color);
+
+  bool isHighlighter() const;
+  void setHighlighter(bool isHighlighter);
+
+  static constexpr qreal pressureScale = 10000.0; /**< quantization steps per unit of pressure. Pressures are limited to [0, 6.5535]. */
+  static constexpr qreal maxMiterCos = 0.866; /**< segments turning by more than 30 degrees get a round join instead of a mitred edge */
+
+private:
+  enum class dashPattern : quint8
+  {
+    SolidLine,
+    DashLine,
+    DashDotLine,
+    DotLine
+  };
+
+  static quint16 quantizePressure(qreal pressure);
+
+  /**
+   * @brief updateGeometry recomputes @ref m_pointsRect, @ref m_maxPressure and @ref m_length from scratch
+   */
+  void updateGeometry();
+  /**
+   * @brief buildOutline builds the area covered by drawing the segments with round caps, the width between two points being interpolated
+   * linearly
+   */
+  QPainterPath buildOutline() const;
+  /**
+   * @brief addOutline adds the outline of a polyline to @param path: one contour per run of slightly bent segments, and a circle per cap and
+   * sharp corner. All subpaths run clockwise on the screen, like QPainterPath::addEllipse, so @param path has to be filled with
+   * Qt::WindingFill.
+   * @param points without duplicates
+   * @param radii half the width at every point
+   */
+  static void addOutline(QPainterPath &path, const QVector<QPointF> &points, const QVector<qreal> &radii);
+  void invalidateOutline();
+
+  QVector<float> m_coordinates; /**< x and y of every point, interleaved */
+  QVector<quint16> m_pressures; /**< pressures multiplied by @ref pressureScale */
+  qreal m_penWidth = 1.0;
+  QRgb m_color = qRgba(0, 0, 0, 255);
+  dashPattern m_pattern = dashPattern::SolidLine;
+  bool m_isHighlighter = false;
+
+  QRectF m_pointsRect;       /**< bounding rect of the points, may have zero width or height */
+  qreal m_maxPressure = 0.0; /**< maximum of the pressures */
+  qreal m_length = 0.0;      /**< sum of the lengths of all segments */
 
-  QPolygonF points;
-  QVector<qreal> pressures;
-  QVector<qreal> pattern;
-  qreal penWidth;
-  QColor color;
-  QPixmap tmpPixmap =QPixmap(1,1); /**< this is only for highlighter strokes, not for normal ones. It is necessary to be able to use QPainter::CompositionMode_Source.
-                                     Otherwise the stroke points are drawn twice*/
-  bool isHighlighter = false;
+  mutable std::shared_ptr<const QPainterPath> m_outline; /**< cached result of @ref buildOutline, accessed with std::atomic_load and std::atomic_store */
 };
 }
 
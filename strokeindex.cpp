@@ -0,0 +1,216 @@
+#include "strokeindex.h"
+
+#include <algorithm>
+#include <math.h>
+
+namespace MrDoc
+{
+
+StrokeIndex::StrokeIndex() : d{new Data}
+{
+}
+
+void StrokeIndex::insert(int position, const QRectF &rect)
+{
+  int id;
+  if (d->freeIds.isEmpty())
+  {
+    id = d->rects.size();
+    d->rects.append(rect.normalized());
+    d->positionOfId.append(position);
+  }
+  else
+  {
+    id = d->freeIds.takeLast();
+    d->rects[id] = rect.normalized();
+  }
+  d->idOfPosition.insert(position, id);
+  renumber(position);
+  addToCells(id);
+}
+
+void StrokeIndex::append(const QRectF &rect)
+{
+  insert(d->idOfPosition.size(), rect);
+}
+
+void StrokeIndex::remove(int position)
+{
+  int id = d->idOfPosition[position];
+  removeFromCells(id);
+  d->idOfPosition.removeAt(position);
+  renumber(position);
+  d->positionOfId[id] = -1;
+  d->freeIds.append(id);
+}
+
+void StrokeIndex::update(int position, const QRectF &rect)
+{
+  int id = d->idOfPosition[position];
+  removeFromCells(id);
+  d->rects[id] = rect.normalized();
+  addToCells(id);
+}
+
+void StrokeIndex::clear()
+{
+  // a shared index is not copied just to be cleared
+  d = new Data;
+}
+
+int StrokeIndex::size() const
+{
+  return d->idOfPosition.size();
+}
+
+QVector<int> StrokeIndex::query(const QRectF &rect) const
+{
+  QVector<int> positions;
+  QRectF queryRect = rect.normalized();
+  CellRange range = cellRange(queryRect);
+
+  if (isOversized(range))
+  {
+    // the query covers (almost) the whole page, so testing every stroke is cheaper than visiting every cell
+    for (int i = 0; i < d->idOfPosition.size(); ++i)
+    {
+      if (intersects(d->rects[d->idOfPosition[i]], queryRect))
+      {
+        positions.append(i);
+      }
+    }
+    return positions;
+  }
+
+  for (int y = range.beginY; y < range.endY; ++y)
+  {
+    for (int x = range.beginX; x < range.endX; ++x)
+    {
+      auto cellIter = d->cells.find(cellKey(x, y));
+      if (cellIter == d->cells.end())
+      {
+        continue;
+      }
+      for (int id : cellIter->second)
+      {
+        if (intersects(d->rects[id], queryRect))
+        {
+          positions.append(d->positionOfId[id]);
+        }
+      }
+    }
+  }
+  for (int id : d->oversized)
+  {
+    if (intersects(d->rects[id], queryRect))
+    {
+      positions.append(d->positionOfId[id]);
+    }
+  }
+
+  // strokes touching several cells are found several times
+  std::sort(positions.begin(), positions.end());
+  positions.erase(std::unique(positions.begin(), positions.end()), positions.end());
+  return positions;
+}
+
+QVector<int> StrokeIndex::query(const QPolygonF &polygon) const
+{
+  if (polygon.isEmpty())
+  {
+    return QVector<int>();
+  }
+  return query(polygon.boundingRect());
+}
+
+StrokeIndex::CellRange StrokeIndex::cellRange(const QRectF &rect)
+{
+  CellRange range;
+  qreal beginX = floor(rect.left() / cellSize);
+  qreal beginY = floor(rect.top() / cellSize);
+  qreal endX = floor(rect.right() / cellSize) + 1;
+  qreal endY = floor(rect.bottom() / cellSize) + 1;
+
+  if (!std::isfinite(beginX) || !std::isfinite(beginY) || !std::isfinite(endX) || !std::isfinite(endY) ||
+      (endX - beginX) * (endY - beginY) > maxCellsPerStroke)
+  {
+    range.beginX = range.beginY = 0;
+    range.endX = range.endY = maxCellsPerStroke + 1;
+    return range;
+  }
+
+  range.beginX = static_cast<int>(beginX);
+  range.beginY = static_cast<int>(beginY);
+  range.endX = static_cast<int>(endX);
+  range.endY = static_cast<int>(endY);
+  return range;
+}
+
+qint64 StrokeIndex::cellKey(int x, int y)
+{
+  return (static_cast<qint64>(x) << 32) | static_cast<quint32>(y);
+}
+
+bool StrokeIndex::intersects(const QRectF &a, const QRectF &b)
+{
+  // unlike QRectF::intersects, rects with zero width or height (e.g. horizontal lines) are not treated as empty
+  return a.left() <= b.right() && b.left() <= a.right() && a.top() <= b.bottom() && b.top() <= a.bottom();
+}
+
+bool StrokeIndex::isOversized(const CellRange &range)
+{
+  return static_cast<qint64>(range.endX - range.beginX) * (range.endY - range.beginY) > maxCellsPerStroke;
+}
+
+void StrokeIndex::addToCells(int id)
+{
+  CellRange range = cellRange(d->rects[id]);
+  if (isOversized(range))
+  {
+    d->oversized.append(id);
+    return;
+  }
+  for (int y = range.beginY; y < range.endY; ++y)
+  {
+    for (int x = range.beginX; x < range.endX; ++x)
+    {
+      d->cells[cellKey(x, y)].append(id);
+    }
+  }
+}
+
+void StrokeIndex::removeFromCells(int id)
+{
+  CellRange range = cellRange(d->rects[id]);
+  if (isOversized(range))
+  {
+    d->oversized.removeOne(id);
+    return;
+  }
+  for (int y = range.beginY; y < range.endY; ++y)
+  {
+    for (int x = range.beginX; x < range.endX; ++x)
+    {
+      auto cellIter = d->cells.find(cellKey(x, y));
+      if (cellIter == d->cells.end())
+      {
+        continue;
+      }
+      cellIter->second.removeOne(id);
+      if (cellIter->second.isEmpty())
+      {
+        d->cells.erase(cellIter);
+      }
+    }
+  }
+}
+
+void StrokeIndex::renumber(int position)
+{
+  // appending and removing the last stroke (the common case while writing and undoing) renumber at most one stroke
+  for (int i = position; i < d->idOfPosition.size(); ++i)
+  {
+    d->positionOfId[d->idOfPosition[i]] = i;
+  }
+}
+}
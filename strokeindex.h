@@ -0,0 +1,97 @@
+#ifndef STROKEINDEX_H
+#define STROKEINDEX_H
+
+#include <QPolygonF>
+#include <QRectF>
+#include <QSharedData>
+#include <QSharedDataPointer>
+#include <QVector>
+#include <unordered_map>
+
+namespace MrDoc
+{
+
+/**
+ * @brief The StrokeIndex class is a uniform grid over the bounding rects of the strokes of a page.
+ * @details Callers identify strokes by their position in the stroke vector of the page, so the index has to be told about every insertion and
+ * removal. Internally the grid stores stable stroke ids, so an insertion or removal only renumbers the positions behind it and does not touch
+ * the grid cells.
+ * Queries only visit the grid cells covered by the query rect, so their cost depends on the number of strokes near the rect and not on the
+ * number of strokes on the page. The index is implicitly shared like the stroke vector, so copying a page (e.g. for a snapshot which is saved
+ * by a worker thread) does not copy the grid.
+ */
+class StrokeIndex
+{
+public:
+  StrokeIndex();
+
+  /**
+   * @brief insert adds a stroke at @param position and shifts all strokes behind it
+   * @param position
+   * @param rect bounding rect of the stroke
+   */
+  void insert(int position, const QRectF &rect);
+  void append(const QRectF &rect);
+  /**
+   * @brief remove removes the stroke at @param position and shifts all strokes behind it
+   */
+  void remove(int position);
+  /**
+   * @brief update changes the bounding rect of the stroke at @param position
+   */
+  void update(int position, const QRectF &rect);
+  void clear();
+  int size() const;
+
+  /**
+   * @brief query
+   * @param rect
+   * @return positions of all strokes whose bounding rect intersects @param rect in ascending order
+   */
+  QVector<int> query(const QRectF &rect) const;
+  /**
+   * @brief query
+   * @param polygon
+   * @return positions of all strokes whose bounding rect intersects the bounding rect of @param polygon in ascending order. The caller has to
+   * test the points of the strokes against the polygon itself.
+   */
+  QVector<int> query(const QPolygonF &polygon) const;
+
+  static constexpr qreal cellSize = 64.0;  /**< edge length of a grid cell in post script units */
+  static constexpr int maxCellsPerStroke = 256; /**< strokes covering more cells are kept in Data::oversized */
+
+private:
+  struct CellRange
+  {
+    int beginX;
+    int beginY;
+    int endX;
+    int endY;
+  };
+
+  static CellRange cellRange(const QRectF &rect);
+  static qint64 cellKey(int x, int y);
+  static bool intersects(const QRectF &a, const QRectF &b);
+  static bool isOversized(const CellRange &range);
+
+  void addToCells(int id);
+  void removeFromCells(int id);
+  /**
+   * @brief renumber updates the position of every stroke from @param position to the end
+   */
+  void renumber(int position);
+
+  struct Data : public QSharedData
+  {
+    std::unordered_map<qint64, QVector<int>> cells; /**< ids of the strokes touching a cell */
+    QVector<int> oversized;                          /**< ids of strokes too large for the grid */
+    QVector<QRectF> rects;                           /**< bounding rect of every stroke by id */
+    QVector<int> idOfPosition;                       /**< id of the stroke at every position */
+    QVector<int> positionOfId;                       /**< position of every stroke by id, -1 for unused ids */
+    QVector<int> freeIds;                            /**< ids of removed strokes, reused by the next insertion */
+  };
+  QSharedDataPointer<Data> d;
+};
+}
+
+#endif // STROKEINDEX_H
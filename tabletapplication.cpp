@@ -40,6 +40,14 @@ bool TabletApplication::event(QEvent *event)
     {
       success = newWindow->loadMOJ(fileName);
     }
+    else if (fileNameSplitted.last().compare(QString("mojb"), Qt::CaseInsensitive) == 0)
+    {
+      success = newWindow->loadMOJB(fileName);
+    }
+    else if (fileNameSplitted.last().compare(QString("mojt"), Qt::CaseInsensitive) == 0)
+    {
+      success = newWindow->loadMOJT(fileName);
+    }
 
     if (success)
     {
@@ -0,0 +1,173 @@
+#include "tilecache.h"
+
+#include <QMutexLocker>
+#include <math.h>
+
+TileCache::TileCache()
+{
+}
+
+std::shared_ptr<QImage> TileCache::tile(const TileKey &key)
+{
+  QMutexLocker locker(&m_mutex);
+  auto tileIter = m_tiles.find(key);
+  if (tileIter == m_tiles.end())
+  {
+    ++m_statistics.misses;
+    return std::shared_ptr<QImage>(nullptr);
+  }
+  ++m_statistics.hits;
+  m_lru.splice(m_lru.begin(), m_lru, tileIter->second.lruPos);
+  return tileIter->second.image;
+}
+
+bool TileCache::contains(const TileKey &key)
+{
+  QMutexLocker locker(&m_mutex);
+  return m_tiles.find(key) != m_tiles.end();
+}
+
+void TileCache::insert(const TileKey &key, std::shared_ptr<QImage> image)
+{
+  QMutexLocker locker(&m_mutex);
+  auto tileIter = m_tiles.find(key);
+  if (tileIter != m_tiles.end())
+  {
+    erase(tileIter);
+  }
+
+  m_lru.push_front(key);
+  Entry entry;
+  entry.image = image;
+  entry.lruPos = m_lru.begin();
+  m_tiles.insert({key, entry});
+  m_statistics.bytes += image->sizeInBytes();
+  m_statistics.tiles = static_cast<int>(m_tiles.size());
+
+  evict(key);
+}
+
+void TileCache::remove(const TileKey &key)
+{
+  QMutexLocker locker(&m_mutex);
+  auto tileIter = m_tiles.find(key);
+  if (tileIter != m_tiles.end())
+  {
+    erase(tileIter);
+  }
+}
+
+void TileCache::removePage(int pageNum)
+{
+  QMutexLocker locker(&m_mutex);
+  for (auto tileIter = m_tiles.begin(); tileIter != m_tiles.end();)
+  {
+    if (tileIter->first.pageNum == pageNum)
+    {
+      auto nextIter = std::next(tileIter);
+      erase(tileIter);
+      tileIter = nextIter;
+    }
+    else
+    {
+      ++tileIter;
+    }
+  }
+}
+
+void TileCache::clear()
+{
+  QMutexLocker locker(&m_mutex);
+  m_tiles.clear();
+  m_lru.clear();
+  m_statistics.bytes = 0;
+  m_statistics.tiles = 0;
+}
+
+void TileCache::setBudget(qint64 bytes)
+{
+  QMutexLocker locker(&m_mutex);
+  m_budget = std::max(bytes, minBudget);
+  if (!m_lru.empty())
+  {
+    evict(m_lru.front());
+  }
+}
+
+qint64 TileCache::budget()
+{
+  QMutexLocker locker(&m_mutex);
+  return m_budget;
+}
+
+TileCache::Statistics TileCache::statistics()
+{
+  QMutexLocker locker(&m_mutex);
+  return m_statistics;
+}
+
+void TileCache::erase(std::unordered_map<TileKey, Entry, TileKeyHash, TileKeyEqual>::iterator tileIter)
+{
+  m_statistics.bytes -= tileIter->second.image->sizeInBytes();
+  m_lru.erase(tileIter->second.lruPos);
+  m_tiles.erase(tileIter);
+  m_statistics.tiles = static_cast<int>(m_tiles.size());
+}
+
+void TileCache::evict(const TileKey &keep)
+{
+  TileKeyEqual equal;
+  while (m_statistics.bytes > m_budget && !m_lru.empty() && !equal(m_lru.back(), keep))
+  {
+    erase(m_tiles.find(m_lru.back()));
+    ++m_statistics.evictions;
+  }
+}
+
+QRect TileCache::tileRect(const TileKey &key)
+{
+  return QRect(key.x * TILE_SIZE, key.y * TILE_SIZE, TILE_SIZE, TILE_SIZE);
+}
+
+QRect TileCache::tileRect(const TileKey &key, const QSizeF &pageSize, qreal devicePixelRatio)
+{
+  QRect pageDeviceRect(0, 0, static_cast<int>(ceil(pageSize.width() * key.zoom * devicePixelRatio)),
+                       static_cast<int>(ceil(pageSize.height() * key.zoom * devicePixelRatio)));
+  return tileRect(key).intersected(pageDeviceRect);
+}
+
+TileKey TileCache::backgroundKey(const TileKey &key)
+{
+  TileKey backgroundKey = key;
+  backgroundKey.layer = TileLayer::BACKGROUND;
+  return backgroundKey;
+}
+
+QVector<TileKey> TileCache::tilesInRect(int pageNum, qreal zoom, const QRectF &deviceRect)
+{
+  QVector<TileKey> keys;
+  if (deviceRect.isEmpty())
+  {
+    return keys;
+  }
+
+  int beginX = std::max(0, static_cast<int>(floor(deviceRect.left() / TILE_SIZE)));
+  int beginY = std::max(0, static_cast<int>(floor(deviceRect.top() / TILE_SIZE)));
+  int endX = static_cast<int>(ceil(deviceRect.right() / TILE_SIZE));
+  int endY = static_cast<int>(ceil(deviceRect.bottom() / TILE_SIZE));
+
+  for (int y = beginY; y < endY; ++y)
+  {
+    for (int x = beginX; x < endX; ++x)
+    {
+      TileKey key;
+      key.pageNum = pageNum;
+      key.zoom = zoom;
+      key.x = x;
+      key.y = y;
+      key.layer = TileLayer::PAGE;
+      keys.append(key);
+    }
+  }
+  return keys;
+}
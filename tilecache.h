@@ -0,0 +1,156 @@
+#ifndef TILECACHE_H
+#define TILECACHE_H
+
+#include <QImage>
+#include <QMetaType>
+#include <QMutex>
+#include <QRect>
+#include <QVector>
+#include <list>
+#include <memory>
+#include <unordered_map>
+
+#define TILE_SIZE 256
+
+/**
+ * @brief The TileLayer enum distinguishes the complete page from its background (pdf and ruling)
+ */
+enum class TileLayer
+{
+  PAGE,
+  BACKGROUND
+};
+
+/**
+ * @brief The TileKey struct identifies a single tile of a rendered page.
+ * @details A tile covers TILE_SIZE x TILE_SIZE device pixels of page @ref pageNum rendered at @ref zoom.
+ * @ref x and @ref y are the column and row of the tile.
+ */
+struct TileKey
+{
+  int pageNum;
+  qreal zoom;
+  int x;
+  int y;
+  TileLayer layer;
+};
+Q_DECLARE_METATYPE(TileKey)
+
+struct TileKeyHash
+{
+  std::size_t operator()(const TileKey &k) const
+  {
+    std::hash<int> f;
+    std::hash<qreal> g;
+    std::size_t h = f(k.pageNum);
+    h = h * 31 + g(k.zoom);
+    h = h * 31 + f(k.x);
+    h = h * 31 + f(k.y);
+    h = h * 31 + f(static_cast<int>(k.layer));
+    return h;
+  }
+};
+
+struct TileKeyEqual
+{
+  bool operator()(const TileKey &a, const TileKey &b) const
+  {
+    return a.pageNum == b.pageNum && a.zoom == b.zoom && a.x == b.x && a.y == b.y && a.layer == b.layer;
+  }
+};
+
+/**
+ * @brief The TileCache class stores the rendered tiles of the pages, so that memory and render time depend on the size of the
+ * visible area and not on page size times zoom.
+ * @details The cache holds at most @ref budget bytes of tiles. If it gets full, the least recently used tiles are evicted.
+ * All methods are thread safe. Tiles are handed out as shared pointers, so a tile can be painted on while the cache
+ * is modified.
+ */
+class TileCache
+{
+public:
+  TileCache();
+
+  struct Statistics
+  {
+    quint64 hits = 0;
+    quint64 misses = 0;
+    quint64 evictions = 0;
+    qint64 bytes = 0; /**< memory used by the cached tiles */
+    int tiles = 0;
+  };
+
+  /**
+   * @brief tile looks up a tile and marks it as recently used
+   * @param key
+   * @return the cached tile or nullptr if it is not cached
+   */
+  std::shared_ptr<QImage> tile(const TileKey &key);
+  bool contains(const TileKey &key);
+  /**
+   * @brief insert puts a tile into the cache and evicts least recently used tiles until the cache fits into its budget again
+   */
+  void insert(const TileKey &key, std::shared_ptr<QImage> image);
+  void remove(const TileKey &key);
+
+  /**
+   * @brief removePage removes all tiles (of all layers) of page @param pageNum
+   */
+  void removePage(int pageNum);
+  void clear();
+
+  void setBudget(qint64 bytes);
+  qint64 budget();
+
+  Statistics statistics();
+
+  /**
+   * @brief tileRect
+   * @param key
+   * @return the rect covered by the tile in device pixels relative to the upper left corner of the page
+   */
+  static QRect tileRect(const TileKey &key);
+  /**
+   * @brief tileRect
+   * @param key
+   * @param pageSize size of the page (zoom factor 1)
+   * @param devicePixelRatio
+   * @return the rect covered by the tile, cut to the page borders
+   */
+  static QRect tileRect(const TileKey &key, const QSizeF &pageSize, qreal devicePixelRatio);
+  /**
+   * @brief tilesInRect
+   * @param pageNum
+   * @param zoom
+   * @param deviceRect rect in device pixels relative to the upper left corner of the page
+   * @return the keys of all tiles (of layer TileLayer::PAGE) intersecting @param deviceRect
+   */
+  static QVector<TileKey> tilesInRect(int pageNum, qreal zoom, const QRectF &deviceRect);
+  /**
+   * @brief backgroundKey
+   * @param key
+   * @return the key of the background tile at the same position as @param key
+   */
+  static TileKey backgroundKey(const TileKey &key);
+
+  static constexpr qint64 minBudget = 16 * 1024 * 1024;
+  static constexpr qint64 defaultBudget = 256 * 1024 * 1024;
+
+private:
+  struct Entry
+  {
+    std::shared_ptr<QImage> image;
+    std::list<TileKey>::iterator lruPos;
+  };
+
+  void erase(std::unordered_map<TileKey, Entry, TileKeyHash, TileKeyEqual>::iterator tileIter);
+  void evict(const TileKey &keep);
+
+  std::unordered_map<TileKey, Entry, TileKeyHash, TileKeyEqual> m_tiles;
+  std::list<TileKey> m_lru; /**< most recently used tile at the front */
+  qint64 m_budget = defaultBudget;
+  Statistics m_statistics;
+  QMutex m_mutex;
+};
+
+#endif // TILECACHE_H
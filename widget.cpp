@@ -46,6 +46,13 @@ Widget::Widget(QWidget *parent)
   QSettings settings;
   //    qDebug() << settings.applicationVersion();
 
+  // memory budget for rendered tiles in MiB
+  if (!settings.contains("Widget/renderCacheBudget"))
+  {
+    settings.setValue("Widget/renderCacheBudget", TileCache::defaultBudget / (1024 * 1024));
+  }
+  tileCache.setBudget(settings.value("Widget/renderCacheBudget").toLongLong() * 1024 * 1024);
+
   currentState = state::IDLE;
 
   // setup cursors
@@ -87,6 +94,10 @@ Widget::Widget(QWidget *parent)
 
   currentCOSPos.setX(0.0);
   currentCOSPos.setY(0.0);
+
+  renderService = new RenderService(this);
+  connect(renderService, &RenderService::tileRendered, this, &Widget::backgroundTileRendered);
+
   updateAllPageBuffers();
   setGeometry(getWidgetGeometry());
 
@@ -105,95 +116,39 @@ Widget::Widget(QWidget *parent)
   //scrollTimer->setInterval(30);
 
   connect(updateAllPageBuffersTimer, &QTimer::timeout, this, &Widget::updatePageAfterZoomTimer);
+
+  journalTimer = new QTimer(this);
+  journalTimer->setSingleShot(true);
+  journalTimer->setInterval(MrDoc::Journal::flushInterval);
+  connect(journalTimer, &QTimer::timeout, this, &Widget::flushJournal);
+  connect(&undoStack, &QUndoStack::indexChanged, this, &Widget::journalChanged);
+  startJournal();
 }
 
 void Widget::updateAllPageBuffers()
 {
-    if(updateThread->isRunning()){
-        updateThread->requestInterruption();
-    }
-
-    if(prevZoom != zoom || pageBufferPtr.size() != currentDocument.pages.size() || pageBufferPtr.isEmpty()){
+    if(prevZoom != zoom || tileZoom != zoom){
         if(ctrlZoom){
             dismissedCleanZoom = true;
             return;
         }
         dismissedCleanZoom = false;
-        QMutexLocker locker1(&overallBufferMutex);
-
-        QVector<QFuture<void>> future;
-        pageBufferPtr.clear();
-        basePixmapMap.clear();
 
-        for (int buffNum = 0; buffNum < currentDocument.pages.size(); ++buffNum)
-        {
-            QMutexLocker locker(&pageBufferPtrMutex);
-            pageBufferPtr.append(std::make_shared<std::shared_ptr<QPixmap>>(std::make_shared<QPixmap>()));
-        }
-
-        QSet<int> allPages;
-        for(int i = 0; i < currentDocument.pages.size(); ++i){
-            allPages.insert(i);
-        }
-        QSet<int> visiblePages = getVisiblePages();
-        QSet<int> nonVisiblePages = allPages.subtract(visiblePages);
-        for(int buffNum : visiblePages){
-            future.append(QtConcurrent::run(this, &Widget::updateBuffer, buffNum));
-        }
-        for(int buffNum : nonVisiblePages){
-            future.append(QtConcurrent::run(this, &Widget::updateBufferWithPlaceholder, buffNum));
-        }
-
-        for (int buffNum = 0; buffNum < currentDocument.pages.size(); ++buffNum)
-        {
-            future[buffNum].waitForFinished();
-        }
+        renderService->cancelAll();
+        tileCache.clear();
+        tileZoom = zoom;
         prevZoom = zoom;
     }
-    else{
-        UpdateWorker* worker = new UpdateWorker(this);
-        worker->moveToThread(updateThread);
-        connect(worker, &UpdateWorker::finished, updateThread, &QThread::quit);
-        connect(updateThread, &QThread::started, worker, &UpdateWorker::process);
-        connect(updateThread, &QThread::finished, this, [this](){update();}, Qt::QueuedConnection);
-        updateThread->start();
-        //QtConcurrent::run(this, &Widget::updateNecessaryPagesBuffer);
-    }
+    requestBackgroundTiles();
+    // the visible pages are loaded again when they are painted, pages far away are given back
+    currentDocument.unloadPages(getVisiblePages());
+    update();
     dirtyZoom = false;
 }
 
 void Widget::updateAllPageBuffersDirtyZoom(){
     if(dirtyZoom){
-        if(updateThread->isRunning()){
-            updateThread->requestInterruption();
-        }
-
-        if(currentDocument.pages.size() != pageBufferPtr.size()){
-            updateAllPageBuffers();
-            return;
-        }
-        QMutexLocker locker1(&overallBufferMutex);
-
-        QVector<QFuture<void>> future;
-        //basePixmapMap.clear();
-
-        QSet<int> allPages;
-        for(int i = 0; i < currentDocument.pages.size(); ++i){
-            allPages.insert(i);
-        }
-        QSet<int> visiblePages = getVisiblePages();
-        QSet<int> nonVisiblePages = allPages.subtract(visiblePages);
-        for(int buffNum : visiblePages){
-            future.append(QtConcurrent::run(this, &Widget::updateBufferDirtyZoom, buffNum));
-        }
-        for(int buffNum : nonVisiblePages){
-            future.append(QtConcurrent::run(this, &Widget::updateBufferWithPlaceholder, buffNum));
-        }
-
-        for (int buffNum = 0; buffNum < currentDocument.pages.size(); ++buffNum)
-        {
-            future[buffNum].waitForFinished();
-        }
+        // paintEvent scales the tiles rendered at tileZoom
         repaint();
         updateAllPageBuffersTimer->start(33);
     }
@@ -201,302 +156,171 @@ void Widget::updateAllPageBuffersDirtyZoom(){
 
 }
 
-void Widget::updateNecessaryPagesBuffer(){
-//    QVector<QFuture<void>> future;
-
-//    int startingPage = std::max(0, getCurrentPage()-6);
-//    int endPage = std::min(currentDocument.pages.size(), getCurrentPage()+6);
-//    for(int buffNum = startingPage; buffNum < endPage; ++buffNum){
-//        pageBufferPtr.replace(buffNum, std::make_shared<QPixmap>());
-//    }
-//    for(int buffNum = startingPage; buffNum < endPage; ++buffNum){
-//        future.append(QtConcurrent::run(this, &Widget::updateBuffer, buffNum));
-//    }
-//    for(int buffNum = 0; buffNum < future.size(); ++buffNum){
-//        future[buffNum].waitForFinished();
-//    }
-
-//    if(scrollingBecauseOfZooming){
-//        scrollingBecauseOfZooming = false;
-//        return;
-//    }
-    QMutexLocker locker1(&overallBufferMutex);
-    QVector<QFuture<void>> future;
-
-    int startingPage = std::max(0, getCurrentPage()-6);
-    int endPage = std::min(currentDocument.pages.size(), getCurrentPage()+6);
-
-    for(int buffNum = startingPage; buffNum < endPage; ++buffNum){
-        if(QThread::currentThread()->isInterruptionRequested()){
-            for(int i = 0; i < future.size(); ++i){
-                future[i].waitForFinished();
-            }
-            locker1.unlock();
-            return;
-        }
-        const MrDoc::Page& buffPage = currentDocument.pages[buffNum];
-        int pageWidth = zoom * buffPage.width() * devicePixelRatio();
-        int pageHight = zoom * buffPage.height() * devicePixelRatio();
-
-        BasicPageSize p;
-        p.pageHeight = pageHight;
-        p.pageWidth = pageWidth;
-
-        auto basePixmapIter = basePixmapMap.find(p);
-        if(basePixmapIter != basePixmapMap.end()){
-            if((*(*(basePixmapIter->second))).toImage() == (*(*(pageBufferPtr.at(buffNum)))).toImage()){
-                future.append(QtConcurrent::run(this, &Widget::updateBuffer, buffNum));
-                //updateBuffer(buffNum);
+void Widget::requestBackgroundTiles(){
+    QRect visibleRect = getVisibleRect();
+    QRect neighbourRect;
+    QRect prefetchRect;
+    if(currentView == view::VERTICAL){
+        neighbourRect = visibleRect.adjusted(0, -visibleRect.height(), 0, visibleRect.height());
+        prefetchRect = visibleRect.adjusted(0, -2*visibleRect.height(), 0, 2*visibleRect.height());
+    }
+    else{
+        neighbourRect = visibleRect.adjusted(-visibleRect.width(), 0, visibleRect.width(), 0);
+        prefetchRect = visibleRect.adjusted(-2*visibleRect.width(), 0, 2*visibleRect.width(), 0);
+    }
+
+    qreal dpr = devicePixelRatio();
+    QVector<TileKey> requestedTiles;
+    QPointF pageTopLeft(0.0, 0.0);
+    for(int i = 0; i < currentDocument.pages.size(); ++i){
+        MrDoc::Page const &page = currentDocument.pages.at(i);
+        QRectF pageRect(pageTopLeft, QSizeF(page.width() * tileZoom, page.height() * tileZoom));
+
+        if(page.hasBackground() && pageRect.intersects(prefetchRect)){
+            QRectF exposedRect = pageRect.intersected(prefetchRect).translated(-pageTopLeft);
+            QRectF deviceRect(exposedRect.topLeft() * dpr, exposedRect.bottomRight() * dpr);
+            for(const TileKey &key : TileCache::tilesInRect(i, tileZoom, deviceRect)){
+                TileKey backgroundKey = TileCache::backgroundKey(key);
+                if(tileCache.contains(backgroundKey)){
+                    continue;
+                }
+                QRectF tileRect = TileCache::tileRect(key);
+                QRectF tileWidgetRect(pageTopLeft + tileRect.topLeft() / dpr, tileRect.size() / dpr);
+                RenderService::priority prio = RenderService::priority::PREFETCH;
+                if(tileWidgetRect.intersects(visibleRect))
+                    prio = RenderService::priority::VISIBLE;
+                else if(tileWidgetRect.intersects(neighbourRect))
+                    prio = RenderService::priority::NEIGHBOUR;
+                renderService->request(backgroundKey, page.background(), dpr, prio);
+                requestedTiles.append(backgroundKey);
             }
         }
+
+        if(currentView == view::VERTICAL)
+            pageTopLeft.ry() += floor(page.height() * tileZoom) + PAGE_GAP;
+        else
+            pageTopLeft.rx() += floor(page.width() * tileZoom) + PAGE_GAP;
     }
-    for(int i = 0; i < future.size(); ++i){
-        future[i].waitForFinished();
+    // everything else became stale
+    renderService->retain(requestedTiles);
+}
+
+void Widget::backgroundTileRendered(TileKey key, QImage image, quint64 generation){
+    // the tile may have been cancelled while the signal was queued
+    if(!renderService->isCurrent(key, generation) || key.zoom != tileZoom || key.pageNum >= currentDocument.pages.size()){
+        return;
     }
+    tileCache.insert(key, std::make_shared<QImage>(image));
 
-//    QVector<QFuture<void>> futureUrgent;
-//    QVector<QFuture<void>> future;
-
-//    qDebug() << "updateNecessary";
-//    int startingPage = std::max(0, getCurrentPage()-6);
-//    int endPage = std::min(currentDocument.pages.size(), getCurrentPage()+6);
-//    QVector<int> toUpdateUrgent;
-//    QVector<int> toUpdate;
-
-//    int currentPageNum = getCurrentPage();
-//    int visiblePages = getVisiblePages();
-
-//    for(int buffNum = startingPage; buffNum < endPage; ++buffNum){
-
-//        //qDebug() << (*pageBufferPtr.at(buffNum))->rect() << "vs" << basePixmap->rect();
-//        qDebug() << buffNum << ":" << (*pageBufferPtr.at(buffNum)).use_count() << "vs" << basePixmap.use_count();
-//        qDebug() << buffNum << ":" << pageBufferPtr.at(buffNum).use_count();
-
-//        const MrDoc::Page& buffPage = currentDocument.pages[buffNum];
-//        int pageWidth = zoom * buffPage.width() * devicePixelRatio();
-//        int pageHight = zoom * buffPage.height() * devicePixelRatio();
-//        BasicPageSize p;
-//        p.pageHeight = pageHight;
-//        p.pageWidth = pageWidth;
-//        auto basePixmapIter = basePixmapMap.find(p);
-//        if(basePixmapIter != basePixmapMap.end()){
-
-////        }
-////        if(*pageBufferPtr.at(buffNum) == *basePixmap){
-//            qDebug() << "replace" << buffNum;
-//            {
-//                QMutexLocker locker(&pageBufferPtrMutex);
-//                pageBufferPtr.replace(buffNum, std::make_shared<std::shared_ptr<QPixmap>>(std::make_shared<QPixmap>()));
-//            }
-//            if(abs(buffNum - currentPageNum) < 2*visiblePages){
-//                qDebug() << "urgent:" << buffNum;
-//                toUpdateUrgent.append(buffNum);
-//            }
-//            else{
-//                toUpdate.append(buffNum);
-//            }
-//        }
-//    }
-//    for(int i = 0; i < toUpdateUrgent.size(); ++i){
-//        futureUrgent.append(QtConcurrent::run(this, &Widget::updateBuffer, toUpdateUrgent.at(i)));
-//    }
-//    for(int i = 0; i < toUpdate.size(); ++i){
-//        future.append(QtConcurrent::run(this, &Widget::updateBuffer, toUpdate.at(i)));
-//    }
-//    for(int buffNum = 0; buffNum < futureUrgent.size(); ++buffNum){
-//        futureUrgent[buffNum].waitForFinished();
-//    }
-//    for(int i = 0; i < future.size(); ++i){
-//        future[i].waitForFinished();
-//    }
-//    //update();
+    qreal scale = zoom / tileZoom / devicePixelRatio();
+    QRectF pageRect = getPageRect(key.pageNum);
+    QRectF tileRect = TileCache::tileRect(key);
+    update(QRectF(pageRect.topLeft() + tileRect.topLeft() * scale, tileRect.size() * scale).toAlignedRect());
 }
 
 void Widget::updateBuffer(int buffNum)
 {
-//  MrDoc::Page const &page = currentDocument.pages.at(buffNum);
-//  int pixelWidth = zoom * page.width() * devicePixelRatio();
-//  int pixelHeight = zoom * page.height() * devicePixelRatio();
-
-//  //qDebug() << "visible Pages: " << getVisiblePages();
-//  if(abs(buffNum - getCurrentPage()) < 2*getVisiblePages()){
-//      std::shared_ptr<std::shared_ptr<QPixmap>> newPixmap = std::make_shared<std::shared_ptr<QPixmap>>(std::make_shared<QPixmap>(pixelWidth, pixelHeight));
-//      (*newPixmap)->setDevicePixelRatio(devicePixelRatio());
-//      (*newPixmap)->fill(page.backgroundColor());
-//      QPainter painter;
-//      painter.begin(newPixmap.get()->get());
-//      painter.setRenderHint(QPainter::Antialiasing, true);
-
-//      currentDocument.pages[buffNum].paint(painter, zoom);
-//      painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
-
-//      painter.end();
-//      pageBufferPtr.replace(buffNum, newPixmap);
-//      //newPixmap->save("/home/alexander/testPixmap.png");
-//  }
-//  else{
-//      //TODO: use lockguard
-//      basePixmapMutex.lock();
-//      if((*basePixmap)->height() != pixelHeight || (*basePixmap)->width() != pixelWidth){
-//          //basePixmap->scaled(pixelWidth, pixelHeight);
-//          *basePixmap = std::make_shared<QPixmap>(pixelWidth, pixelHeight);
-//      }
-//      (*basePixmap)->setDevicePixelRatio(devicePixelRatio());
-//      (*basePixmap)->fill(page.backgroundColor());
-
-//      QPainter painter;
-
-//      painter.begin((*basePixmap).get());
-//      painter.end();
-//      pageBufferPtr.replace(buffNum, basePixmap);
-//      //pageBufferPtr[buffNum] = std::make_shared<std::shared_ptr<QPixmap>>(basePixmap);
-//      //*pageBufferPtr[buffNum] = basePixmap;
-
-//      basePixmapMutex.unlock();
-//  }
-
-  MrDoc::Page const &page = currentDocument.pages.at(buffNum);
-  int pixelWidth = zoom * page.width() * devicePixelRatio();
-  int pixelHeight = zoom * page.height() * devicePixelRatio();
-
-  //qDebug() << "visible Pages: " << getVisiblePages();
-  //if(abs(buffNum - getCurrentPage()) < 2*getVisiblePages()){
-      std::shared_ptr<std::shared_ptr<QPixmap>> newPixmap = std::make_shared<std::shared_ptr<QPixmap>>(std::make_shared<QPixmap>(pixelWidth, pixelHeight));
-      (*newPixmap)->setDevicePixelRatio(devicePixelRatio());
-      (*newPixmap)->fill(page.backgroundColor());
-      QPainter painter;
-      painter.begin(newPixmap.get()->get());
-      painter.setRenderHint(QPainter::Antialiasing, true);
-
-      currentDocument.pages[buffNum].paint(painter, zoom);
-      painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
-
-      painter.end();
-      {
-          QMutexLocker locker(&pageBufferPtrMutex);
-          pageBufferPtr.replace(buffNum, newPixmap);
-      }
-  //}
+  tileCache.removePage(buffNum);
+  // background tiles of this page which are rendered at the moment might show the old page
+  renderService->cancelPage(buffNum);
+  requestBackgroundTiles();
+  update();
 }
 
-void Widget::updateBufferWithPlaceholder(int buffNum){
-    MrDoc::Page const &page = currentDocument.pages.at(buffNum);
-    int pixelWidth = zoom * page.width() * devicePixelRatio();
-    int pixelHeight = zoom * page.height() * devicePixelRatio();
+std::shared_ptr<QImage> Widget::renderTile(const TileKey &key, bool &complete)
+{
+  MrDoc::Page &page = currentDocument.pages[key.pageNum];
+  qreal dpr = devicePixelRatio();
+  QRect tileRect = TileCache::tileRect(key, QSizeF(page.width(), page.height()), dpr);
 
-    //basePixmapMutex.lock();
-    QPainter painter;
-    BasicPageSize p;
-    p.pageWidth = pixelWidth;
-    p.pageHeight = pixelHeight;
-
-
-//    try{
-//        auto bP = basePixmapMap.at(p);
-//        painter.begin((*bP).get());
-//        painter.end();
-//        pageBufferPtr.replace(buffNum, bP);
-//        basePixmapMutex.unlock();
-//    }
-//    catch(std::out_of_range e){
-//        auto bP = std::make_shared<std::shared_ptr<QPixmap>>(std::make_shared<QPixmap>(pixelWidth, pixelHeight));
-//        (*bP)->setDevicePixelRatio(devicePixelRatio());
-//        (*bP)->fill(page.backgroundColor());
-//        basePixmapMap.insert({p, bP});
-//        painter.begin((*bP).get());
-//        painter.end();
-//        pageBufferPtr.replace(buffNum, bP);
-//        basePixmapMutex.unlock();
-//    }
-
-    std::shared_ptr<std::shared_ptr<QPixmap>> bP;
-    auto pixmapIter = basePixmapMap.find(p);
-    if(pixmapIter == basePixmapMap.end()){
-        bP = std::make_shared<std::shared_ptr<QPixmap>>(std::make_shared<QPixmap>(pixelWidth, pixelHeight));
-        (*bP)->setDevicePixelRatio(devicePixelRatio());
-        (*bP)->fill(page.backgroundColor());
-        {
-            QMutexLocker pixmapLocker(&basePixmapMutex);
-            basePixmapMap.insert({p, bP});
-            painter.begin((*bP).get());
-            painter.end();
-        }
-        {
-            QMutexLocker locker(&pageBufferPtrMutex);
-            pageBufferPtr.replace(buffNum, bP);
-        }
-        //basePixmapMutex.unlock();
-    }
-    else{
-        {
-            QMutexLocker pixmapLocker(&basePixmapMutex);
-            bP = pixmapIter->second;
-            painter.begin((*bP).get());
-            painter.end();
-        }
-        {
-            QMutexLocker locker(&pageBufferPtrMutex);
-            pageBufferPtr.replace(buffNum, bP);
-        }
-        //basePixmapMutex.unlock();
+  std::shared_ptr<QImage> background;
+  if (page.hasBackground())
+  {
+    background = tileCache.tile(TileCache::backgroundKey(key));
+    if (!background)
+    {
+      renderService->request(TileCache::backgroundKey(key), page.background(), dpr, RenderService::priority::VISIBLE);
     }
-//    if((*basePixmap)->height() != pixelHeight || (*basePixmap)->width() != pixelWidth){
-//        //basePixmap->scaled(pixelWidth, pixelHeight);
-//        *basePixmap = std::make_shared<QPixmap>(pixelWidth, pixelHeight);
-//    }
-//    (*basePixmap)->setDevicePixelRatio(devicePixelRatio());
-//    (*basePixmap)->fill(page.backgroundColor());
+  }
+  complete = !page.hasBackground() || background;
+
+  std::shared_ptr<QImage> tile;
+  if (background)
+  {
+    tile = std::make_shared<QImage>(background->copy());
+  }
+  else
+  {
+    tile = std::make_shared<QImage>(tileRect.size(), QImage::Format_ARGB32_Premultiplied);
+    tile->fill(page.backgroundColor());
+  }
+  tile->setDevicePixelRatio(dpr);
 
-//    QPainter painter;
+  QRectF clipRect(QPointF(tileRect.topLeft()) / dpr, QSizeF(tileRect.size()) / dpr);
+  QRectF paintRect = QRectF(clipRect.topLeft() / key.zoom, clipRect.bottomRight() / key.zoom);
 
-//    painter.begin((*basePixmap).get());
-//    painter.end();
-//    pageBufferPtr.replace(buffNum, basePixmap);
-//    //pageBufferPtr[buffNum] = std::make_shared<std::shared_ptr<QPixmap>>(basePixmap);
-//    //*pageBufferPtr[buffNum] = basePixmap;
+  QPainter painter;
+  painter.begin(tile.get());
+  painter.setRenderHint(QPainter::Antialiasing, true);
+  painter.translate(-clipRect.topLeft());
+  painter.setClipRect(clipRect);
+  painter.setClipping(true);
 
-//    basePixmapMutex.unlock();
+  page.paintInk(painter, key.zoom, paintRect);
+
+  painter.end();
+  return tile;
 }
 
-void Widget::updateBufferDirtyZoom(int buffNum){
-    MrDoc::Page const &page = currentDocument.pages.at(buffNum);
-    int pixelWidth = zoom * page.width() * devicePixelRatio();
-    int pixelHeight = zoom * page.height() * devicePixelRatio();
+void Widget::updateBufferRegion(int buffNum, QRectF const &clipRect)
+{
+  qreal dpr = devicePixelRatio();
+  qreal tileScale = tileZoom / zoom;
+  QRectF tileClipRect(clipRect.topLeft() * tileScale, clipRect.bottomRight() * tileScale);
+  QRectF deviceRect(tileClipRect.topLeft() * dpr, tileClipRect.bottomRight() * dpr);
+  QRectF paintRect = QRectF(clipRect.topLeft() / zoom, clipRect.bottomRight() / zoom);
+
+  for (const TileKey &key : TileCache::tilesInRect(buffNum, tileZoom, deviceRect))
+  {
+    std::shared_ptr<QImage> tile = tileCache.tile(key);
+    if (!tile)
+    {
+      // tiles which are not cached get rendered from the page when they are painted
+      continue;
+    }
+    MrDoc::Page &page = currentDocument.pages[buffNum];
 
-    std::shared_ptr<std::shared_ptr<QPixmap>> newPixmap = std::make_shared<std::shared_ptr<QPixmap>>(std::make_shared<QPixmap>(pixelWidth, pixelHeight));
-    (*newPixmap)->setDevicePixelRatio(devicePixelRatio());
-    (*newPixmap)->fill(page.backgroundColor());
     QPainter painter;
-    painter.begin(newPixmap.get()->get());
+    painter.begin(tile.get());
     painter.setRenderHint(QPainter::Antialiasing, true);
-    //painter.scale(zoom/prevZoom, zoom/prevZoom);
+    painter.translate(-QPointF(TileCache::tileRect(key).topLeft()) / dpr);
+    painter.setClipRect(tileClipRect);
+    painter.setClipping(true);
 
+    // restore the background from its cached tile, so that only the ink gets repainted
+    if (page.hasBackground())
     {
-        QMutexLocker locker(&pageBufferPtrMutex);
-        painter.drawPixmap(0,0,pixelWidth,pixelHeight, *(*(pageBufferPtr[buffNum])));
+      std::shared_ptr<QImage> background = tileCache.tile(TileCache::backgroundKey(key));
+      if (!background)
+      {
+        // the background was evicted, the tile gets rendered again when it is painted
+        painter.end();
+        tileCache.remove(key);
+        continue;
+      }
+      painter.setCompositionMode(QPainter::CompositionMode_Source);
+      painter.drawImage(QPointF(TileCache::tileRect(key).topLeft()) / dpr, *background);
+      painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
     }
-
-    painter.end();
+    else
     {
-        QMutexLocker locker(&pageBufferPtrMutex);
-        pageBufferPtr.replace(buffNum, newPixmap);
+      painter.fillRect(tileClipRect, page.backgroundColor());
     }
-}
-
-void Widget::updateBufferRegion(int buffNum, QRectF const &clipRect)
-{
-  QPainter painter;
-  painter.begin(pageBufferPtr[buffNum].get()->get());
-  painter.setRenderHint(QPainter::Antialiasing, true);
-  painter.setClipRect(clipRect);
-  painter.setClipping(true);
 
-  painter.fillRect(clipRect, currentDocument.pages.at(buffNum).backgroundColor());
+    page.paintInk(painter, tileZoom, paintRect);
 
-  QRectF paintRect = QRectF(clipRect.topLeft() / zoom, clipRect.bottomRight() / zoom);
-  currentDocument.pages[buffNum].paint(painter, zoom, paintRect);
-
-  painter.end();
+    painter.end();
+  }
 }
 
 void Widget::updateAllDirtyBuffers()
@@ -556,15 +380,46 @@ void Widget::updatePageAfterZoomTimer(){
 
 void Widget::drawOnBuffer(bool last)
 {
-    QPainter painter;
-    painter.begin(pageBufferPtr[drawingOnPage].get()->get());
-    painter.setRenderHint(QPainter::Antialiasing, true);
+    qreal dpr = devicePixelRatio();
+
+    QRectF strokeRect;
+    if (last && currentStroke.size() > 1)
+    {
+        int n = currentStroke.size();
+        qreal pad = currentStroke.penWidth() * maxWidthMultiplier;
+        strokeRect = QRectF(currentStroke.point(n - 2), currentStroke.point(n - 1)).normalized().adjusted(-pad, -pad, pad, pad);
+    }
+    else
+    {
+        strokeRect = currentStroke.boundingRect();
+    }
+    QRectF deviceRect(strokeRect.topLeft() * tileZoom * dpr, strokeRect.bottomRight() * tileZoom * dpr);
+
+    for (const TileKey &key : TileCache::tilesInRect(drawingOnPage, tileZoom, deviceRect))
+    {
+        std::shared_ptr<QImage> tile = tileCache.tile(key);
+        if (!tile)
+        {
+            // tiles which are not cached get the stroke when they are rendered, see paintEvent
+            continue;
+        }
+        paintCurrentStroke(*tile, key, last);
+    }
+}
 
-    //currentStroke.paint(painter, zoom, last);
-    //currentStroke.paint(painter, QRect(0,0, pageBufferPtr[drawingOnPage]->width(), pageBufferPtr[drawingOnPage]->height()), zoom, last);
-    //currentStroke.paint(painter, QRect(currentStroke.boundingRect().x()*zoom, currentStroke.boundingRect().y()*zoom, currentStroke.boundingRect().width()*zoom, currentStroke.boundingRect().height()), zoom, last);
-    currentStroke.paint(painter, zoom, last);
-    //painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
+void Widget::paintCurrentStroke(QImage &tile, const TileKey &key, bool last)
+{
+  QPainter painter;
+  painter.begin(&tile);
+  painter.setRenderHint(QPainter::Antialiasing, true);
+  painter.translate(-QPointF(TileCache::tileRect(key).topLeft()) / devicePixelRatio());
+  currentStroke.paint(painter, key.zoom, last);
+  painter.end();
+}
+
+bool Widget::isDrawingStroke() const
+{
+  return currentState == state::DRAWING || currentState == state::RULING || currentState == state::CIRCLING;
 }
 
 QRect Widget::getWidgetGeometry()
@@ -621,62 +476,80 @@ void Widget::paintEvent(QPaintEvent *event)
 
     QPainter painter(this);
 
-    if (currentState == state::DRAWING)
+    qreal dpr = devicePixelRatio();
+    qreal tileScale = zoom / tileZoom; // not 1.0 only while a dirty zoom is shown
+
+    QPointF pageTopLeft(0.0, 0.0);
+    for (int i = 0; i < currentDocument.pages.size(); ++i)
     {
-        QRectF rectSource;
-        QTransform trans;
-        if(currentView == view::VERTICAL){
-            for (int i = 0; i < drawingOnPage; ++i)
+        MrDoc::Page const &page = currentDocument.pages.at(i);
+        QRectF pageRect(pageTopLeft, QSizeF(page.width() * zoom, page.height() * zoom));
+        QRectF exposedRect = pageRect.intersected(event->rect());
+
+        if (!exposedRect.isEmpty())
+        {
+            painter.save();
+            painter.setClipRect(exposedRect);
+            painter.translate(pageTopLeft);
+            exposedRect.translate(-pageTopLeft);
+
+            if (tileScale != 1.0)
             {
-                trans = trans.translate(0, -((*pageBufferPtr.at(i))->height() + PAGE_GAP*devicePixelRatio()));
+                painter.fillRect(exposedRect, page.backgroundColor());
             }
-        }
-        else{
-            for(int i = 0; i < drawingOnPage; ++i){
-                trans = trans.translate(-((*pageBufferPtr.at(i))->width() + PAGE_GAP*devicePixelRatio()), 0);
+
+            QRectF deviceRect(exposedRect.topLeft() * dpr / tileScale, exposedRect.bottomRight() * dpr / tileScale);
+            for (const TileKey &key : TileCache::tilesInRect(i, tileZoom, deviceRect))
+            {
+                std::shared_ptr<QImage> tile = tileCache.tile(key);
+                if (!tile)
+                {
+                    if (tileScale != 1.0)
+                    {
+                        // gets rendered after the zoom settled
+                        continue;
+                    }
+                    bool complete;
+                    tile = renderTile(key, complete);
+                    // the stroke being drawn is only painted into cached tiles, tiles rendered from the page don't have it yet. This includes
+                    // tiles which are waiting for their background and are rendered on every paint.
+                    if (isDrawingStroke() && i == drawingOnPage)
+                    {
+                        paintCurrentStroke(*tile, key, false);
+                    }
+                    if (complete)
+                    {
+                        // tiles without their background get rendered again when the background arrives
+                        tileCache.insert(key, tile);
+                    }
+                }
+                QPointF tileTopLeft = QPointF(TileCache::tileRect(key).topLeft()) * tileScale / dpr;
+                QRectF rectTarget(tileTopLeft, QSizeF(tile->size()) * tileScale / dpr);
+                painter.drawImage(rectTarget, *tile);
             }
+            painter.restore();
         }
-        trans = trans.scale(devicePixelRatio(),devicePixelRatio());
-        rectSource = trans.mapRect(event->rect());
-
-        //        QPixmap tmp = QPixmap::fromImage(pageBuffer.at(drawingOnPage));
-        painter.drawPixmap(event->rect(), *(*pageBufferPtr[drawingOnPage]), rectSource);
-
-        //        painter.drawImage(event->rect(), pageBuffer.at(drawingOnPage), rectSource);
-        return;
-    }
-
-    //    painter.setRenderHint(QPainter::Antialiasing, true);
-
-    for (int i = 0; i < pageBufferPtr.size(); ++i)
-    {
-        QRectF rectSource;
-        rectSource.setTopLeft(QPointF(0.0, 0.0));
-        rectSource.setWidth((*pageBufferPtr.at(i))->width());
-        rectSource.setHeight((*pageBufferPtr.at(i))->height());
-
-        QRectF rectTarget;
-        //        rectTarget.setTopLeft(QPointF(0.0, currentYPos));
-        rectTarget.setTopLeft(QPointF(0.0, 0.0));
-        rectTarget.setWidth((*pageBufferPtr.at(i))->width()/devicePixelRatio());
-        rectTarget.setHeight((*pageBufferPtr.at(i))->height()/devicePixelRatio());
-
-        painter.drawPixmap(rectTarget, *(*pageBufferPtr.at(i)), rectSource);
 
         if ((currentState == state::SELECTING || currentState == state::SELECTED || currentState == state::MOVING_SELECTION ||
              currentState == state::RESIZING_SELECTION || currentState == state::ROTATING_SELECTION) &&
                 i == currentSelection.pageNum())
         {
+            painter.save();
+            painter.translate(pageTopLeft);
             currentSelection.paint(painter, zoom);
+            painter.restore();
         }
         else if ((currentState == state::MARKDOWN_SELECTED || currentState == state::MARKDOWN_MOVING) && i == currentMarkdownSelection.pageNum()){
+            painter.save();
+            painter.translate(pageTopLeft);
             currentMarkdownSelection.paint(painter,zoom);
+            painter.restore();
         }
 
         if(currentView == view::VERTICAL)
-            painter.translate(QPointF(0.0, rectSource.height()/devicePixelRatio() + PAGE_GAP));
+            pageTopLeft.ry() += floor(page.height() * zoom) + PAGE_GAP;
         else
-            painter.translate(QPointF(rectSource.width()/devicePixelRatio() + PAGE_GAP, 0.0));
+            pageTopLeft.rx() += floor(page.width() * zoom) + PAGE_GAP;
     }
 
 }
@@ -1425,11 +1298,10 @@ void Widget::startRuling(QPointF mousePos)
   QPointF pagePos = getPagePosFromMousePos(mousePos, pageNum);
 
   MrDoc::Stroke newStroke;
-  newStroke.pattern = currentPattern;
-  newStroke.points.append(pagePos);
-  newStroke.pressures.append(1);
-  newStroke.penWidth = currentPenWidth;
-  newStroke.color = currentColor;
+  newStroke.setPattern(currentPattern);
+  newStroke.appendPoint(pagePos, 1);
+  newStroke.setPenWidth(currentPenWidth);
+  newStroke.setColor(currentColor);
   currentStroke = newStroke;
   currentState = state::RULING;
 
@@ -1443,21 +1315,19 @@ void Widget::continueRuling(QPointF mousePos)
   QPointF pagePos = getPagePosFromMousePos(mousePos, drawingOnPage);
   QPointF previousPagePos = getPagePosFromMousePos(previousMousePos, drawingOnPage);
 
-  QPointF firstPagePos = currentStroke.points.at(0);
+  QPointF firstPagePos = currentStroke.point(0);
 
   QPointF oldPagePos = pagePos;
 
   currentDashOffset = 0.0;
 
-  if (currentStroke.points.length() > 1)
+  if (currentStroke.size() > 1)
   {
-    oldPagePos = currentStroke.points.at(1);
-    currentStroke.points.removeAt(1);
-    currentStroke.pressures.removeAt(1);
+    oldPagePos = currentStroke.point(1);
+    currentStroke.removePointAt(1);
   }
 
-  currentStroke.points.append(pagePos);
-  currentStroke.pressures.append(1);
+  currentStroke.appendPoint(pagePos, 1);
 
   QRect clipRect(zoom * firstPagePos.toPoint(), zoom * pagePos.toPoint());
   QRect oldClipRect(zoom * firstPagePos.toPoint(), zoom * previousPagePos.toPoint());
@@ -1482,14 +1352,12 @@ void Widget::stopRuling(QPointF mousePos)
 {
   QPointF pagePos = getPagePosFromMousePos(mousePos, drawingOnPage);
 
-  if (currentStroke.points.length() > 1)
+  if (currentStroke.size() > 1)
   {
-    currentStroke.points.removeAt(1);
-    currentStroke.pressures.removeAt(1);
+    currentStroke.removePointAt(1);
   }
 
-  currentStroke.points.append(pagePos);
-  currentStroke.pressures.append(1);
+  currentStroke.appendPoint(pagePos, 1);
 
   AddStrokeCommand *addCommand = new AddStrokeCommand(this, drawingOnPage, currentStroke);
   undoStack.push(addCommand);
@@ -1509,9 +1377,9 @@ void Widget::startCircling(QPointF mousePos)
   MrDoc::Stroke newStroke;
   //    newStroke.points.append(pagePos);
   //    newStroke.pressures.append(1);
-  newStroke.pattern = currentPattern;
-  newStroke.penWidth = currentPenWidth;
-  newStroke.color = currentColor;
+  newStroke.setPattern(currentPattern);
+  newStroke.setPenWidth(currentPenWidth);
+  newStroke.setColor(currentColor);
   currentStroke = newStroke;
   currentState = state::CIRCLING;
 
@@ -1529,8 +1397,7 @@ void Widget::continueCircling(QPointF mousePos)
 
   MrDoc::Stroke oldStroke = currentStroke;
 
-  currentStroke.points.clear();
-  currentStroke.pressures.clear();
+  currentStroke.clearPoints();
 
   qreal radius = QLineF(firstPagePos, pagePos).length();
   qreal phi0 = QLineF(firstPagePos, pagePos).angle() * M_PI / 180.0;
@@ -1541,15 +1408,14 @@ void Widget::continueCircling(QPointF mousePos)
     qreal phi = phi0 + i * (2.0 * M_PI / (N - 1));
     qreal x = firstPagePos.x() + radius * cos(phi);
     qreal y = firstPagePos.y() - radius * sin(phi);
-    currentStroke.points.append(QPointF(x, y));
-    currentStroke.pressures.append(1.0);
+    currentStroke.appendPoint(QPointF(x, y), 1.0);
   }
 
   QTransform scaleTrans;
   scaleTrans = scaleTrans.scale(zoom, zoom);
 
-  QRect clipRect = scaleTrans.mapRect(currentStroke.points.boundingRect()).toRect();
-  QRect oldClipRect = scaleTrans.mapRect(oldStroke.points.boundingRect()).toRect();
+  QRect clipRect = scaleTrans.mapRect(currentStroke.boundingRectSansPenWidth()).toRect();
+  QRect oldClipRect = scaleTrans.mapRect(oldStroke.boundingRectSansPenWidth()).toRect();
   clipRect = clipRect.normalized().united(oldClipRect.normalized());
   int clipRad = zoom * currentPenWidth / 2 + 2;
   clipRect = clipRect.normalized().adjusted(-clipRad, -clipRad, clipRad, clipRad);
@@ -1589,16 +1455,17 @@ void Widget::startDrawing(QPointF mousePos, qreal pressure)
   currentDashOffset = 0.0;
 
   MrDoc::Stroke newStroke;
-  newStroke.pattern = currentPattern;
-  newStroke.points.append(pagePos);
-  newStroke.pressures.append(pressure);
-  newStroke.penWidth = currentPenWidth;
-  newStroke.color = currentColor;
+  newStroke.setPattern(currentPattern);
+  newStroke.appendPoint(pagePos, pressure);
+  newStroke.setPenWidth(currentPenWidth);
+  newStroke.setColor(currentColor);
   if(currentTool == tool::HIGHLIGHTER){
-      newStroke.isHighlighter = true;
-      newStroke.penWidth *= 4.5;
+      newStroke.setHighlighter(true);
+      newStroke.setPenWidth(newStroke.penWidth() * 4.5);
       //newStroke.color = QColor(255-currentColor.red(), 255-currentColor.green(), 255-currentColor.blue(), 127);
-      newStroke.color.setAlpha(127);
+      QColor highlighterColor = currentColor;
+      highlighterColor.setAlpha(127);
+      newStroke.setColor(highlighterColor);
   }
   currentStroke = newStroke;
   //    drawing = true;
@@ -1612,8 +1479,7 @@ void Widget::continueDrawing(QPointF mousePos, qreal pressure)
 {
   QPointF pagePos = getPagePosFromMousePos(mousePos, drawingOnPage);
 
-  currentStroke.points.append(pagePos);
-  currentStroke.pressures.append(pressure);
+  currentStroke.appendPoint(pagePos, pressure);
   drawOnBuffer(true);
 
   QRect updateRect(previousMousePos.toPoint(), mousePos.toPoint());
@@ -1631,8 +1497,7 @@ void Widget::stopDrawing(QPointF mousePos, qreal pressure)
 
   QPointF pagePos = getPagePosFromMousePos(mousePos, drawingOnPage);
 
-  currentStroke.points.append(pagePos);
-  currentStroke.pressures.append(pressure);
+  currentStroke.appendPoint(pagePos, pressure);
   drawOnBuffer();
 
   AddStrokeCommand *addCommand = new AddStrokeCommand(this, drawingOnPage, currentStroke, -1, false, true);
@@ -1676,66 +1541,71 @@ void Widget::erase(QPointF mousePos, bool invertEraser)
 
   if (realEraser || (!realEraser && invertEraser))
   {
-    for (int i = strokes.size() - 1; i >= 0; --i)
+    // strokes are processed back to front, so splitting a stroke does not shift the positions of the strokes still pending
+    QVector<int> pendingStrokes = currentDocument.pages[pageNum].strokesInRect(rectE);
+    while (!pendingStrokes.isEmpty())
     {
+      int i = pendingStrokes.takeLast();
       MrDoc::Stroke stroke = strokes.at(i);
-      if (rectE.intersects(stroke.points.boundingRect()) || !stroke.points.boundingRect().isValid()) // this is done for speed
+      QPolygonF points = stroke.points();
+      for (int j = 0; j < points.length() - 1; ++j)
       {
-        for (int j = 0; j < stroke.points.length() - 1; ++j)
+        QLineF line = QLineF(points.at(j), points.at(j + 1));
+        if (line.intersect(lineA, &iPointA) == QLineF::BoundedIntersection && iPointA != points.first() && iPointA != points.last())
         {
-          QLineF line = QLineF(stroke.points.at(j), stroke.points.at(j + 1));
-          if (line.intersect(lineA, &iPointA) == QLineF::BoundedIntersection && iPointA != stroke.points.first() && iPointA != stroke.points.last())
-          {
-            iPoint = iPointA;
-            intersected = true;
-          }
-          else if (line.intersect(lineB, &iPointB) == QLineF::BoundedIntersection && iPointB != stroke.points.first() && iPointB != stroke.points.last())
-          {
-            iPoint = iPointB;
-            intersected = true;
-          }
-          else if (line.intersect(lineC, &iPointC) == QLineF::BoundedIntersection && iPointC != stroke.points.first() && iPointC != stroke.points.last())
-          {
-            iPoint = iPointC;
-            intersected = true;
-          }
-          else if (line.intersect(lineD, &iPointD) == QLineF::BoundedIntersection && iPointD != stroke.points.first() && iPointD != stroke.points.last())
-          {
-            iPoint = iPointD;
-            intersected = true;
-          }
-          else
-          {
-            intersected = false;
-          }
+          iPoint = iPointA;
+          intersected = true;
+        }
+        else if (line.intersect(lineB, &iPointB) == QLineF::BoundedIntersection && iPointB != points.first() && iPointB != points.last())
+        {
+          iPoint = iPointB;
+          intersected = true;
+        }
+        else if (line.intersect(lineC, &iPointC) == QLineF::BoundedIntersection && iPointC != points.first() && iPointC != points.last())
+        {
+          iPoint = iPointC;
+          intersected = true;
+        }
+        else if (line.intersect(lineD, &iPointD) == QLineF::BoundedIntersection && iPointD != points.first() && iPointD != points.last())
+        {
+          iPoint = iPointD;
+          intersected = true;
+        }
+        else
+        {
+          intersected = false;
+        }
 
-          if (intersected)
+        if (intersected)
+        {
+          //                        if (iPoint != stroke.points.first() && iPoint != stroke.points.last())
           {
-            //                        if (iPoint != stroke.points.first() && iPoint != stroke.points.last())
-            {
-              MrDoc::Stroke splitStroke = stroke;
-              splitStroke.points = splitStroke.points.mid(0, j + 1);
-              splitStroke.points.append(iPoint);
-              splitStroke.pressures = splitStroke.pressures.mid(0, j + 1);
-              qreal lastPressure = splitStroke.pressures.last();
-              splitStroke.pressures.append(lastPressure);
-
-              stroke.points = stroke.points.mid(j + 1);
-              stroke.points.prepend(iPoint);
-              stroke.pressures = stroke.pressures.mid(j + 1);
-              qreal firstPressure = stroke.pressures.first();
-              stroke.pressures.prepend(firstPressure);
-
-              RemoveStrokeCommand *removeStrokeCommand = new RemoveStrokeCommand(this, pageNum, i, false);
-              undoStack.push(removeStrokeCommand);
-              AddStrokeCommand *addStrokeCommand = new AddStrokeCommand(this, pageNum, stroke, i, false, false);
-              undoStack.push(addStrokeCommand);
-              addStrokeCommand = new AddStrokeCommand(this, pageNum, splitStroke, i, false, false);
-              undoStack.push(addStrokeCommand);
-              //                            strokes.insert(i, splitStroke);
-              i += 2;
-              break;
-            }
+            MrDoc::Stroke splitStroke = stroke;
+            QPolygonF splitPoints = points.mid(0, j + 1);
+            splitPoints.append(iPoint);
+            QVector<qreal> splitPressures = stroke.pressures().mid(0, j + 1);
+            qreal lastPressure = splitPressures.last();
+            splitPressures.append(lastPressure);
+            splitStroke.setPoints(splitPoints, splitPressures);
+
+            QPolygonF remainingPoints = points.mid(j + 1);
+            remainingPoints.prepend(iPoint);
+            QVector<qreal> remainingPressures = stroke.pressures().mid(j + 1);
+            qreal firstPressure = remainingPressures.first();
+            remainingPressures.prepend(firstPressure);
+            stroke.setPoints(remainingPoints, remainingPressures);
+
+            RemoveStrokeCommand *removeStrokeCommand = new RemoveStrokeCommand(this, pageNum, i, false);
+            undoStack.push(removeStrokeCommand);
+            AddStrokeCommand *addStrokeCommand = new AddStrokeCommand(this, pageNum, stroke, i, false, false);
+            undoStack.push(addStrokeCommand);
+            addStrokeCommand = new AddStrokeCommand(this, pageNum, splitStroke, i, false, false);
+            undoStack.push(addStrokeCommand);
+            //                            strokes.insert(i, splitStroke);
+            // both parts may be cut again
+            pendingStrokes.append(i);
+            pendingStrokes.append(i + 1);
+            break;
           }
         }
       }
@@ -1752,32 +1622,29 @@ void Widget::erase(QPointF mousePos, bool invertEraser)
 
   rectE = QRectF(pagePos + QPointF(-eraserWidth, eraserWidth) / 2.0, pagePos + QPointF(eraserWidth, -eraserWidth) / 2.0);
 
-  for (int i = 0; i < strokes.size(); ++i)
+  for (int i : currentDocument.pages[pageNum].strokesInRect(rectE))
   {
-    const MrDoc::Stroke stroke = strokes.at(i);
-    if (rectE.intersects(stroke.points.boundingRect()) || !stroke.points.boundingRect().isValid()) // this is done for speed
+    const MrDoc::Stroke &stroke = strokes.at(i);
+    bool foundStrokeToDelete = false;
+    for (int j = 0; j < stroke.size(); ++j)
     {
-      bool foundStrokeToDelete = false;
-      for (int j = 0; j < stroke.points.length(); ++j)
+      if (rectE.contains(stroke.point(j)))
       {
-        if (rectE.contains(stroke.points.at(j)))
-        {
-          strokesToDelete.append(i);
-          foundStrokeToDelete = true;
-          break;
-        }
+        strokesToDelete.append(i);
+        foundStrokeToDelete = true;
+        break;
       }
-      if (foundStrokeToDelete == false)
+    }
+    if (foundStrokeToDelete == false)
+    {
+      for (int j = 0; j < stroke.size() - 1; ++j)
       {
-        for (int j = 0; j < stroke.points.length() - 1; ++j)
+        QLineF line = QLineF(stroke.point(j), stroke.point(j + 1));
+        if (line.intersect(lineA, &iPoint) == QLineF::BoundedIntersection || line.intersect(lineB, &iPoint) == QLineF::BoundedIntersection ||
+            line.intersect(lineC, &iPoint) == QLineF::BoundedIntersection || line.intersect(lineD, &iPoint) == QLineF::BoundedIntersection)
         {
-          QLineF line = QLineF(stroke.points.at(j), stroke.points.at(j + 1));
-          if (line.intersect(lineA, &iPoint) == QLineF::BoundedIntersection || line.intersect(lineB, &iPoint) == QLineF::BoundedIntersection ||
-              line.intersect(lineC, &iPoint) == QLineF::BoundedIntersection || line.intersect(lineD, &iPoint) == QLineF::BoundedIntersection)
-          {
-            strokesToDelete.append(i);
-            break;
-          }
+          strokesToDelete.append(i);
+          break;
         }
       }
     }
@@ -2098,6 +1965,22 @@ QSet<int> Widget::getVisiblePages(){
 //    return visiblePages;
 }
 
+QRect Widget::getVisibleRect(){
+    QPoint topLeft = this->mapFromGlobal(parentWidget()->mapToGlobal(QPoint(0, 0)));
+    return QRect(topLeft, parentWidget()->size());
+}
+
+QRectF Widget::getPageRect(int pageNum){
+    QPointF topLeft(0.0, 0.0);
+    for(int i = 0; i < pageNum; ++i){
+        if(currentView == view::VERTICAL)
+            topLeft.ry() += floor(currentDocument.pages[i].height() * zoom) + PAGE_GAP;
+        else
+            topLeft.rx() += floor(currentDocument.pages[i].width() * zoom) + PAGE_GAP;
+    }
+    return QRectF(topLeft, QSizeF(currentDocument.pages[pageNum].width() * zoom, currentDocument.pages[pageNum].height() * zoom));
+}
+
 QPointF Widget::getPagePosFromMousePos(QPointF mousePos, int pageNum)
 {
     if(currentView == view::VERTICAL){
@@ -2105,9 +1988,7 @@ QPointF Widget::getPagePosFromMousePos(QPointF mousePos, int pageNum)
         qreal y = mousePos.y();
         for (int i = 0; i < pageNum; ++i)
         {
-            //        y -= (currentDocument.pages[i].height() * zoom + PAGE_GAP); // THIS DOESN'T WORK PROPERLY (should be floor(...height(), or just use
-            //        pageBuffer[i].height()/devicePixelRatio())
-            y -= ((*pageBufferPtr[i])->height()/devicePixelRatio() + PAGE_GAP);
+            y -= (floor(currentDocument.pages[i].height() * zoom) + PAGE_GAP);
         }
         //    y -= (pageNum) * (currentDocument.pages[0].height() * zoom + PAGE_GAP);
 
@@ -2119,7 +2000,7 @@ QPointF Widget::getPagePosFromMousePos(QPointF mousePos, int pageNum)
         qreal x = mousePos.x();
         qreal y = mousePos.y();
         for(int i = 0; i < pageNum; ++i){
-            x -= ((*pageBufferPtr[i])->width()/devicePixelRatio() + PAGE_GAP);
+            x -= (floor(currentDocument.pages[i].width() * zoom) + PAGE_GAP);
         }
         QPointF pagePos = QPointF(x, y) / zoom;
         return pagePos;
@@ -2134,7 +2015,7 @@ QPointF Widget::getAbsolutePagePosFromMousePos(QPointF mousePos)
   qreal y = 0.0;
   for (int i = 0; i < pageNum; ++i)
   {
-    y += ((*pageBufferPtr[i])->height()/devicePixelRatio() + PAGE_GAP);
+    y += (floor(currentDocument.pages[i].height() * zoom) + PAGE_GAP);
   }
   y *= zoom;
 
@@ -2147,9 +2028,12 @@ void Widget::newFile()
 {
   letGoSelection();
 
+  renderService->drain();
   currentDocument = MrDoc::Document();
-  pageBufferPtr.clear();
+  tileCache.clear();
+  prevZoom = -1;
   undoStack.clear();
+  startJournal();
   updateAllPageBuffers();
   QRect widgetGeometry = getWidgetGeometry();
   resize(widgetGeometry.width(), widgetGeometry.height());
@@ -2159,6 +2043,43 @@ void Widget::newFile()
   update();
 }
 
+void Widget::startJournal()
+{
+  journal.start(&currentDocument);
+  journalChanged();
+}
+
+void Widget::journalChanged()
+{
+  bool selected = currentState == state::SELECTED || currentState == state::MOVING_SELECTION || currentState == state::RESIZING_SELECTION ||
+                  currentState == state::ROTATING_SELECTION;
+  journal.setSelection(currentSelection.pageNum(), selected ? currentSelection.strokes() : QVector<MrDoc::Stroke>());
+  bool markdownSelected = currentState == state::MARKDOWN_SELECTED || currentState == state::MARKDOWN_MOVING;
+  journal.setMarkdownSelection(currentMarkdownSelection.pageNum(), currentMarkdownSelection.boundingRect(),
+                               markdownSelected ? currentMarkdownSelection.text() : QString());
+  if (!journalTimer->isActive())
+  {
+    journalTimer->start();
+  }
+}
+
+void Widget::flushJournal()
+{
+  if (!journal.flush())
+  {
+    qWarning() << "could not write the journal";
+  }
+  if (journal.needsCompaction() && !journal.compact())
+  {
+    qWarning() << "could not compact the journal";
+  }
+  // a snapshot written in the background is taken over by the next flush
+  if (journal.isCompacting() && !journalTimer->isActive())
+  {
+    journalTimer->start();
+  }
+}
+
 void Widget::zoomIn()
 {
   qreal newZoom = zoom * ZOOM_STEP;
@@ -2450,10 +2371,13 @@ void Widget::setCurrentTool(tool toolID)
 
 void Widget::setDocument(const MrDoc::Document &newDocument)
 {
+  // the old document may be released below, so no tile of it is rendered anymore
+  renderService->drain();
   currentDocument = newDocument;
   undoStack.clear();
-  pageBufferPtr.clear();
-  prevZoom = -1.0;  //this is a workaround, so that all pages get rendered and updateNecessaryPagesBuffer is not called
+  startJournal();
+  tileCache.clear();
+  prevZoom = -1.0;  //this is a workaround, so that the tile cache is cleared and all tiles get rendered again
   zoom = 0.0; // otherwise zoomTo() doesn't do anything if zoom == newZoom
   dirtyZoom = false;
   zoomFitWidth();
@@ -2747,7 +2671,7 @@ void Widget::searchPdfNext(const QString& text){
     }
     previousSearchText = text;
     previousSearchPageIndex = (previousSearchPageIndex + 1)%searchPageNums.size();
-    prevZoom = -1.0;  //this is a workaround, so that all pages get rendered and updateNecessaryPagesBuffer is not called
+    prevZoom = -1.0;  //this is a workaround, so that the tile cache is cleared and all tiles get rendered again
     updateAllPageBuffers();
     scrollDocumentToPageNum(searchPageNums.at(previousSearchPageIndex));
     update();
@@ -2764,7 +2688,7 @@ void Widget::searchPdfPrev(const QString &text){
     }
     previousSearchText = text;
     previousSearchPageIndex = (previousSearchPageIndex - 1 + searchPageNums.size())%searchPageNums.size(); //no negative numbers
-    prevZoom = -1.0;  //this is a workaround, so that all pages get rendered and updateNecessaryPagesBuffer is not called
+    prevZoom = -1.0;  //this is a workaround, so that the tile cache is cleared and all tiles get rendered again
     updateAllPageBuffers();
     scrollDocumentToPageNum(searchPageNums.at(previousSearchPageIndex));
     update();
@@ -2776,7 +2700,7 @@ void Widget::clearPdfSearch(){
     }
     previousSearchText = "";
     previousSearchPageIndex = -1;
-    prevZoom = -1.0;  //this is a workaround, so that all pages get rendered and updateNecessaryPagesBuffer is not called
+    prevZoom = -1.0;  //this is a workaround, so that the tile cache is cleared and all tiles get rendered again
     updateAllPageBuffers();
     update();
 }
@@ -2795,10 +2719,3 @@ void Widget::pageHistoryBackward(){
     }
 }
 
-UpdateWorker::UpdateWorker(Widget* widget)
-    : widgetPtr{widget} {}
-
-void UpdateWorker::process(){
-    widgetPtr->updateNecessaryPagesBuffer();
-    emit finished();
-}
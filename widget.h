@@ -36,15 +36,9 @@
 #include "markdownbox.h"
 #include "page.h"
 #include "markdownselection.h"
-
-/**
- * These structs are basically for @ref basePixmapMap
- */
-struct BasicPageSize;
-struct BasicPageSizeHash;
-struct BasicPageSizeEqual;
-
-class UpdateWorker;
+#include "tilecache.h"
+#include "renderservice.h"
+#include "journal.h"
 
 class Widget : public QWidget
 // class Widget : public QOpenGLWidget
@@ -111,39 +105,28 @@ public:
                            QTabletEvent::PointerType pointerType, QEvent::Type eventType, qreal pressure, bool tabletEvent);
 
   /**
-   * @brief updateAllPageBuffers updates the page buffers in @ref pageBufferPtr.
-   * @details If zoom level changes or a new document was loaded the page buffer
-   * is cleared. After that only the visible pages (and a few more pages around)
-   * are painted and loaded to @ref pageBufferPtr. For the other pages only a pointer to
-   * a blank placeholder (stored in @ref basePixmapMap) is loaded into the buffer.
+   * @brief updateAllPageBuffers updates the tiles in @ref tileCache.
+   * @details If zoom level changes or a new document was loaded the tile cache
+   * is cleared. Then the background tiles around the visible area are requested from @ref renderService.
+   * All other tiles are rendered on demand in paintEvent. It never waits for poppler.
    */
   void updateAllPageBuffers();
   /**
-   * @brief updateAllPageBuffersDirtyZoom updates the page buffers in @ref pageBufferPtr with new zoom level.
-   * @details It zooms by scaling the existing buffer pixmaps by zoom factor. It does not a rerender.
+   * @brief updateAllPageBuffersDirtyZoom shows the new zoom level without rendering.
+   * @details It zooms by scaling the existing tiles (rendered at @ref tileZoom) in paintEvent. It does not a rerender.
    */
   void updateAllPageBuffersDirtyZoom();
   /**
-   * @brief updateNecessaryPagesBuffer updates the page buffer only for currentpage plus/minus 6 pages.
-   * @details A page gets repainted if its current buffer pixmap is a placeholder.
-   */
-  void updateNecessaryPagesBuffer();
-  /**
-   * @brief updateBuffer updates the page buffer for a single page.
-   * @param i page index of the page to repaint and load into buffer
-   * @see updateBufferWithPlaceholder
+   * @brief requestBackgroundTiles requests the missing background tiles from @ref renderService.
+   * @details Tiles in the visible area come first, then the tiles of the neighbouring screens, then the ones further away.
+   * All other queued requests are cancelled.
    */
-  void updateBuffer(int i);
+  void requestBackgroundTiles();
   /**
-   * @brief updateBufferWithPlaceholder loads a pointer to a blank placeholder into @ref pageBufferPtr
+   * @brief updateBuffer drops the tiles of a single page, so they get rendered again when they are painted.
    * @param buffNum page index
    */
-  void updateBufferWithPlaceholder(int buffNum);
-  /**
-   * @brief updateBufferDirtyZoom loads a scaled pixmap into @ref pageBufferPtr.
-   * @param buffNum page index
-   */
-  void updateBufferDirtyZoom(int buffNum);
+  void updateBuffer(int buffNum);
   void updateBufferRegion(int buffNum, QRectF const &clipRect);
   void drawOnBuffer(bool last = false);
   int getPageFromMousePos(QPointF mousePos);
@@ -160,6 +143,17 @@ public:
    * @return the indices of the visible pages
    */
   QSet<int> getVisiblePages();
+  /**
+   * @brief getVisibleRect
+   * @return the part of the widget visible in the scroll area in widget coordinates
+   */
+  QRect getVisibleRect();
+  /**
+   * @brief getPageRect
+   * @param pageNum
+   * @return the rect of page @param pageNum in widget coordinates
+   */
+  QRectF getPageRect(int pageNum);
 
   void setCurrentState(state newState);
   state getCurrentState();
@@ -180,6 +174,11 @@ public:
   void newFile();
   //    void openFile();
 
+  /**
+   * @brief startJournal starts a new @ref journal for @ref currentDocument, the previous one is discarded
+   */
+  void startJournal();
+
   void zoomIn();
   void zoomOut();
   void zoomTo(qreal newZoom);
@@ -200,9 +199,9 @@ public:
 
   MrDoc::Document currentDocument;
 
-  QVector<std::shared_ptr<std::shared_ptr<QPixmap>>> pageBufferPtr; /**< buffer for page pixmaps */
-  QMutex pageBufferPtrMutex; /**< Mutex for @ref pageBufferPtr It locks only single buffer operations like replace, but not clear.*/
-  QMutex overallBufferMutex; /**< Mutex for @ref pageBufferPtr. */
+  TileCache tileCache; /**< rendered tiles of the pages, limited by the "Widget/renderCacheBudget" setting (MiB) */
+  qreal tileZoom = 1.0; /**< zoom level the tiles in @ref tileCache are rendered at. Differs from @ref zoom only during a dirty zoom. */
+  RenderService *renderService; /**< renders the background tiles (pdf and ruling) */
 
   QColor currentColor;
   qreal currentPenWidth;
@@ -222,6 +221,7 @@ public:
   QScrollArea *scrollArea;
 
   QUndoStack undoStack;
+  MrDoc::Journal journal; /**< the undo commands record their changes of @ref currentDocument here, for crash recovery */
 
   qreal zoom;
   qreal prevZoom = 0;
@@ -230,23 +230,26 @@ public:
   bool dismissedCleanZoom = false; /**< true, if a clean zoom was dismissed, because ctrlZoom was true. */
 
 private:
-  struct BasicPageSize{
-      int pageWidth;
-      int pageHeight;
-  };
-  struct BasicPageSizeHash{
-      std::size_t operator ()(const BasicPageSize& s) const{
-          std::hash<int> f;
-          return f(s.pageHeight) ^ f(s.pageWidth);
-      }
-  };
-  struct BasicPageSizeEqual{
-      bool operator ()(const BasicPageSize& a, const BasicPageSize& b) const{
-          return a.pageWidth == b.pageWidth && a.pageHeight == b.pageHeight;
-      }
-  };
-  std::unordered_map<BasicPageSize, std::shared_ptr<std::shared_ptr<QPixmap>>, BasicPageSizeHash, BasicPageSizeEqual> basePixmapMap; /**< Stores the pointers to the blank placeholders for certain page sizes */
-  QMutex basePixmapMutex;
+  /**
+   * @brief renderTile renders the ink of a single tile on top of its cached background.
+   * @details If the background is not cached yet, it is requested from @ref renderService and the plain background color is used instead.
+   * @param key
+   * @param complete is set to false if the background was missing
+   * @return the tile, cut to the page borders
+   */
+  std::shared_ptr<QImage> renderTile(const TileKey &key, bool &complete);
+  /**
+   * @brief paintCurrentStroke paints @ref currentStroke, which is not part of the page until it is finished, into a tile of @ref drawingOnPage
+   * @param tile
+   * @param key
+   * @param last if true, only the last segment is painted
+   */
+  void paintCurrentStroke(QImage &tile, const TileKey &key, bool last);
+  /**
+   * @brief isDrawingStroke
+   * @return true while a stroke is drawn with the pen, the ruler or the circle tool
+   */
+  bool isDrawingStroke() const;
 
   int previousVerticalValueRendered = 0; /**< Stores the vertical slider value where the last call of updateAllPageBuffers happened */
   int previousVerticalValueMaybeRendered = 0; /**< Stores the vertical slider value where the last @ref scrollTimer start happened */
@@ -254,8 +257,6 @@ private:
   int previousHorizontalValueMaybeRendered = 0;
   QTimer* scrollTimer;
 
-  QThread* updateThread = new QThread();
-
   bool dirtyZoom = false;
   QTimer* updateAllPageBuffersTimer;
 
@@ -263,6 +264,7 @@ private:
 
   QTimer *updateTimer;
   QTimer *updateDirtyTimer;
+  QTimer *journalTimer; /**< flushes @ref journal, so that the edits of one @ref MrDoc::Journal::flushInterval share a single fsync */
 
   qreal count;
 
@@ -369,6 +371,21 @@ private slots:
 
   void updatePageAfterZoomTimer();
 
+  /**
+   * @brief journalChanged records the current selection in @ref journal after every change of @ref undoStack and starts @ref journalTimer
+   */
+  void journalChanged();
+  /**
+   * @brief flushJournal writes the pending records of @ref journal and compacts it when it got too large
+   */
+  void flushJournal();
+
+  /**
+   * @brief backgroundTileRendered puts a tile delivered by @ref renderService into @ref tileCache, unless its request @param generation was
+   * cancelled in the meantime (see RenderService::isCurrent)
+   */
+  void backgroundTileRendered(TileKey key, QImage image, quint64 generation);
+
   void undo();
   void redo();
 
@@ -440,23 +457,4 @@ public slots:
   void pageHistoryBackward();
 };
 
-/**
- * @brief The UpdateWorker class calls updateNecessaryPages. It is necessary to work with QThread instead of QtConcurrent.
- */
-class UpdateWorker : public QObject {
-    Q_OBJECT
-
-public:
-    UpdateWorker(Widget* widget);
-
-public slots:
-    void process();
-
-signals:
-    void finished();
-
-private:
-    Widget* widgetPtr;
-};
-
 #endif // WIDGET_H